@@ -5,19 +5,17 @@
 #ifndef PROJECT_BASE_COMMON_H
 #define PROJECT_BASE_COMMON_H
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <rg/VirtualFileSystem.h>
 
+// copies the file into a string, loaders that can use the bytes in place should call rg::vfs.read
 std::string readFileContents(std::string path) {
-    std::ifstream in(path);
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    return buffer.str();
+    rg::FileData file;
+    rg::vfs.read(path, file);
+    return file.str();
 }
 
 void appendShaderFolderIfNotPresent(std::string& path) {
-    std::ifstream file(path);
-    if (!file) {
+    if (!rg::vfs.exists(path)) {
         path = "resources/shaders/" + path;
     }
 }
@@ -0,0 +1,312 @@
+#ifndef ANTI_ALIASING_H
+#define ANTI_ALIASING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+using namespace std;
+
+enum AntiAliasingMode
+{
+    AntiAliasingNone,
+    AntiAliasingFxaa,
+    AntiAliasingSmaa,
+    AntiAliasingTemporal,
+    AntiAliasingMsaa2x,
+    AntiAliasingMsaa4x,
+    AntiAliasingModeCount
+};
+
+// anti-aliasing of the tone mapped frame, or the sample count the scene is drawn with for the MSAA modes:
+//   FXAA:    one pass, finds the direction of an edge from the luma around the pixel, searches along it
+//            for its ends and resamples across it (fxaa.fs)
+//   SMAA 1x: three passes, luma edges into an RG8 target (smaa_edges.fs), blending weights from the
+//            length and shape of the edge pattern (smaa_weights.fs) and the blend of every pixel with its
+//            neighbours by those weights (smaa_blend.fs)
+//   TAA:     jittered frames accumulated over time before the tone mapping, see Temporal in temporal.h;
+//            nothing to do here
+// Both read the luma from the alpha channel of the source, which tonemap.fs writes. The targets are
+// allocated at the largest size and only the bottom left width x height is drawn, like the scene.
+class AntiAliasing
+{
+public:
+    AntiAliasingMode mode = AntiAliasingFxaa;
+
+    AntiAliasing(Shader& fxaaShader, Shader& edgesShader, Shader& weightsShader, Shader& blendShader)
+        : fxaaShader(fxaaShader), edgesShader(edgesShader), weightsShader(weightsShader), blendShader(blendShader) {}
+
+    static const char* Name(AntiAliasingMode mode)
+    {
+        static const char* names[] = { "none", "FXAA", "SMAA 1x", "TAA", "MSAA 2x", "MSAA 4x" };
+        return names[mode];
+    }
+
+    // samples per pixel of the scene framebuffer for a mode
+    static int Samples(AntiAliasingMode mode)
+    {
+        return mode == AntiAliasingMsaa4x ? 4 : mode == AntiAliasingMsaa2x ? 2 : 1;
+    }
+
+    // bytes per pixel a mode adds to the frame on top of drawing without anti-aliasing. Only the render
+    // targets are counted, assuming every texel is read or written once per pass (i.e. perfect caching):
+    //   MSAA n:  colour (4 bytes) and depth/stencil (4) for the n - 1 extra samples, cleared and written,
+    //            then the resolve reads n colour samples and writes one
+    //   FXAA:    reads the source and writes the output
+    //   SMAA 1x: edges read the source and write RG8, weights read RG8 and write RGBA8, the blend reads the
+    //            source and the weights and writes the output
+    //   TAA:     the camera motion reads depth and writes RG16F velocity, the resolve reads the frame, the
+    //            velocity and RGBA16F history and writes the new history
+    static double BytesPerPixel(AntiAliasingMode mode)
+    {
+        int samples = Samples(mode);
+        if (samples > 1)
+            return 2.0 * 8.0 * (samples - 1) + 4.0 * samples + 4.0;
+        if (mode == AntiAliasingFxaa)
+            return 4.0 + 4.0;
+        if (mode == AntiAliasingSmaa)
+            return (4.0 + 2.0) + (2.0 + 4.0) + (4.0 + 4.0 + 4.0);
+        if (mode == AntiAliasingTemporal)
+            return (4.0 + 4.0) + (4.0 + 4.0 + 8.0 + 8.0);
+        return 0.0;
+    }
+
+    void Init(int width, int height)
+    {
+        createTargets(width, height);
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // the targets are only reallocated when they have to grow
+    void Resize(int newWidth, int newHeight)
+    {
+        if (newWidth > targetWidth || newHeight > targetHeight)
+        {
+            int grownWidth = std::max(newWidth, targetWidth), grownHeight = std::max(newHeight, targetHeight);
+            deleteTargets();
+            createTargets(grownWidth, grownHeight);
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+
+    // runs the post-process modes on the tone mapped frame, the result is Output*. The other modes pass
+    // the source through
+    void Apply(unsigned int sourceFramebuffer, unsigned int sourceTexture, const glm::vec2& uvScale)
+    {
+        outputFramebuffer = sourceFramebuffer;
+        outputTexture = sourceTexture;
+        outputUvScale = uvScale;
+        if (mode != AntiAliasingFxaa && mode != AntiAliasingSmaa)
+            return;
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(emptyVAO);
+        glViewport(0, 0, width, height);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sourceTexture);
+
+        if (mode == AntiAliasingFxaa)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+            fxaaShader.use();
+            fxaaShader.setInt("source", 0);
+            fxaaShader.setVec2("uvScale", uvScale);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        else
+        {
+            // the edge and weight passes discard where there is nothing to do
+            const float clear[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            glBindFramebuffer(GL_FRAMEBUFFER, edgesFBO);
+            glClearBufferfv(GL_COLOR, 0, clear);
+            edgesShader.use();
+            edgesShader.setInt("source", 0);
+            edgesShader.setVec2("renderSize", glm::vec2(width, height));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, weightsFBO);
+            glClearBufferfv(GL_COLOR, 0, clear);
+            weightsShader.use();
+            glBindTexture(GL_TEXTURE_2D, edges);
+            weightsShader.setInt("edges", 0);
+            weightsShader.setVec2("renderSize", glm::vec2(width, height));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+            blendShader.use();
+            glBindTexture(GL_TEXTURE_2D, sourceTexture);
+            blendShader.setInt("source", 0);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, weights);
+            blendShader.setInt("weights", 1);
+            blendShader.setVec2("renderSize", glm::vec2(width, height));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        outputFramebuffer = outputFBO;
+        outputTexture = output;
+        outputUvScale = glm::vec2((float)width / targetWidth, (float)height / targetHeight);
+    }
+
+    unsigned int OutputFramebuffer() const { return outputFramebuffer; }
+    unsigned int OutputTexture() const { return outputTexture; }
+    // part of OutputTexture covered by the frame
+    glm::vec2 OutputUvScale() const { return outputUvScale; }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+private:
+    Shader& fxaaShader;
+    Shader& edgesShader;
+    Shader& weightsShader;
+    Shader& blendShader;
+
+    int width = 0, height = 0;             // drawn area
+    int targetWidth = 0, targetHeight = 0; // allocated
+    unsigned int edgesFBO = 0, edges = 0;
+    unsigned int weightsFBO = 0, weights = 0;
+    unsigned int outputFBO = 0, output = 0;
+    unsigned int outputFramebuffer = 0, outputTexture = 0;
+    glm::vec2 outputUvScale = glm::vec2(1.0f);
+    unsigned int emptyVAO = 0;
+
+    static unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum filter, int width, int height)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    static unsigned int createFramebuffer(unsigned int texture)
+    {
+        unsigned int framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::ANTI_ALIASING:: framebuffer is not complete" << endl;
+        return framebuffer;
+    }
+
+    void createTargets(int newWidth, int newHeight)
+    {
+        width = targetWidth = newWidth;
+        height = targetHeight = newHeight;
+        edges = createTarget(GL_RG8, GL_RG, GL_NEAREST, targetWidth, targetHeight);
+        edgesFBO = createFramebuffer(edges);
+        weights = createTarget(GL_RGBA8, GL_RGBA, GL_NEAREST, targetWidth, targetHeight);
+        weightsFBO = createFramebuffer(weights);
+        // the upscale filters the output
+        output = createTarget(GL_RGBA8, GL_RGBA, GL_LINEAR, targetWidth, targetHeight);
+        outputFBO = createFramebuffer(output);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(1, &edgesFBO);
+        glDeleteTextures(1, &edges);
+        glDeleteFramebuffers(1, &weightsFBO);
+        glDeleteTextures(1, &weights);
+        glDeleteFramebuffers(1, &outputFBO);
+        glDeleteTextures(1, &output);
+        edgesFBO = edges = weightsFBO = weights = outputFBO = output = 0;
+    }
+};
+
+// renders a fixed number of frames in every anti-aliasing mode and prints the average GPU frame time and
+// the estimated extra bandwidth of each. Update is called once per frame before the scene framebuffer is
+// set up and returns the mode to draw with; the first frames after a switch aren't measured, they still
+// carry GPU timer results of the previous mode.
+class AntiAliasingBenchmark
+{
+public:
+    static const int WarmupFrames = 30;
+    static const int MeasuredFrames = 120;
+
+    bool Running() const { return running; }
+
+    void Start(AntiAliasingMode currentMode)
+    {
+        running = true;
+        restoreMode = currentMode;
+        beginMode(AntiAliasingNone);
+        cout << "AA_BENCHMARK:: " << WarmupFrames + MeasuredFrames << " frames per mode" << endl;
+    }
+
+    // frameSamples changes whenever frameMilliseconds is a new measurement
+    AntiAliasingMode Update(unsigned int frameSamples, double frameMilliseconds, int width, int height)
+    {
+        if (!running)
+            return restoreMode;
+        if (frames < WarmupFrames)
+            frames++;
+        else if (frameSamples != lastSample)
+        {
+            totalMilliseconds += frameMilliseconds;
+            measured++;
+        }
+        lastSample = frameSamples;
+        if (measured < MeasuredFrames)
+            return mode;
+
+        milliseconds[mode] = totalMilliseconds / measured;
+        if (mode + 1 < AntiAliasingModeCount)
+        {
+            beginMode((AntiAliasingMode)(mode + 1));
+            return mode;
+        }
+
+        cout << "AA_BENCHMARK:: " << width << "x" << height << endl;
+        for (int i = 0; i < AntiAliasingModeCount; i++)
+        {
+            AntiAliasingMode m = (AntiAliasingMode)i;
+            double megabytes = AntiAliasing::BytesPerPixel(m) * width * height / (1024.0 * 1024.0);
+            cout << "AA_BENCHMARK:: " << setw(8) << AntiAliasing::Name(m) << fixed << setprecision(2)
+                 << setw(8) << milliseconds[i] << " ms (" << showpos << milliseconds[i] - milliseconds[0]
+                 << noshowpos << "), ~" << setw(7) << megabytes << " MB/frame extra" << defaultfloat << endl;
+        }
+        running = false;
+        return restoreMode;
+    }
+
+private:
+    bool running = false;
+    AntiAliasingMode mode = AntiAliasingNone;
+    AntiAliasingMode restoreMode = AntiAliasingNone;
+    int frames = 0;
+    int measured = 0;
+    double totalMilliseconds = 0.0;
+    unsigned int lastSample = 0;
+    double milliseconds[AntiAliasingModeCount] = {};
+
+    void beginMode(AntiAliasingMode newMode)
+    {
+        mode = newMode;
+        frames = measured = 0;
+        totalMilliseconds = 0.0;
+    }
+};
+#endif
@@ -0,0 +1,249 @@
+#ifndef DEBUG_DRAW_H
+#define DEBUG_DRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/stream_buffer.h>
+#include <rg/Frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+using namespace std;
+
+// batches debug primitives (light bulbs, bounding boxes, lines) for one frame. The calls only append to
+// CPU arrays; Draw copies them into the frame's stream buffer and issues one call per primitive type:
+//   solid cubes, solid spheres, wire boxes: instanced, indexed unit shapes with a model matrix and a
+//                                          colour per instance
+//   lines:                                 two vertices with a colour each, one GL_LINES draw
+// and clears the arrays for the next frame. The shapes share one vertex/index buffer; the instances of
+// all three go into one allocation one after another, the attributes are pointed at each type's part
+// before its draw.
+class DebugDraw
+{
+public:
+    // the primitives are streamed through stream, which has to be in a frame (BeginFrame) when Draw runs
+    void Init(StreamBuffer& stream)
+    {
+        this->stream = &stream;
+
+        // unit cube around the origin, its triangles and its edges share the 8 corners
+        vector<glm::vec3> vertices;
+        for (int i = 0; i < 8; i++)
+            vertices.push_back(glm::vec3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f));
+        vector<unsigned int> indices = {
+            0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   // -z, +z
+            0, 1, 4, 1, 5, 4,   2, 6, 3, 3, 6, 7,   // -y, +y
+            0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5    // -x, +x
+        };
+        cubeIndexCount = indices.size();
+        wireBoxFirstIndex = indices.size();
+        indices.insert(indices.end(), {
+            0, 1, 2, 3, 4, 5, 6, 7,  // along x
+            0, 2, 1, 3, 4, 6, 5, 7,  // along y
+            0, 4, 1, 5, 2, 6, 3, 7   // along z
+        });
+        wireBoxIndexCount = indices.size() - wireBoxFirstIndex;
+
+        // unit sphere
+        const int rings = 8, segments = 12;
+        const float pi = 3.14159265f;
+        sphereBaseVertex = vertices.size();
+        sphereFirstIndex = indices.size();
+        for (int r = 0; r <= rings; r++)
+        {
+            float theta = pi * r / rings;
+            for (int s = 0; s <= segments; s++)
+            {
+                float phi = 2.0f * pi * s / segments;
+                vertices.push_back(glm::vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+            }
+        }
+        for (int r = 0; r < rings; r++)
+        {
+            for (int s = 0; s < segments; s++)
+            {
+                unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+                indices.insert(indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+            }
+        }
+        sphereIndexCount = indices.size() - sphereFirstIndex;
+
+        glGenVertexArrays(1, &shapeVAO);
+        glGenBuffers(1, &shapeVBO);
+        glGenBuffers(1, &shapeEBO);
+        glBindVertexArray(shapeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, shapeVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shapeEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(ModelAttribute + column);
+            glVertexAttribDivisor(ModelAttribute + column, 1);
+        }
+
+        // the model matrix attributes stay disabled for the lines, they read the identity set in Draw
+        glGenVertexArrays(1, &lineVAO);
+        glBindVertexArray(lineVAO);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void Cube(const glm::vec3& center, float size, const glm::vec4& color)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), center);
+        instances[SolidCube].push_back(Instance{ glm::scale(model, glm::vec3(size)), color });
+    }
+
+    void Sphere(const glm::vec3& center, float radius, const glm::vec4& color)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), center);
+        instances[SolidSphere].push_back(Instance{ glm::scale(model, glm::vec3(radius)), color });
+    }
+
+    // edges of the unit cube around the origin after transform
+    void WireBox(const glm::mat4& transform, const glm::vec4& color)
+    {
+        instances[WireBoxes].push_back(Instance{ transform, color });
+    }
+
+    void Aabb(const rg::Aabb& box, const glm::vec4& color)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), box.center());
+        WireBox(glm::scale(model, box.extent()), color);
+    }
+
+    void Line(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color)
+    {
+        lines.push_back(LineVertex{ from, color });
+        lines.push_back(LineVertex{ to, color });
+    }
+
+    // draws everything added since the last Draw with depth testing, then forgets it
+    void Draw(Shader& shader, const glm::mat4& projection, const glm::mat4& view)
+    {
+        drawCalls = 0;
+        primitives = lines.size() / 2;
+        size_t instanceCount = 0;
+        for (const vector<Instance>& list : instances)
+        {
+            instanceCount += list.size();
+            primitives += list.size();
+        }
+        if (primitives == 0)
+            return;
+
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+
+        StreamBuffer::Allocation allocation;
+        if (instanceCount > 0)
+            allocation = stream->Allocate(instanceCount * sizeof(Instance));
+        if (allocation.data)
+        {
+            Instance* destination = (Instance*)allocation.data;
+            for (const vector<Instance>& list : instances)
+                destination = std::copy(list.begin(), list.end(), destination);
+            stream->Commit(allocation);
+
+            glBindVertexArray(shapeVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, stream->Buffer());
+            size_t offset = allocation.offset;
+            for (int type = 0; type < ShapeTypeCount; type++)
+            {
+                unsigned int count = instances[type].size();
+                if (count == 0)
+                    continue;
+                glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, color)));
+                for (unsigned int column = 0; column < 4; column++)
+                    glVertexAttribPointer(ModelAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                          (void*)(offset + offsetof(Instance, model) + column * sizeof(glm::vec4)));
+                if (type == SolidCube)
+                    glDrawElementsInstanced(GL_TRIANGLES, cubeIndexCount, GL_UNSIGNED_INT, (void*)0, count);
+                else if (type == WireBoxes)
+                    glDrawElementsInstanced(GL_LINES, wireBoxIndexCount, GL_UNSIGNED_INT,
+                                            (void*)(wireBoxFirstIndex * sizeof(unsigned int)), count);
+                else
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT,
+                                                      (void*)(sphereFirstIndex * sizeof(unsigned int)), count, sphereBaseVertex);
+                drawCalls++;
+                offset += count * sizeof(Instance);
+            }
+        }
+
+        StreamBuffer::Allocation lineAllocation;
+        if (!lines.empty())
+            lineAllocation = stream->Write(lines.data(), lines.size() * sizeof(LineVertex));
+        if (lineAllocation.data)
+        {
+            glBindVertexArray(lineVAO);
+            glBindBuffer(GL_ARRAY_BUFFER, stream->Buffer());
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)lineAllocation.offset);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LineVertex),
+                                  (void*)(lineAllocation.offset + offsetof(LineVertex, color)));
+            for (unsigned int column = 0; column < 4; column++)
+                glVertexAttrib4f(ModelAttribute + column, column == 0, column == 1, column == 2, column == 3);
+            glDrawArrays(GL_LINES, 0, lines.size());
+            drawCalls++;
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        for (vector<Instance>& list : instances)
+            list.clear();
+        lines.clear();
+    }
+
+    // of the last Draw
+    unsigned int DrawCallCount() const { return drawCalls; }
+    unsigned int PrimitiveCount() const { return primitives; }
+
+    void deleteBuffers()
+    {
+        glDeleteVertexArrays(1, &shapeVAO);
+        glDeleteVertexArrays(1, &lineVAO);
+        glDeleteBuffers(1, &shapeVBO);
+        glDeleteBuffers(1, &shapeEBO);
+        shapeVAO = lineVAO = shapeVBO = shapeEBO = 0;
+    }
+
+private:
+    static const unsigned int ModelAttribute = 2; // 2-5, see debug_draw.vs
+    enum ShapeType { SolidCube, SolidSphere, WireBoxes, ShapeTypeCount };
+
+    struct Instance
+    {
+        glm::mat4 model;
+        glm::vec4 color;
+    };
+
+    struct LineVertex
+    {
+        glm::vec3 position;
+        glm::vec4 color;
+    };
+
+    vector<Instance> instances[ShapeTypeCount];
+    vector<LineVertex> lines;
+
+    unsigned int shapeVAO = 0, shapeVBO = 0, shapeEBO = 0;
+    unsigned int lineVAO = 0;
+    StreamBuffer* stream = nullptr;
+    unsigned int cubeIndexCount = 0;
+    unsigned int wireBoxFirstIndex = 0, wireBoxIndexCount = 0;
+    unsigned int sphereBaseVertex = 0, sphereFirstIndex = 0, sphereIndexCount = 0;
+    unsigned int drawCalls = 0, primitives = 0;
+};
+#endif
@@ -0,0 +1,280 @@
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// deferred alternative to the forward lighting shaders. The lit models are drawn into a G-buffer:
+//   target 0, RGBA8:     albedo, specular mask
+//   target 1, RGB10_A2:  octahedral normal (2 x 10 bit), shininess / 1023
+//   depth, 24 bit:       positions are reconstructed from it with the inverse view projection
+// so a pixel stores 8 bytes next to its depth. Every light is then drawn once over the pixels it can
+// reach and adds its contribution (see deferred_light.fs): a point light as the back faces of a sphere
+// as big as its attenuation range, tested with GL_GEQUAL against the scene depth, a spot light or a point
+// light containing the camera as one fullscreen triangle.
+//
+// EndGeometryPass copies the depth into the scene framebuffer, so forward drawn objects after the
+// lighting are still depth tested against the models. Its depth has to be 24 bit depth / 8 bit stencil
+// (what GLFW creates by default) for that copy.
+class DeferredRenderer
+{
+public:
+    // a point light stops being drawn where it adds less than this to any channel
+    float lightCutoff = 1.0f / 256.0f;
+
+    void Init(int width, int height)
+    {
+        createTargets(width, height);
+
+        // sphere with its vertices pushed out so the flat faces still contain the unit sphere
+        const int rings = 12, segments = 16;
+        const float pi = 3.14159265f;
+        float scale = 1.0f / cos(pi / segments);
+        vector<glm::vec3> vertices;
+        for (int r = 0; r <= rings; r++)
+        {
+            float theta = pi * r / rings;
+            for (int s = 0; s <= segments; s++)
+            {
+                float phi = 2.0f * pi * s / segments;
+                vertices.push_back(scale * glm::vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+            }
+        }
+        vector<unsigned int> indices;
+        for (int r = 0; r < rings; r++)
+        {
+            for (int s = 0; s < segments; s++)
+            {
+                unsigned int a = r * (segments + 1) + s, b = a + segments + 1;
+                // counter clockwise seen from outside
+                indices.insert(indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+            }
+        }
+        sphereIndexCount = indices.size();
+        glGenVertexArrays(1, &sphereVAO);
+        glGenBuffers(1, &sphereVBO);
+        glGenBuffers(1, &sphereEBO);
+        glBindVertexArray(sphereVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // the fullscreen triangle is made from gl_VertexID, it needs no attributes
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // size of the area drawn to, from the bottom left corner. The targets are only reallocated when they
+    // have to grow, so a resolution that changes every frame doesn't allocate
+    void Resize(int newWidth, int newHeight)
+    {
+        if (newWidth > targetWidth || newHeight > targetHeight)
+        {
+            int grownWidth = std::max(newWidth, targetWidth), grownHeight = std::max(newHeight, targetHeight);
+            deleteTargets();
+            createTargets(grownWidth, grownHeight);
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+
+    // binds and clears the G-buffer, the models are drawn next with the gbuffer shaders
+    void BeginGeometryPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // copies the depth to the scene framebuffer and leaves it bound
+    void EndGeometryPass(unsigned int sceneFramebuffer = 0)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    }
+
+    // binds the G-buffer to the light shader, which has to have its light uniforms set already
+    void BeginLighting(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition)
+    {
+        this->cameraPosition = cameraPosition;
+        lightVolumes = lightsFullscreen = 0;
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        shader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+        shader.setVec2("screenSize", glm::vec2(width, height));
+        const unsigned int targets[] = { albedoSpecular, normalShininess, depth };
+        const char* names[] = { "gAlbedoSpec", "gNormalShininess", "gDepth" };
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, targets[i]);
+            shader.setInt(names[i], i);
+        }
+
+        glDepthMask(GL_FALSE);
+        // the first light replaces the colour of the lit pixels, the ones after it add to it
+        glDisable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_ONE, GL_ONE);
+        firstLight = true;
+    }
+
+    // lightIndex picks the light uniform the shader evaluates, intensity is the brightest channel of
+    // ambient + diffuse + specular, which decides how far the light reaches
+    void DrawPointLight(Shader& shader, int lightIndex, const glm::vec3& position, float intensity,
+                        float constant, float linear, float quadratic)
+    {
+        float radius = LightRadius(intensity, constant, linear, quadratic, lightCutoff);
+        shader.setInt("lightIndex", lightIndex);
+        if (firstLight || glm::length(cameraPosition - position) < radius * 1.05f + 0.1f)
+        {
+            // the near plane would cut into the sphere, and the first light has to reach every lit pixel
+            drawFullscreen(shader);
+            return;
+        }
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+        model = glm::scale(model, glm::vec3(radius));
+        shader.setMat4("model", model);
+        shader.setBool("fullscreen", false);
+        beginLight();
+        // back faces behind the far plane are clamped instead of clipped
+        glEnable(GL_DEPTH_CLAMP);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+        glDepthFunc(GL_GEQUAL);
+        glBindVertexArray(sphereVAO);
+        glDrawElements(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+        glDepthFunc(GL_LESS);
+        glCullFace(GL_BACK);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_CLAMP);
+        lightVolumes++;
+    }
+
+    // lights without a range (the camera's spot light) cover the whole screen
+    void DrawFullscreenLight(Shader& shader, int lightIndex)
+    {
+        shader.setInt("lightIndex", lightIndex);
+        drawFullscreen(shader);
+    }
+
+    void EndLighting()
+    {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // distance at which intensity / (constant + linear * d + quadratic * d^2) drops to cutoff
+    static float LightRadius(float intensity, float constant, float linear, float quadratic, float cutoff)
+    {
+        float c = constant - intensity / cutoff;
+        if (quadratic <= 0.0f)
+            return linear > 0.0f ? -c / linear : 1.0e4f;
+        return (-linear + sqrt(linear * linear - 4.0f * quadratic * c)) / (2.0f * quadratic);
+    }
+
+    unsigned int LightVolumeCount() const { return lightVolumes; }         // in the last lighting pass
+    unsigned int FullscreenLightCount() const { return lightsFullscreen; }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteVertexArrays(1, &sphereVAO);
+        glDeleteVertexArrays(1, &emptyVAO);
+        glDeleteBuffers(1, &sphereVBO);
+        glDeleteBuffers(1, &sphereEBO);
+        sphereVAO = emptyVAO = sphereVBO = sphereEBO = 0;
+    }
+
+private:
+    int width = 0, height = 0;             // drawn area
+    int targetWidth = 0, targetHeight = 0; // allocated
+    unsigned int FBO = 0;
+    unsigned int albedoSpecular = 0, normalShininess = 0, depth = 0;
+    unsigned int sphereVAO = 0, sphereVBO = 0, sphereEBO = 0, sphereIndexCount = 0;
+    unsigned int emptyVAO = 0;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    bool firstLight = true;
+    unsigned int lightVolumes = 0, lightsFullscreen = 0;
+
+    void beginLight()
+    {
+        if (!firstLight)
+            glEnable(GL_BLEND);
+        firstLight = false;
+    }
+
+    void drawFullscreen(Shader& shader)
+    {
+        shader.setBool("fullscreen", true);
+        beginLight();
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+        lightsFullscreen++;
+    }
+
+    static unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void createTargets(int newWidth, int newHeight)
+    {
+        width = targetWidth = newWidth;
+        height = targetHeight = newHeight;
+        albedoSpecular = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+        normalShininess = createTarget(GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, width, height);
+        depth = createTarget(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoSpecular, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalShininess, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        const GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::DEFERRED_RENDERER:: G-buffer is not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &albedoSpecular);
+        glDeleteTextures(1, &normalShininess);
+        glDeleteTextures(1, &depth);
+        FBO = albedoSpecular = normalShininess = depth = 0;
+    }
+};
+#endif
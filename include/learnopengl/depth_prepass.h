@@ -0,0 +1,166 @@
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+#include <vector>
+using namespace std;
+
+// state switching for a depth pre-pass: the enabled object classes (picked by the caller, e.g. the static
+// batch, the models, the floor) are first drawn with a position-only shader and colour writes off, then
+// shaded with GL_EQUAL and depth writes off, so every pixel runs the lighting shader once at most.
+// Both passes must compute gl_Position the same way (invariant gl_Position, see depth_prepass.vs).
+//
+// With measure on, the samples passing the depth test are counted with GL_SAMPLES_PASSED queries in both
+// passes. The pre-pass runs with GL_LESS in the same order as the shading pass, so its count is what the
+// shading pass would shade without it (given early depth testing); the difference is the shading work saved.
+// Queries are read back only once their results are available.
+//
+// A class can also be required by a pass that needs the complete depth before shading (SSAO), it then
+// takes part whether it is enabled or not.
+class DepthPrepass
+{
+public:
+    bool measure = false;
+
+    struct ClassStats
+    {
+        GLuint depthSamples = 0;   // would be shaded without the pre-pass
+        GLuint shadedSamples = 0;  // shaded with GL_EQUAL
+    };
+
+    explicit DepthPrepass(unsigned int classCount) : classes(classCount) {}
+
+    void SetEnabled(unsigned int objectClass, bool enabled) { classes[objectClass].enabled = enabled; }
+    bool IsEnabled(unsigned int objectClass) const { return classes[objectClass].enabled; }
+    void Toggle(unsigned int objectClass) { classes[objectClass].enabled = !classes[objectClass].enabled; }
+    void SetRequired(unsigned int objectClass, bool required) { classes[objectClass].required = required; }
+    // enabled or required
+    bool IsActive(unsigned int objectClass) const { return active(classes[objectClass]); }
+
+    // reads last frames' measurements if the GPU is done with them
+    void BeginFrame()
+    {
+        measuring = false;
+        if (!measure)
+            return;
+        if (inFlight)
+        {
+            for (const ClassState& c : classes)
+            {
+                if (!c.queried)
+                    continue;
+                GLuint available = GL_FALSE;
+                glGetQueryObjectuiv(c.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available)
+                    return;
+            }
+            for (ClassState& c : classes)
+            {
+                if (!c.queried)
+                    continue;
+                glGetQueryObjectuiv(c.queries[0], GL_QUERY_RESULT, &c.stats.depthSamples);
+                glGetQueryObjectuiv(c.queries[1], GL_QUERY_RESULT, &c.stats.shadedSamples);
+                c.queried = false;
+            }
+            inFlight = false;
+            resultsReady = true;
+        }
+        for (ClassState& c : classes)
+            if (!c.queries[0])
+                glGenQueries(2, c.queries);
+        measuring = true;
+    }
+
+    // colour writes off for the depth-only draws of the enabled classes
+    void BeginDepthPass()
+    {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+
+    void EndDepthPass()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    // false if the class isn't in the pre-pass, otherwise its depth draws follow until EndDepth
+    bool BeginDepth(unsigned int objectClass)
+    {
+        ClassState& c = classes[objectClass];
+        if (!active(c))
+            return false;
+        if (measuring)
+            glBeginQuery(GL_SAMPLES_PASSED, c.queries[0]);
+        return true;
+    }
+
+    void EndDepth(unsigned int objectClass)
+    {
+        if (measuring)
+            glEndQuery(GL_SAMPLES_PASSED);
+    }
+
+    // shading draws of a class that was in the pre-pass only pass where they wrote the depth
+    void BeginShading(unsigned int objectClass)
+    {
+        ClassState& c = classes[objectClass];
+        if (!active(c))
+            return;
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+        if (measuring)
+            glBeginQuery(GL_SAMPLES_PASSED, c.queries[1]);
+    }
+
+    void EndShading(unsigned int objectClass)
+    {
+        ClassState& c = classes[objectClass];
+        if (!active(c))
+            return;
+        if (measuring)
+        {
+            glEndQuery(GL_SAMPLES_PASSED);
+            c.queried = true;
+            inFlight = true;
+        }
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    // the newest complete measurement, false until there is one
+    bool Stats(unsigned int objectClass, ClassStats& stats) const
+    {
+        stats = classes[objectClass].stats;
+        return resultsReady && active(classes[objectClass]);
+    }
+
+    void deleteBuffers()
+    {
+        for (ClassState& c : classes)
+        {
+            if (c.queries[0])
+                glDeleteQueries(2, c.queries);
+            c.queries[0] = c.queries[1] = 0;
+        }
+    }
+
+private:
+    struct ClassState
+    {
+        bool enabled = false;
+        bool required = false;
+        bool queried = false;
+        GLuint queries[2] = { 0, 0 }; // depth pass, shading pass
+        ClassStats stats;
+    };
+
+    vector<ClassState> classes;
+    bool measuring = false;
+    bool inFlight = false;
+    bool resultsReady = false;
+
+    static bool active(const ClassState& c) { return c.enabled || c.required; }
+};
+#endif
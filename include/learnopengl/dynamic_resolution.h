@@ -0,0 +1,279 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gpu_timer.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// renders the scene at a fraction of the window resolution picked from the measured GPU frame time, then
+// upscales it to the default framebuffer with a sharpening filter (upscale_sharpen.fs).
+//
+// The scene framebuffer (R11G11B10F colour, the lighting isn't clamped) is allocated once at the window
+// size and the scaled frame is drawn into its bottom left corner, so changing the scale never reallocates
+// anything. The scale is driven by a PID controller in velocity form on the relative error
+// (target - measured) / target, fed only when the GPU timer has a new measurement; the timer lags a few
+// frames behind, which the small gains account for.
+//
+// With more than one sample per pixel (SetSamples) the scene is drawn into multisampled renderbuffers of
+// the same size instead, and Resolve averages them into the colour texture.
+class DynamicResolution
+{
+public:
+    bool enabled = true;
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    double targetMilliseconds = 16.0;
+    float sharpness = 0.5f;
+
+    // controller gains, per measurement
+    float proportionalGain = 0.25f;
+    float integralGain = 0.05f;
+    float derivativeGain = 0.05f;
+
+    void Init(int width, int height)
+    {
+        createTargets(width, height);
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // 1 for no multisampling. Takes effect from the next BeginFrame
+    void SetSamples(int newSamples)
+    {
+        if (newSamples == samples)
+            return;
+        deleteMultisampleTargets();
+        samples = newSamples;
+        if (samples > 1 && targetWidth > 0)
+            createMultisampleTargets();
+    }
+
+    // updates the scale from the newest GPU frame time, binds the scene framebuffer with the scaled viewport
+    // and starts timing the frame
+    void BeginFrame(int framebufferWidth, int framebufferHeight)
+    {
+        if (framebufferWidth != targetWidth || framebufferHeight != targetHeight)
+        {
+            deleteTargets();
+            createTargets(framebufferWidth, framebufferHeight);
+        }
+
+        double milliseconds;
+        if (frameTimer.Samples() != lastSample && frameTimer.Milliseconds(milliseconds))
+        {
+            lastSample = frameTimer.Samples();
+            frameMilliseconds = milliseconds;
+            updateScale();
+        }
+        float currentScale = enabled ? scale : 1.0f;
+        renderWidth = std::max(1, (int)std::lround(targetWidth * currentScale));
+        renderHeight = std::max(1, (int)std::lround(targetHeight * currentScale));
+
+        glBindFramebuffer(GL_FRAMEBUFFER, Framebuffer());
+        glViewport(0, 0, renderWidth, renderHeight);
+        frameTimer.Begin();
+    }
+
+    // averages the samples into the colour texture and takes one depth sample per pixel, nothing to do
+    // without multisampling
+    void Resolve()
+    {
+        if (samples <= 1)
+            return;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight,
+                          GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    }
+
+    // only the depth, for passes that read it before the frame is finished (SSAO after the depth pre-pass).
+    // Leaves Framebuffer() bound
+    void ResolveDepth()
+    {
+        if (samples <= 1)
+            return;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, multisampleFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, multisampleFBO);
+    }
+
+    void EndFrame()
+    {
+        frameTimer.End();
+    }
+
+    // draws the scaled frame to the default framebuffer at full size and leaves it bound. The source is the
+    // final image of the frame (after tone mapping) drawn to its bottom left RenderWidth x RenderHeight,
+    // which covers sourceUvScale of the texture; its target may be larger than the scene target.
+    void Upscale(Shader& shader, unsigned int sourceFramebuffer, unsigned int sourceTexture, const glm::vec2& sourceUvScale)
+    {
+        if (renderWidth == targetWidth && renderHeight == targetHeight)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, sourceFramebuffer);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, targetWidth, targetHeight,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, targetWidth, targetHeight);
+            return;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, targetWidth, targetHeight);
+        shader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sourceTexture);
+        shader.setInt("scene", 0);
+        shader.setVec2("uvScale", sourceUvScale);
+        shader.setFloat("sharpness", sharpness);
+
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // the framebuffer the scene is drawn into, the multisampled one if there is one
+    unsigned int Framebuffer() const { return samples > 1 ? multisampleFBO : FBO; }
+    int Samples() const { return samples; }
+    unsigned int ColorTexture() const { return color; }
+    unsigned int DepthTexture() const { return depth; }
+    // part of the scene textures covered by the frame
+    glm::vec2 UvScale() const { return glm::vec2((float)renderWidth / targetWidth, (float)renderHeight / targetHeight); }
+    int RenderWidth() const { return renderWidth; }
+    int RenderHeight() const { return renderHeight; }
+    float Scale() const { return enabled ? scale : 1.0f; }
+    // newest measured GPU time of the frame, 0 until there is one
+    double FrameMilliseconds() const { return frameMilliseconds; }
+    // changes when FrameMilliseconds has a new measurement
+    unsigned int FrameSamples() const { return lastSample; }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+        frameTimer.deleteQueries();
+    }
+
+private:
+    int targetWidth = 0, targetHeight = 0;
+    int renderWidth = 0, renderHeight = 0;
+    unsigned int FBO = 0;
+    unsigned int color = 0;
+    unsigned int depth = 0;
+    unsigned int emptyVAO = 0;
+    int samples = 1;
+    unsigned int multisampleFBO = 0;
+    unsigned int multisampleColorRBO = 0, multisampleDepthRBO = 0;
+
+    GpuTimer frameTimer;
+    unsigned int lastSample = 0;
+    double frameMilliseconds = 0.0;
+    float scale = 1.0f;
+    float previousError = 0.0f, olderError = 0.0f;
+
+    void updateScale()
+    {
+        float error = (float)((targetMilliseconds - frameMilliseconds) / targetMilliseconds);
+        if (!enabled)
+        {
+            // start from the full resolution again when turned back on
+            scale = maxScale;
+            previousError = olderError = 0.0f;
+            return;
+        }
+        float change = proportionalGain * (error - previousError)
+                     + integralGain * error
+                     + derivativeGain * (error - 2.0f * previousError + olderError);
+        // GPU time grows with the pixel count, i.e. with the square of the scale
+        scale = std::min(maxScale, std::max(minScale, scale + change * 0.5f));
+        olderError = previousError;
+        previousError = error;
+    }
+
+    void createTargets(int width, int height)
+    {
+        targetWidth = width;
+        targetHeight = height;
+        glGenTextures(1, &color);
+        glBindTexture(GL_TEXTURE_2D, color);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // a texture, the temporal passes reconstruct positions from it
+        glGenTextures(1, &depth);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::DYNAMIC_RESOLUTION:: framebuffer is not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (samples > 1)
+            createMultisampleTargets();
+    }
+
+    void createMultisampleTargets()
+    {
+        GLint maxSamples = 1;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        if (samples > maxSamples)
+        {
+            cout << "ERROR::DYNAMIC_RESOLUTION:: " << samples << " samples requested, at most " << maxSamples << " supported" << endl;
+            samples = maxSamples;
+        }
+        glGenRenderbuffers(1, &multisampleColorRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, multisampleColorRBO);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_R11F_G11F_B10F, targetWidth, targetHeight);
+        glGenRenderbuffers(1, &multisampleDepthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, multisampleDepthRBO);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, targetWidth, targetHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &multisampleFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, multisampleFBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, multisampleColorRBO);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, multisampleDepthRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::DYNAMIC_RESOLUTION:: multisampled framebuffer is not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void deleteMultisampleTargets()
+    {
+        glDeleteFramebuffers(1, &multisampleFBO);
+        glDeleteRenderbuffers(1, &multisampleColorRBO);
+        glDeleteRenderbuffers(1, &multisampleDepthRBO);
+        multisampleFBO = multisampleColorRBO = multisampleDepthRBO = 0;
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &color);
+        glDeleteTextures(1, &depth);
+        FBO = color = depth = 0;
+        deleteMultisampleTargets();
+    }
+};
+#endif
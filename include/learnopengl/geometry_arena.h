@@ -0,0 +1,352 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <vector>
+using namespace std;
+
+// first-fit sub-allocator over a range of elements [0, capacity), free blocks are kept sorted by offset
+// so neighbouring blocks can be merged when a range is released.
+class RangeAllocator
+{
+public:
+    static const unsigned int InvalidOffset = 0xFFFFFFFFu;
+
+    explicit RangeAllocator(unsigned int capacity = 0) { Reset(capacity); }
+
+    void Reset(unsigned int newCapacity)
+    {
+        capacity = newCapacity;
+        used = 0;
+        freeBlocks.clear();
+        if (capacity > 0)
+            freeBlocks[0] = capacity;
+    }
+
+    unsigned int Allocate(unsigned int count)
+    {
+        if (count == 0)
+            return InvalidOffset;
+        for (auto it = freeBlocks.begin(); it != freeBlocks.end(); ++it)
+        {
+            if (it->second < count)
+                continue;
+            unsigned int offset = it->first;
+            unsigned int remaining = it->second - count;
+            freeBlocks.erase(it);
+            if (remaining > 0)
+                freeBlocks[offset + count] = remaining;
+            used += count;
+            return offset;
+        }
+        return InvalidOffset;
+    }
+
+    void Free(unsigned int offset, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        used -= count;
+        auto it = freeBlocks.emplace(offset, count).first;
+        // merge with the following block
+        auto next = std::next(it);
+        if (next != freeBlocks.end() && it->first + it->second == next->first)
+        {
+            it->second += next->second;
+            freeBlocks.erase(next);
+        }
+        // merge with the preceding block
+        if (it != freeBlocks.begin())
+        {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second == it->first)
+            {
+                prev->second += it->second;
+                freeBlocks.erase(it);
+            }
+        }
+    }
+
+    // adds [capacity, newCapacity) to the free list
+    void Grow(unsigned int newCapacity)
+    {
+        if (newCapacity <= capacity)
+            return;
+        unsigned int oldCapacity = capacity;
+        capacity = newCapacity;
+        used += newCapacity - oldCapacity;
+        Free(oldCapacity, newCapacity - oldCapacity);
+    }
+
+    unsigned int Capacity() const { return capacity; }
+    unsigned int Used() const { return used; }
+    unsigned int FreeBlockCount() const { return freeBlocks.size(); }
+
+    unsigned int LargestFreeBlock() const
+    {
+        unsigned int largest = 0;
+        for (const auto& block : freeBlocks)
+            largest = std::max(largest, block.second);
+        return largest;
+    }
+
+private:
+    unsigned int capacity = 0;
+    unsigned int used = 0;
+    map<unsigned int, unsigned int> freeBlocks; // offset -> size
+};
+
+// where a mesh lives inside the arena, offsets are in elements (vertices / indices), not bytes
+struct GeometryRange {
+    unsigned int baseVertex = 0;
+    unsigned int vertexCount = 0;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+};
+
+// one large vertex buffer and index buffer shared by every mesh of the same vertex format.
+// Meshes keep a handle instead of their own VAO/VBO/EBO and are drawn with glDrawElementsBaseVertex,
+// so all of them go through a single VAO. Indices stay relative to the mesh's first vertex.
+// A second VAO (BindPositions) only enables attribute 0, for depth-only passes; vertices have to start
+// with their position as 3 floats.
+class GeometryArena
+{
+public:
+    typedef unsigned int Handle;
+    typedef void (*AttributeSetup)();
+    static const Handle InvalidHandle = 0xFFFFFFFFu;
+
+    GeometryArena(unsigned int vertexStride, AttributeSetup setupAttributes,
+                  unsigned int vertexCapacity = 1 << 18, unsigned int indexCapacity = 1 << 20)
+        : vertexStride(vertexStride), setupAttributes(setupAttributes),
+          vertexAllocator(vertexCapacity), indexAllocator(indexCapacity)
+    {
+        glGenVertexArrays(1, &VAO);
+        glGenVertexArrays(1, &positionVAO);
+        createBuffers(vertexCapacity, indexCapacity, VBO, EBO);
+        bindBuffersToVAO();
+    }
+
+    // like Shader::deleteProgram, has to be called while the context is still current
+    void deleteBuffers()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteVertexArrays(1, &positionVAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = positionVAO = VBO = EBO = 0;
+    }
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // copies the data into the shared buffers, growing them if there is no free block large enough.
+    // An empty vertex or index list gets offset 0 without taking any space
+    Handle Upload(const void* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount)
+    {
+        unsigned int baseVertex = allocateOrGrow(vertexAllocator, vertexCount, true);
+        unsigned int firstIndex = allocateOrGrow(indexAllocator, indexCount, false);
+
+        if (vertexCount > 0)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)baseVertex * vertexStride, (GLsizeiptr)vertexCount * vertexStride, vertexData);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        if (indexCount > 0)
+        {
+            // the element buffer is VAO state, bind it through GL_COPY_WRITE_BUFFER to leave other VAOs alone
+            glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * sizeof(unsigned int), (GLsizeiptr)indexCount * sizeof(unsigned int), indexData);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        GeometryRange range;
+        range.baseVertex = baseVertex;
+        range.vertexCount = vertexCount;
+        range.firstIndex = firstIndex;
+        range.indexCount = indexCount;
+
+        Handle handle;
+        if (!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+            ranges[handle] = range;
+            alive[handle] = true;
+        }
+        else
+        {
+            handle = ranges.size();
+            ranges.push_back(range);
+            alive.push_back(true);
+        }
+        return handle;
+    }
+
+    void Free(Handle handle)
+    {
+        if (handle >= ranges.size() || !alive[handle])
+            return;
+        // empty parts were never allocated, RangeAllocator::Free ignores a count of 0
+        vertexAllocator.Free(ranges[handle].baseVertex, ranges[handle].vertexCount);
+        indexAllocator.Free(ranges[handle].firstIndex, ranges[handle].indexCount);
+        alive[handle] = false;
+        freeHandles.push_back(handle);
+    }
+
+    const GeometryRange& Range(Handle handle) const { return ranges[handle]; }
+
+    void Bind() const { glBindVertexArray(VAO); }
+    void BindPositions() const { glBindVertexArray(positionVAO); }
+
+    void Draw(Handle handle) const
+    {
+        Draw(handle, 0, ranges[handle].indexCount);
+    }
+
+    // draws part of a range, firstIndex is relative to the range (e.g. one LOD of a mesh)
+    void Draw(Handle handle, unsigned int firstIndex, unsigned int indexCount) const
+    {
+        const GeometryRange& range = ranges[handle];
+        glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT,
+                                 (void*)((size_t)(range.firstIndex + firstIndex) * sizeof(unsigned int)), range.baseVertex);
+    }
+
+    // instanced version of the above, the per-instance attributes have to be set up on the bound VAO
+    void DrawInstanced(Handle handle, unsigned int firstIndex, unsigned int indexCount, unsigned int instanceCount) const
+    {
+        const GeometryRange& range = ranges[handle];
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT,
+                                          (void*)((size_t)(range.firstIndex + firstIndex) * sizeof(unsigned int)),
+                                          instanceCount, range.baseVertex);
+    }
+
+    // packs every live range to the front of fresh buffers so the free space becomes one block again.
+    // Handles stay valid, only the ranges they point to move.
+    void Defragment()
+    {
+        vector<Handle> order;
+        for (Handle h = 0; h < ranges.size(); h++)
+            if (alive[h])
+                order.push_back(h);
+
+        unsigned int newVBO, newEBO;
+        createBuffers(vertexAllocator.Capacity(), indexAllocator.Capacity(), newVBO, newEBO);
+
+        vertexAllocator.Reset(vertexAllocator.Capacity());
+        indexAllocator.Reset(indexAllocator.Capacity());
+        for (Handle h : order)
+        {
+            GeometryRange& range = ranges[h];
+            unsigned int baseVertex = range.vertexCount > 0 ? vertexAllocator.Allocate(range.vertexCount) : 0;
+            unsigned int firstIndex = range.indexCount > 0 ? indexAllocator.Allocate(range.indexCount) : 0;
+            copyRange(VBO, newVBO, range.baseVertex, baseVertex, range.vertexCount, vertexStride);
+            copyRange(EBO, newEBO, range.firstIndex, firstIndex, range.indexCount, sizeof(unsigned int));
+            range.baseVertex = baseVertex;
+            range.firstIndex = firstIndex;
+        }
+
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VBO = newVBO;
+        EBO = newEBO;
+        bindBuffersToVAO();
+    }
+
+    void PrintStats(const string& name) const
+    {
+        cout << "ARENA::" << name
+             << ": vertices " << vertexAllocator.Used() << "/" << vertexAllocator.Capacity()
+             << " (" << vertexAllocator.FreeBlockCount() << " free blocks)"
+             << ", indices " << indexAllocator.Used() << "/" << indexAllocator.Capacity()
+             << " (" << indexAllocator.FreeBlockCount() << " free blocks)" << endl;
+    }
+
+    unsigned int GetVAO() const { return VAO; }
+    unsigned int GetVertexBuffer() const { return VBO; }
+    unsigned int GetIndexBuffer() const { return EBO; }
+
+private:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int positionVAO = 0;
+    unsigned int vertexStride;
+    AttributeSetup setupAttributes;
+    RangeAllocator vertexAllocator;
+    RangeAllocator indexAllocator;
+    vector<GeometryRange> ranges;
+    vector<bool> alive;
+    vector<Handle> freeHandles;
+
+    void createBuffers(unsigned int vertexCapacity, unsigned int indexCapacity, unsigned int& vbo, unsigned int& ebo)
+    {
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertexCapacity * vertexStride, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void bindBuffersToVAO()
+    {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        setupAttributes();
+        glBindVertexArray(positionVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, vertexStride, (void*)0);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    static void copyRange(unsigned int src, unsigned int dst, unsigned int srcOffset, unsigned int dstOffset,
+                          unsigned int count, unsigned int elementSize)
+    {
+        if (count == 0)
+            return;
+        glBindBuffer(GL_COPY_READ_BUFFER, src);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                            (GLintptr)srcOffset * elementSize, (GLintptr)dstOffset * elementSize, (GLsizeiptr)count * elementSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // doubles the buffer (or more, if the request is huge) and copies the old contents over.
+    // Nothing is allocated for count 0, RangeAllocator can't hand out an empty block
+    unsigned int allocateOrGrow(RangeAllocator& allocator, unsigned int count, bool vertices)
+    {
+        if (count == 0)
+            return 0;
+        unsigned int offset = allocator.Allocate(count);
+        if (offset != RangeAllocator::InvalidOffset)
+            return offset;
+
+        unsigned int oldCapacity = allocator.Capacity();
+        unsigned int newCapacity = std::max(oldCapacity * 2, oldCapacity + count);
+        unsigned int elementSize = vertices ? vertexStride : sizeof(unsigned int);
+        unsigned int& buffer = vertices ? VBO : EBO;
+
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newCapacity * elementSize, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        copyRange(buffer, grown, 0, 0, oldCapacity, elementSize);
+        glDeleteBuffers(1, &buffer);
+        buffer = grown;
+        bindBuffersToVAO();
+
+        allocator.Grow(newCapacity);
+        return allocator.Allocate(count);
+    }
+};
+#endif
@@ -0,0 +1,80 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+// GPU time of a section of the frame from a pair of GL_TIMESTAMP queries. A few pairs rotate so reading
+// the result never waits for the GPU: Begin collects whatever has finished, and if all pairs are still in
+// flight that frame simply isn't measured. Unlike GL_TIME_ELAPSED queries, timed sections can overlap
+// and nest (e.g. the whole frame and a pass inside it).
+class GpuTimer
+{
+public:
+    static const unsigned int Latency = 4;
+
+    void Begin()
+    {
+        if (!queries[0][0])
+            glGenQueries(2 * Latency, &queries[0][0]);
+        for (unsigned int i = 0; i < Latency; i++)
+        {
+            unsigned int slot = (next + i) % Latency; // oldest first, so the newest result wins
+            if (!pending[slot])
+                continue;
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+            milliseconds = (end - begin) / 1.0e6;
+            samples++;
+            pending[slot] = false;
+        }
+        active = !pending[next];
+        if (active)
+            glQueryCounter(queries[next][0], GL_TIMESTAMP);
+    }
+
+    void End()
+    {
+        if (!active)
+            return;
+        glQueryCounter(queries[next][1], GL_TIMESTAMP);
+        pending[next] = true;
+        next = (next + 1) % Latency;
+        active = false;
+    }
+
+    // newest finished measurement, false until there is one
+    bool Milliseconds(double& result) const
+    {
+        result = milliseconds;
+        return samples > 0;
+    }
+
+    // how many measurements have been read so far, changes when Milliseconds has a new one
+    unsigned int Samples() const { return samples; }
+
+    void deleteQueries()
+    {
+        if (queries[0][0])
+            glDeleteQueries(2 * Latency, &queries[0][0]);
+        for (unsigned int i = 0; i < Latency; i++)
+        {
+            queries[i][0] = queries[i][1] = 0;
+            pending[i] = false;
+        }
+        samples = 0;
+    }
+
+private:
+    GLuint queries[Latency][2] = {}; // begin, end timestamps
+    bool pending[Latency] = {};
+    unsigned int next = 0;
+    bool active = false;
+    unsigned int samples = 0;
+    double milliseconds = 0.0;
+};
+#endif
@@ -0,0 +1,437 @@
+#ifndef INDIRECT_BATCH_H
+#define INDIRECT_BATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/lod_selector.h>
+#include <learnopengl/material_library.h>
+#include <learnopengl/model.h>
+#include <rg/GLExtensions.h>
+#include <rg/Meshlet.h>
+#include <rg/Frustum.h>
+#include <rg/Parallel.h>
+
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+// draws a fixed set of arena meshes (static scene objects) with one glMultiDrawElementsIndirect per
+// material group. The command buffer and the per-draw data are built once in Build().
+//
+// Every command gets its index as baseInstance, and a per-instance attribute (location 5) sourced from
+// a 0..N-1 buffer turns that into a draw id in the vertex shader (works without ARB_shader_draw_parameters).
+// The draw id indexes a texture buffer holding the model matrix and material index of each draw.
+// Built with a MaterialLibrary every draw selects its texture layers through that index, so the whole
+// batch is a single material group; without one, draws are grouped by the textures they bind.
+// On GL 3.3 the same shader is fed by a loop of glDrawElementsBaseVertex with the draw id set as a
+// constant attribute value.
+//
+// Meshes with LODs are drawn with the LOD picked by SelectLods, per draw since the same mesh can be
+// added with several transforms; only the count and firstIndex of the changed commands are rewritten.
+//
+// CullClusters replaces the per-draw commands for one frame: draws at LOD 0 are split into their meshlets,
+// the meshlets are culled against the frustum (and optionally by their normal cones) on all cores, and every
+// run of visible meshlets becomes one command. Draws at a coarser LOD are only tested as a whole.
+// An occlusion test (rg::OcclusionCuller, OcclusionQueries) can reject whole draws by their world box.
+//
+// DrawDepth submits the same commands through a second VAO that only reads positions and the draw id,
+// for a depth pre-pass ahead of Draw.
+class IndirectBatch
+{
+public:
+    static const unsigned int DrawIdAttribute = 5;
+    static const unsigned int DrawDataTextureUnit = 7;
+    static const unsigned int TexelsPerDraw = 5; // mat4 columns + (materialIndex, 0, 0, 0)
+
+    explicit IndirectBatch(GeometryArena& arena) : arena(arena) {}
+
+    // queues every mesh of the model, the model has to be loaded into the same arena
+    void Add(const Model& model, const glm::mat4& transform)
+    {
+        for (const Mesh& mesh : model.meshes)
+            Add(mesh, transform);
+    }
+
+    void Add(const Mesh& mesh, const glm::mat4& transform)
+    {
+        if (mesh.arena != &arena)
+        {
+            cout << "ERROR::INDIRECT_BATCH:: mesh is not stored in the batch's arena" << endl;
+            return;
+        }
+        PendingDraw draw;
+        draw.mesh = &mesh;
+        draw.transform = transform;
+        pending.push_back(draw);
+    }
+
+    // sorts the draws by material and uploads commands, per-draw data and the VAO.
+    // Has to be called again if the arena grows or gets defragmented, since the ranges and buffers move.
+    void Build(const MaterialLibrary* materialLibrary = nullptr)
+    {
+        deleteBuffers();
+        useIndirect = rg::glExt.multiDrawIndirect;
+        materials = materialLibrary;
+
+        std::stable_sort(pending.begin(), pending.end(), [this](const PendingDraw& a, const PendingDraw& b) {
+            return materialKey(*a.mesh) < materialKey(*b.mesh);
+        });
+
+        commands.clear();
+        groups.clear();
+        clusterTasks.clear();
+        visibility.clear();
+        meshletCount = 0;
+        culled = false;
+        vector<glm::vec4> drawData;
+        vector<GLuint> drawIds;
+        for (unsigned int i = 0; i < pending.size(); i++)
+        {
+            const Mesh& mesh = *pending[i].mesh;
+            if (groups.empty() || materialKey(*groups.back().material) != materialKey(mesh))
+            {
+                MaterialGroup group;
+                group.material = &mesh;
+                group.firstCommand = i;
+                groups.push_back(group);
+            }
+            groups.back().commandCount++;
+
+            const GeometryRange& range = arena.Range(mesh.arenaHandle);
+            rg::DrawElementsIndirectCommand command;
+            command.instanceCount = 1;
+            command.baseVertex = range.baseVertex;
+            command.baseInstance = i;
+            commands.push_back(command);
+            setLod(i, pending[i].lod);
+
+            // culling work is split into fixed size pieces of meshlets, each with its own slice of visibility flags
+            pending[i].firstVisibility = visibility.size();
+            for (unsigned int begin = 0; begin < mesh.meshletBounds.count; begin += MeshletsPerTask)
+            {
+                ClusterTask task;
+                task.draw = i;
+                task.begin = begin;
+                task.end = std::min(begin + MeshletsPerTask, mesh.meshletBounds.count);
+                clusterTasks.push_back(task);
+            }
+            visibility.resize(visibility.size() + mesh.meshletBounds.count);
+            meshletCount += mesh.meshlets.size();
+
+            for (int c = 0; c < 4; c++)
+                drawData.push_back(pending[i].transform[c]);
+            float materialIndex = materials ? (float)materials->MaterialIndex(mesh) : (float)(groups.size() - 1);
+            drawData.push_back(glm::vec4(materialIndex, 0.0f, 0.0f, 0.0f));
+            drawIds.push_back(i);
+        }
+
+        glGenBuffers(1, &drawDataBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, drawData.size() * sizeof(glm::vec4), drawData.data(), GL_STATIC_DRAW);
+        glGenTextures(1, &drawDataTexture);
+        glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        // own VAO over the arena's buffers, so the draw id attribute does not leak into Model::Draw
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, arena.GetVertexBuffer());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.GetIndexBuffer());
+        setupVertexAttributes();
+        glGenVertexArrays(1, &depthVAO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.GetIndexBuffer());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        if (useIndirect)
+        {
+            glGenBuffers(1, &drawIdBuffer);
+            glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+            glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(GLuint), drawIds.data(), GL_STATIC_DRAW);
+            for (unsigned int vao : { VAO, depthVAO })
+            {
+                glBindVertexArray(vao);
+                glEnableVertexAttribArray(DrawIdAttribute);
+                glVertexAttribIPointer(DrawIdAttribute, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+                glVertexAttribDivisor(DrawIdAttribute, 1);
+            }
+
+            glGenBuffers(1, &commandBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(rg::DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+            glGenBuffers(1, &culledCommandBuffer);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        cout << "INDIRECT_BATCH:: " << commands.size() << " draws (" << meshletCount << " meshlets) in " << groups.size() << " material groups ("
+             << (useIndirect ? "multi draw indirect" : "GL 3.3 fallback loop") << ")" << endl;
+    }
+
+    // re-picks the LOD of every draw, the command buffer is only touched when one of them changed
+    void SelectLods(const LodSelector& selector)
+    {
+        unsigned int first = commands.size(), last = 0;
+        for (unsigned int i = 0; i < pending.size(); i++)
+        {
+            unsigned int lod = selector.Select(*pending[i].mesh, pending[i].transform, pending[i].lod);
+            if (lod == pending[i].lod)
+                continue;
+            setLod(i, lod);
+            first = std::min(first, i);
+            last = i;
+        }
+        if (useIndirect && first <= last)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, first * sizeof(rg::DrawElementsIndirectCommand),
+                            (last - first + 1) * sizeof(rg::DrawElementsIndirectCommand), &commands[first]);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    }
+
+    // builds this frame's commands from the meshlets that survive culling, call after SelectLods.
+    // backfaceCulling needs the meshes to be drawn with GL_CULL_FACE, otherwise back sides are visible.
+    void CullClusters(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, bool backfaceCulling)
+    {
+        CullClusters(viewProjection, cameraPosition, backfaceCulling, [](unsigned int, const rg::Aabb&) { return true; });
+    }
+
+    // same, draws inside the frustum are kept only if isVisible(draw, worldBox) returns true. The draw
+    // index stays the same for a draw until the next Build, so it can key per-draw state.
+    template<typename IsVisible>
+    void CullClusters(const glm::mat4& viewProjection, const glm::vec3& cameraPosition, bool backfaceCulling,
+                      IsVisible isVisible)
+    {
+        views.resize(pending.size());
+        for (unsigned int i = 0; i < pending.size(); i++)
+        {
+            views[i] = rg::MeshletView::fromModel(viewProjection, pending[i].transform, cameraPosition, backfaceCulling);
+            const Mesh& mesh = *pending[i].mesh;
+            pending[i].visible = views[i].frustum.sphereVisible((mesh.boundsMin + mesh.boundsMax) * 0.5f,
+                                                        glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f);
+            if (pending[i].visible)
+                pending[i].visible = isVisible(i, rg::Aabb::transformed(rg::Aabb(mesh.boundsMin, mesh.boundsMax),
+                                                                        pending[i].transform));
+        }
+
+        rg::parallelFor(clusterTasks.size(), [this](unsigned int t) {
+            const ClusterTask& task = clusterTasks[t];
+            const PendingDraw& draw = pending[task.draw];
+            if (!draw.visible || draw.lod != 0)
+                return;
+            rg::cullMeshlets(draw.mesh->meshletBounds, task.begin, task.end, views[task.draw],
+                             visibility.data() + draw.firstVisibility);
+        }, TasksPerThread);
+
+        culledCommands.clear();
+        culledGroups.clear();
+        visibleMeshletCount = 0;
+        for (const MaterialGroup& group : groups)
+        {
+            MaterialGroup culledGroup = group;
+            culledGroup.firstCommand = culledCommands.size();
+            for (unsigned int i = group.firstCommand; i < group.firstCommand + group.commandCount; i++)
+            {
+                const PendingDraw& draw = pending[i];
+                const Mesh& mesh = *draw.mesh;
+                if (!draw.visible)
+                    continue;
+                if (draw.lod != 0 || mesh.meshlets.empty())
+                {
+                    culledCommands.push_back(commands[i]);
+                    continue;
+                }
+                // neighbouring meshlets are neighbouring index ranges, so a run of visible ones is one command
+                const GeometryRange& range = arena.Range(mesh.arenaHandle);
+                bool open = false;
+                for (unsigned int m = 0; m < mesh.meshlets.size(); m++)
+                {
+                    if (!visibility[draw.firstVisibility + m])
+                    {
+                        open = false;
+                        continue;
+                    }
+                    visibleMeshletCount++;
+                    if (open)
+                    {
+                        culledCommands.back().count += mesh.meshlets[m].indexCount;
+                        continue;
+                    }
+                    rg::DrawElementsIndirectCommand command = commands[i];
+                    command.count = mesh.meshlets[m].indexCount;
+                    command.firstIndex = range.firstIndex + mesh.meshlets[m].firstIndex;
+                    culledCommands.push_back(command);
+                    open = true;
+                }
+            }
+            culledGroup.commandCount = culledCommands.size() - culledGroup.firstCommand;
+            if (culledGroup.commandCount > 0)
+                culledGroups.push_back(culledGroup);
+        }
+
+        if (useIndirect)
+        {
+            // orphaned every frame, the driver hands out a fresh buffer instead of waiting for the last draw
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culledCommandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, culledCommands.size() * sizeof(rg::DrawElementsIndirectCommand),
+                         culledCommands.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+        culled = true;
+    }
+
+    // the shader has to read the model matrix through the draw id (see 2.model_lighting_indirect.vs)
+    void Draw(Shader& shader)
+    {
+        if (commands.empty())
+            return;
+        glActiveTexture(GL_TEXTURE0 + DrawDataTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+        shader.setInt("drawData", DrawDataTextureUnit);
+
+        if (materials)
+            materials->Bind(shader);
+
+        submit(shader, VAO, true);
+        // the culled commands are only valid for the frame they were made in
+        culled = false;
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // positions only, with the commands the next Draw uses (call between CullClusters and Draw).
+    // The shader reads the model matrix through the draw id (see depth_prepass_indirect.vs)
+    void DrawDepth(Shader& shader)
+    {
+        if (commands.empty())
+            return;
+        glActiveTexture(GL_TEXTURE0 + DrawDataTextureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+        shader.setInt("drawData", DrawDataTextureUnit);
+        submit(shader, depthVAO, false);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void deleteBuffers()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteVertexArrays(1, &depthVAO);
+        glDeleteBuffers(1, &commandBuffer);
+        glDeleteBuffers(1, &culledCommandBuffer);
+        glDeleteBuffers(1, &drawIdBuffer);
+        glDeleteBuffers(1, &drawDataBuffer);
+        glDeleteTextures(1, &drawDataTexture);
+        VAO = depthVAO = commandBuffer = culledCommandBuffer = drawIdBuffer = drawDataBuffer = drawDataTexture = 0;
+    }
+
+    unsigned int DrawCount() const { return commands.size(); }
+    unsigned int GroupCount() const { return groups.size(); }
+    unsigned int MeshletCount() const { return meshletCount; }
+    unsigned int VisibleMeshletCount() const { return visibleMeshletCount; } // in the last CullClusters
+
+private:
+    struct PendingDraw {
+        const Mesh* mesh;
+        glm::mat4 transform;
+        unsigned int lod = 0;
+        unsigned int firstVisibility = 0; // this draw's meshlets in visibility
+        bool visible = true;
+    };
+    struct ClusterTask {
+        unsigned int draw = 0;
+        unsigned int begin = 0, end = 0;
+    };
+    static const unsigned int MeshletsPerTask = 256;  // a multiple of 4 for the SIMD culling loop
+    static const unsigned int TasksPerThread = 4;     // small batches are culled without starting threads
+    struct MaterialGroup {
+        const Mesh* material = nullptr; // first mesh of the group, its textures are bound for the whole group
+        unsigned int firstCommand = 0;
+        unsigned int commandCount = 0;
+    };
+
+    GeometryArena& arena;
+    vector<PendingDraw> pending;
+    vector<rg::DrawElementsIndirectCommand> commands;
+    vector<MaterialGroup> groups;
+    vector<ClusterTask> clusterTasks;
+    vector<rg::MeshletView> views;
+    vector<unsigned char> visibility;
+    vector<rg::DrawElementsIndirectCommand> culledCommands;
+    vector<MaterialGroup> culledGroups;
+    unsigned int meshletCount = 0;
+    unsigned int visibleMeshletCount = 0;
+    bool culled = false;
+    bool useIndirect = false;
+    const MaterialLibrary* materials = nullptr;
+    unsigned int VAO = 0;
+    unsigned int depthVAO = 0;
+    unsigned int commandBuffer = 0;
+    unsigned int culledCommandBuffer = 0;
+    unsigned int drawIdBuffer = 0;
+    unsigned int drawDataBuffer = 0;
+    unsigned int drawDataTexture = 0;
+
+    // draws this frame's commands (culled or not) through vao, binding the group textures if asked to
+    void submit(Shader& shader, unsigned int vao, bool bindTextures)
+    {
+        const vector<rg::DrawElementsIndirectCommand>& drawCommands = culled ? culledCommands : commands;
+        const vector<MaterialGroup>& drawGroups = culled ? culledGroups : groups;
+
+        glBindVertexArray(vao);
+        if (useIndirect)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culled ? culledCommandBuffer : commandBuffer);
+
+        for (const MaterialGroup& group : drawGroups)
+        {
+            if (bindTextures && !materials)
+                group.material->BindTextures(shader);
+            if (useIndirect)
+            {
+                rg::glExt.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                                    (void*)(group.firstCommand * sizeof(rg::DrawElementsIndirectCommand)),
+                                                    group.commandCount, 0);
+            }
+            else
+            {
+                for (unsigned int i = group.firstCommand; i < group.firstCommand + group.commandCount; i++)
+                {
+                    const rg::DrawElementsIndirectCommand& command = drawCommands[i];
+                    glVertexAttribI1ui(DrawIdAttribute, command.baseInstance);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                             (void*)((size_t)command.firstIndex * sizeof(unsigned int)), command.baseVertex);
+                }
+            }
+        }
+
+        if (useIndirect)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    // points command i at one LOD range of its mesh, commands and pending share their order after Build
+    void setLod(unsigned int i, unsigned int lod)
+    {
+        const Mesh& mesh = *pending[i].mesh;
+        const GeometryRange& range = arena.Range(mesh.arenaHandle);
+        pending[i].lod = lod;
+        commands[i].count = mesh.lods[lod].indexCount;
+        commands[i].firstIndex = range.firstIndex + mesh.lods[lod].firstIndex;
+    }
+
+    // meshes sharing the same texture ids can be drawn together, with texture arrays everything can
+    vector<unsigned int> materialKey(const Mesh& mesh) const
+    {
+        vector<unsigned int> key;
+        if (materials)
+            return key;
+        for (const Texture& texture : mesh.textures)
+            key.push_back(texture.id);
+        return key;
+    }
+};
+#endif
@@ -0,0 +1,61 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+// picks a mesh LOD per frame from the screen space error it would cause: the object space error stored
+// with every LOD (see MeshLod) is scaled by the transform, projected at the distance of the mesh's
+// bounding sphere and compared to pixelError. The coarsest LOD under the threshold wins.
+//
+// To stop meshes at the boundary from switching back and forth every frame, going to a coarser LOD than
+// the current one needs the error to be a fraction (hysteresis) below the threshold, going finer happens
+// as soon as the threshold is crossed.
+class LodSelector
+{
+public:
+    float pixelError = 1.0f;  // largest allowed error in pixels
+    float hysteresis = 0.25f;
+
+    // zoom is the vertical field of view in degrees (Camera::Zoom), viewportHeight in pixels
+    void SetView(const glm::vec3& cameraPosition, float zoom, float viewportHeight)
+    {
+        this->cameraPosition = cameraPosition;
+        projectionScale = viewportHeight / (2.0f * tan(glm::radians(zoom) * 0.5f));
+    }
+
+    // pixels an object space error of the mesh covers on screen when drawn with transform
+    float ProjectedError(const Mesh& mesh, const glm::mat4& transform, float error) const
+    {
+        float scale = std::max(glm::length(glm::vec3(transform[0])),
+                      std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        glm::vec3 center = glm::vec3(transform * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+        float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f * scale;
+        // inside the bounding sphere the closest part of the mesh can be right at the near plane
+        float distance = std::max(glm::length(center - cameraPosition) - radius, 0.1f);
+        return error * scale * projectionScale / distance;
+    }
+
+    unsigned int Select(const Mesh& mesh, const glm::mat4& transform, unsigned int current) const
+    {
+        unsigned int selected = 0;
+        for (unsigned int i = 1; i < mesh.lods.size(); i++)
+        {
+            float threshold = i > current ? pixelError * (1.0f - hysteresis) : pixelError;
+            if (ProjectedError(mesh, transform, mesh.lods[i].error) > threshold)
+                break;
+            selected = i;
+        }
+        return selected;
+    }
+
+private:
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float projectionScale = 1.0f;
+};
+#endif
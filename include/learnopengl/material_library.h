@@ -0,0 +1,233 @@
+#ifndef MATERIAL_LIBRARY_H
+#define MATERIAL_LIBRARY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/BlockCompression.h>
+#include <rg/GLExtensions.h>
+#include <rg/ImageDecode.h>
+
+#include <learnopengl/model.h>
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// packs the textures of many meshes into one GL_TEXTURE_2D_ARRAY (every image is resized to the same
+// layer size on import) and keeps the material parameters in a uniform buffer. A draw then only needs
+// a material index to find its layers and shininess, so differently textured meshes can share a batch.
+// With S3TC every layer is encoded as BC1 with its mip chain on the CPU (the shaders only read .rgb and
+// .r), otherwise the array is RGBA8 with glGenerateMipmap.
+class MaterialLibrary
+{
+public:
+    static const unsigned int MaxMaterials = 256;       // has to match the Materials block in the shader
+    static const unsigned int TextureUnit = 6;
+    static const unsigned int UniformBinding = 0;
+
+    explicit MaterialLibrary(unsigned int layerSize = 1024) : layerSize(layerSize) {}
+
+    void AddModel(const Model& model)
+    {
+        for (const Mesh& mesh : model.meshes)
+            AddMesh(mesh, model.directory);
+    }
+
+    // returns the material index of the mesh, meshes with the same textures and shininess share a material
+    unsigned int AddMesh(const Mesh& mesh, const string& directory)
+    {
+        glm::vec4 params(-1.0f, -1.0f, mesh.shininess, 0.0f);
+        for (const Texture& texture : mesh.textures)
+        {
+            if (texture.type == "texture_diffuse" && params.x < 0.0f)
+                params.x = (float)addLayer(directory + '/' + texture.path);
+            else if (texture.type == "texture_specular" && params.y < 0.0f)
+                params.y = (float)addLayer(directory + '/' + texture.path);
+        }
+
+        unsigned int index = materials.size();
+        for (unsigned int i = 0; i < materials.size(); i++)
+        {
+            if (materials[i] == params)
+            {
+                index = i;
+                break;
+            }
+        }
+        if (index == materials.size())
+        {
+            if (materials.size() == MaxMaterials)
+            {
+                cout << "ERROR::MATERIAL_LIBRARY:: more than " << MaxMaterials << " materials" << endl;
+                index = 0;
+            }
+            else
+            {
+                materials.push_back(params);
+            }
+        }
+        meshMaterials[&mesh] = index;
+        return index;
+    }
+
+    unsigned int MaterialIndex(const Mesh& mesh) const
+    {
+        auto it = meshMaterials.find(&mesh);
+        return it != meshMaterials.end() ? it->second : 0;
+    }
+
+    // uploads the layers and the material buffer, the CPU copies of the images are freed afterwards
+    void Build()
+    {
+        glGenTextures(1, &textureArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        unsigned int layerCount = std::max<unsigned int>(layers.size(), 1);
+        compressed = rg::glExt.textureCompressionS3TC;
+        if (compressed)
+            uploadCompressed(layerCount);
+        else
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            for (unsigned int i = 0; i < layers.size(); i++)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, layerSize, layerSize, 1, GL_RGBA, GL_UNSIGNED_BYTE, layers[i].data());
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        vector<glm::vec4> buffer(MaxMaterials, glm::vec4(-1.0f, -1.0f, 32.0f, 0.0f));
+        std::copy(materials.begin(), materials.end(), buffer.begin());
+        glGenBuffers(1, &uniformBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, buffer.size() * sizeof(glm::vec4), buffer.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        cout << "MATERIAL_LIBRARY:: " << materials.size() << " materials, " << layers.size() << " layers of "
+             << layerSize << "x" << layerSize << (compressed ? " BC1" : " RGBA8") << endl;
+        vector<vector<unsigned char>>().swap(layers);
+    }
+
+    // binds the texture array and the material block for a shader using 2.model_lighting_array.fs
+    void Bind(Shader& shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + TextureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray);
+        shader.setInt("materialTextures", TextureUnit);
+
+        unsigned int blockIndex = glGetUniformBlockIndex(shader.ID, "Materials");
+        if (blockIndex != GL_INVALID_INDEX)
+            glUniformBlockBinding(shader.ID, blockIndex, UniformBinding);
+        glBindBufferBase(GL_UNIFORM_BUFFER, UniformBinding, uniformBuffer);
+    }
+
+    void deleteBuffers()
+    {
+        glDeleteTextures(1, &textureArray);
+        glDeleteBuffers(1, &uniformBuffer);
+        textureArray = uniformBuffer = 0;
+    }
+
+    unsigned int MaterialCount() const { return materials.size(); }
+
+private:
+    unsigned int layerSize;
+    bool compressed = false;
+    unsigned int textureArray = 0;
+    unsigned int uniformBuffer = 0;
+    vector<glm::vec4> materials;              // (diffuse layer, specular layer, shininess, unused), -1 = no texture
+    map<const Mesh*, unsigned int> meshMaterials;
+    map<string, unsigned int> layerByPath;
+    vector<vector<unsigned char>> layers;     // RGBA8, layerSize x layerSize, until Build()
+
+    unsigned int addLayer(const string& path)
+    {
+        auto it = layerByPath.find(path);
+        if (it != layerByPath.end())
+            return it->second;
+
+        rg::ImageInfo info;
+        vector<unsigned char> pixels;
+        vector<unsigned char> layer(layerSize * layerSize * 4, 255);
+        if (rg::decodeImage(path, 4, pixels, info))
+        {
+            resizeBilinear(pixels.data(), info.width, info.height, layer.data(), layerSize);
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+        }
+
+        unsigned int index = layers.size();
+        layers.push_back(std::move(layer));
+        layerByPath[path] = index;
+        return index;
+    }
+
+    // every level is allocated for all layers first, then each layer's precomputed levels are copied in
+    void uploadCompressed(unsigned int layerCount)
+    {
+        GLenum internalFormat = rg::glInternalFormat(rg::BlockFormat::BC1);
+        unsigned int levelCount = 0;
+        vector<unsigned char> white(layers.empty() ? layerSize * layerSize * 4 : 0, 255); // the one layer of an empty library
+        for (unsigned int i = 0; i < layerCount; i++)
+        {
+            const unsigned char* pixels = i < layers.size() ? layers[i].data() : white.data();
+            rg::CompressedImage image = rg::compressImage(pixels, layerSize, layerSize, rg::BlockFormat::BC1, true);
+            if (i == 0)
+            {
+                levelCount = image.levels.size();
+                for (unsigned int level = 0; level < levelCount; level++)
+                {
+                    const rg::CompressedLevel& first = image.levels[level];
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, first.width, first.height, layerCount,
+                                           0, first.data.size() * layerCount, NULL);
+                }
+            }
+            for (unsigned int level = 0; level < image.levels.size(); level++)
+            {
+                const rg::CompressedLevel& data = image.levels[level];
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, i, data.width, data.height, 1,
+                                          internalFormat, data.data.size(), data.data.data());
+            }
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    }
+
+    // RGBA8 bilinear resample, only used at import so it favours simplicity over speed
+    static void resizeBilinear(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, unsigned int size)
+    {
+        if (srcWidth == (int)size && srcHeight == (int)size)
+        {
+            std::copy(src, src + size * size * 4, dst);
+            return;
+        }
+        for (unsigned int y = 0; y < size; y++)
+        {
+            float sy = std::max(0.0f, (y + 0.5f) * srcHeight / size - 0.5f);
+            int y0 = std::min((int)sy, srcHeight - 1);
+            int y1 = std::min(y0 + 1, srcHeight - 1);
+            float fy = sy - y0;
+            for (unsigned int x = 0; x < size; x++)
+            {
+                float sx = std::max(0.0f, (x + 0.5f) * srcWidth / size - 0.5f);
+                int x0 = std::min((int)sx, srcWidth - 1);
+                int x1 = std::min(x0 + 1, srcWidth - 1);
+                float fx = sx - x0;
+                for (int c = 0; c < 4; c++)
+                {
+                    float top = src[(y0 * srcWidth + x0) * 4 + c] * (1.0f - fx) + src[(y0 * srcWidth + x1) * 4 + c] * fx;
+                    float bottom = src[(y1 * srcWidth + x0) * 4 + c] * (1.0f - fx) + src[(y1 * srcWidth + x1) * 4 + c] * fx;
+                    dst[(y * size + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+                }
+            }
+        }
+    }
+};
+#endif
@@ -7,9 +7,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/geometry_arena.h>
+#include <rg/Meshlet.h>
+#include <rg/MeshSimplify.h>
+#include <rg/Parallel.h>
 
 #include <string>
 #include <vector>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
 using namespace std;
 
 struct Vertex {
@@ -27,12 +35,100 @@ struct Vertex {
 
 
 
+// describes the Vertex layout to the currently bound VAO / GL_ARRAY_BUFFER
+inline void setupVertexAttributes()
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+}
+
+// per-instance model matrix of DrawInstanced, a mat4 takes four vec4 attributes from this location on
+const unsigned int InstanceMatrixAttribute = 6;
+
+// points the instance matrix attributes of the currently bound VAO at buffer (tightly packed glm::mat4).
+// They are only enabled around instanced draws, so the VAOs draw single objects as before
+inline void setupInstanceAttributes(unsigned int buffer)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (unsigned int column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(InstanceMatrixAttribute + column);
+        glVertexAttribPointer(InstanceMatrixAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(InstanceMatrixAttribute + column, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+inline void disableInstanceAttributes()
+{
+    for (unsigned int column = 0; column < 4; column++)
+        glDisableVertexAttribArray(InstanceMatrixAttribute + column);
+}
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// what a mesh keeps in RAM once its vertex/index data has been uploaded to the GPU
+enum class MeshResidency {
+    KeepCpuData,      // vertices and indices stay resident (needed if the mesh is edited or re-uploaded)
+    GpuOnly,          // CPU copy is freed after upload, only the bounding box is kept
+    GpuWithCollision  // CPU copy is freed, a deduplicated position/index proxy is kept for collision
+};
+
+// compact geometry kept for collision queries when the full vertex data has been released
+struct CollisionProxy {
+    vector<glm::vec3> positions;  // unique positions, normals/uvs/tangents dropped
+    vector<uint16_t>  indices16;  // used when positions.size() fits in 16 bits
+    vector<uint32_t>  indices32;
+
+    unsigned int triangleCount() const { return (indices16.size() + indices32.size()) / 3; }
+    unsigned int index(unsigned int i) const { return indices16.empty() ? indices32[i] : indices16[i]; }
+
+    size_t heapBytes() const
+    {
+        return positions.capacity() * sizeof(glm::vec3)
+             + indices16.capacity() * sizeof(uint16_t)
+             + indices32.capacity() * sizeof(uint32_t);
+    }
+};
+
+// import-time simplification, every ratio produces one LOD with about that fraction of the base triangles
+struct MeshLodSettings {
+    vector<float> triangleRatios = { 0.5f, 0.25f, 0.125f };
+    unsigned int minTriangles = 64;   // no LOD is made below this many triangles
+    rg::SimplifySettings simplify;
+};
+
+// one index range of the mesh, LOD 0 is the base mesh and the simplified ranges follow it in the same buffer
+struct MeshLod {
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;               // object space deviation from the base mesh
+};
+
+struct MeshMemoryStats {
+    size_t sourceBytes   = 0; // vertex + index data handed over by the importer
+    size_t residentBytes = 0; // vertex + index + collision data still on the heap
+    size_t gpuBytes      = 0; // size of the VBO + EBO
+};
+
 class Mesh {
 public:
     // mesh Data
@@ -40,21 +136,154 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
 
-    unsigned int VAO;
+    unsigned int VAO = 0;
     std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+
+    // set when the mesh lives inside a shared GeometryArena instead of owning VAO/VBO/EBO
+    GeometryArena* arena = nullptr;
+    GeometryArena::Handle arenaHandle = GeometryArena::InvalidHandle;
+
+    // kept regardless of residency, so culling/LOD code never needs the vertex data
+    unsigned int indexCount = 0;
+    unsigned int vertexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    CollisionProxy collision;
+    float shininess = 32.0f;
+
+    // clusters of the base mesh (see rg/Meshlet.h), the base index range is ordered by meshlet
+    vector<rg::Meshlet> meshlets;
+    rg::MeshletCullData meshletBounds;
+
+    // lods[0] is the base mesh; lod is the range Draw uses, picked per frame by a LodSelector
+    vector<MeshLod> lods;
+    unsigned int lod = 0;
+
+    // constructor, takes the data by value so callers can move it in instead of copying.
+    // With lodSettings the simplified index ranges are generated before upload and appended to indices.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         MeshResidency residency = MeshResidency::KeepCpuData, GeometryArena* arena = nullptr,
+         const MeshLodSettings* lodSettings = nullptr)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)), arena(arena)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        indexCount = this->indices.size();
+        vertexCount = this->vertices.size();
+        memory.sourceBytes = this->vertices.size() * sizeof(Vertex) + this->indices.size() * sizeof(unsigned int);
+        computeBounds();
+        if (!this->vertices.empty())
+        {
+            rg::buildMeshlets(reinterpret_cast<const unsigned char*>(this->vertices.data()) + offsetof(Vertex, Position),
+                              this->vertices.size(), sizeof(Vertex), this->indices, 0, indexCount, rg::MeshletSettings(), meshlets);
+            meshletBounds.assign(meshlets);
+        }
+
+        MeshLod base;
+        base.indexCount = indexCount;
+        lods.push_back(base);
+        if (lodSettings)
+            generateLods(*lodSettings);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
+
+        if (residency == MeshResidency::GpuWithCollision)
+            buildCollisionProxy();
+        if (residency != MeshResidency::KeepCpuData)
+            releaseCpuData();
+        updateResidentBytes();
+    }
+
+    bool HasCpuData() const { return !vertices.empty(); }
+
+    const MeshMemoryStats& GetMemoryStats() const { return memory; }
+
+    // frees the CPU copy of the vertex and index data, the GPU buffers are left untouched
+    void releaseCpuData()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+        updateResidentBytes();
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // render the mesh, arenaBound skips the VAO bind when the caller already bound the shared arena
+    void Draw(Shader &shader, bool arenaBound = false)
+    {
+        BindTextures(shader);
+
+        // draw mesh
+        const MeshLod& range = lods[lod];
+        if (arena)
+        {
+            if (!arenaBound)
+                arena->Bind();
+            arena->Draw(arenaHandle, range.firstIndex, range.indexCount);
+        }
+        else
+        {
+            glBindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)((size_t)range.firstIndex * sizeof(unsigned int)));
+            glBindVertexArray(0);
+        }
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // instanceCount copies of the mesh, one per matrix in instanceBuffer (see setupInstanceAttributes).
+    // With arenaBound the caller has bound the arena's VAO and set up the instance attributes on it
+    void DrawInstanced(Shader &shader, unsigned int instanceBuffer, unsigned int instanceCount, bool arenaBound = false)
+    {
+        BindTextures(shader);
+
+        const MeshLod& range = lods[lod];
+        if (arena)
+        {
+            if (!arenaBound)
+            {
+                arena->Bind();
+                setupInstanceAttributes(instanceBuffer);
+            }
+            arena->DrawInstanced(arenaHandle, range.firstIndex, range.indexCount, instanceCount);
+            if (!arenaBound)
+            {
+                disableInstanceAttributes();
+                glBindVertexArray(0);
+            }
+        }
+        else
+        {
+            glBindVertexArray(VAO);
+            setupInstanceAttributes(instanceBuffer);
+            glDrawElementsInstanced(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                                    (void*)((size_t)range.firstIndex * sizeof(unsigned int)), instanceCount);
+            disableInstanceAttributes();
+            glBindVertexArray(0);
+        }
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // the current LOD without binding textures, for depth-only passes. With arenaBound the caller has
+    // bound the arena's VAO (GeometryArena::BindPositions)
+    void DrawDepth(bool arenaBound = false) const
+    {
+        const MeshLod& range = lods[lod];
+        if (arena)
+        {
+            if (!arenaBound)
+                arena->BindPositions();
+            arena->Draw(arenaHandle, range.firstIndex, range.indexCount);
+        }
+        else
+        {
+            glBindVertexArray(VAO);
+            glDrawElements(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void*)((size_t)range.firstIndex * sizeof(unsigned int)));
+            glBindVertexArray(0);
+        }
+    }
+
+    // binds the mesh's textures to units 0..N-1 and points the texture_diffuseN/... samplers at them
+    void BindTextures(Shader &shader) const
     {
         // bind appropriate textures
         unsigned int diffuseNr  = 1;
@@ -81,25 +310,120 @@ public:
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
+    }
 
+private:
+    // render data
+    unsigned int VBO = 0, EBO = 0;
+    MeshMemoryStats memory;
 
+    void computeBounds()
+    {
+        if (vertices.empty())
+            return;
+        boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        for (const Vertex& v : vertices) {
+            boundsMin = glm::min(boundsMin, v.Position);
+            boundsMax = glm::max(boundsMax, v.Position);
+        }
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // simplifies the base mesh once per ratio (in parallel, each run starts from the full mesh so the
+    // errors are measured against it) and appends every result that is actually smaller to indices
+    void generateLods(const MeshLodSettings& settings)
+    {
+        vector<size_t> targets;
+        for (float ratio : settings.triangleRatios) {
+            size_t triangles = (size_t)(indexCount / 3 * ratio);
+            if (triangles >= settings.minTriangles && (targets.empty() || triangles * 3 < targets.back()))
+                targets.push_back(triangles * 3);
+        }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        rg::SimplifyInput input;
+        input.vertices = reinterpret_cast<const unsigned char*>(vertices.data());
+        input.vertexCount = vertices.size();
+        input.stride = sizeof(Vertex);
+        input.positionOffset = offsetof(Vertex, Position);
+        input.normalOffset = offsetof(Vertex, Normal);
+        input.texCoordOffset = offsetof(Vertex, TexCoords);
+
+        vector<vector<unsigned int>> results(targets.size());
+        vector<float> errors(targets.size());
+        rg::parallelFor(targets.size(), [&](unsigned int i) {
+            errors[i] = rg::simplifyMesh(input, indices, targets[i], settings.simplify, results[i]);
+        });
+
+        for (unsigned int i = 0; i < results.size(); i++) {
+            // a LOD that the error limit kept close to the previous one is not worth a switch
+            if (results[i].size() > lods.back().indexCount * 9 / 10)
+                continue;
+            MeshLod level;
+            level.firstIndex = indices.size();
+            level.indexCount = results[i].size();
+            level.error = std::max(errors[i], lods.back().error);
+            lods.push_back(level);
+            indices.insert(indices.end(), results[i].begin(), results[i].end());
+        }
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // welds vertices that only differ in normal/uv so the proxy holds every position once
+    void buildCollisionProxy()
+    {
+        struct PositionHash {
+            size_t operator()(const glm::vec3& p) const
+            {
+                const uint32_t* bits = reinterpret_cast<const uint32_t*>(&p[0]);
+                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+            }
+        };
+        struct PositionEqual {
+            bool operator()(const glm::vec3& a, const glm::vec3& b) const { return a == b; }
+        };
+
+        unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> lookup;
+        lookup.reserve(vertices.size());
+        vector<uint32_t> remap(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++) {
+            auto it = lookup.emplace(vertices[i].Position, (uint32_t)collision.positions.size());
+            if (it.second)
+                collision.positions.push_back(vertices[i].Position);
+            remap[i] = it.first->second;
+        }
+        collision.positions.shrink_to_fit();
+
+        // only the base range, the LOD ranges after it are for drawing
+        if (collision.positions.size() <= 0xFFFF) {
+            collision.indices16.reserve(indexCount);
+            for (unsigned int i = 0; i < indexCount; i++)
+                collision.indices16.push_back((uint16_t)remap[indices[i]]);
+        } else {
+            collision.indices32.reserve(indexCount);
+            for (unsigned int i = 0; i < indexCount; i++)
+                collision.indices32.push_back(remap[indices[i]]);
+        }
+    }
+
+    void updateResidentBytes()
+    {
+        memory.residentBytes = vertices.capacity() * sizeof(Vertex)
+                             + indices.capacity() * sizeof(unsigned int)
+                             + collision.heapBytes()
+                             + meshlets.capacity() * sizeof(rg::Meshlet)
+                             + meshletBounds.heapBytes();
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        memory.gpuBytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+        if (arena)
+        {
+            // the arena already has a VAO with the Vertex layout, just copy into its buffers
+            arenaHandle = arena->Upload(vertices.data(), vertices.size(), indices.data(), indices.size());
+            return;
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -117,21 +441,7 @@ private:
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        setupVertexAttributes();
 
         glBindVertexArray(0);
     }
@@ -10,9 +10,14 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/lod_selector.h>
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/AssimpVfs.h>
+#include <rg/Frustum.h>
+#include <rg/TextureCache.h>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -21,7 +26,8 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false,
+                             rg::TextureUsage usage = rg::TextureUsage::Color);
 
 
 
@@ -33,18 +39,143 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    MeshResidency residency;
+    GeometryArena* arena;
+    const MeshLodSettings* lodSettings;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // with an arena the meshes are sub-allocated from its shared buffers instead of getting their own VAO.
+    // with lodSettings every mesh gets simplified LODs, see SelectLods.
+    // without loadTextures the textures only get their type and path (id 0), for a model whose meshes
+    // read their textures from a MaterialLibrary; LoadTextures loads them if it is drawn on its own after all.
+    Model(string const &path, bool gamma = false, MeshResidency residency = MeshResidency::KeepCpuData,
+          GeometryArena* arena = nullptr, const MeshLodSettings* lodSettings = nullptr, bool loadTextures = true)
+        : gammaCorrection(gamma), residency(residency), arena(arena), lodSettings(lodSettings),
+          texturesLoaded(loadTextures)
     {
         loadModel(path);
     }
 
+    // loads the textures skipped by the constructor, does nothing once they are loaded
+    void LoadTextures()
+    {
+        if (texturesLoaded)
+            return;
+        for (Texture& texture : textures_loaded)
+            texture.id = TextureFromFile(texture.path.c_str(), directory, false, textureUsage(texture.type));
+        for (Mesh& mesh : meshes)
+        {
+            for (Texture& texture : mesh.textures)
+            {
+                for (const Texture& loaded : textures_loaded)
+                {
+                    if (loaded.path == texture.path)
+                    {
+                        texture.id = loaded.id;
+                        break;
+                    }
+                }
+            }
+        }
+        texturesLoaded = true;
+    }
+
+    // picks the LOD every mesh is drawn with by the next Draw, for the model drawn with transform
+    void SelectLods(const LodSelector& selector, const glm::mat4& transform)
+    {
+        for (Mesh& mesh : meshes)
+            mesh.lod = selector.Select(mesh, transform, mesh.lod);
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        if (arena)
+            arena->Bind();
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, arena != nullptr);
+        if (arena)
+            glBindVertexArray(0);
+    }
+
+    // count copies of the model in one instanced draw per mesh, transforms[i] takes the place of the model
+    // uniform for copy i (2.model_lighting_instanced.vs). The matrices are copied into the model's instance
+    // buffer on every call; all copies use the LODs of the last SelectLods
+    void DrawInstanced(Shader &shader, const glm::mat4* transforms, unsigned int count)
+    {
+        if (count == 0)
+            return;
+        uploadInstances(transforms, count);
+        if (arena)
+        {
+            arena->Bind();
+            setupInstanceAttributes(instanceBuffer);
+        }
+        for (Mesh& mesh : meshes)
+            mesh.DrawInstanced(shader, instanceBuffer, count, arena != nullptr);
+        if (arena)
+        {
+            disableInstanceAttributes();
+            glBindVertexArray(0);
+        }
+    }
+
+    void DrawInstanced(Shader &shader, const vector<glm::mat4>& transforms)
+    {
+        DrawInstanced(shader, transforms.data(), transforms.size());
+    }
+
+    // has to be called while the context is still current, if DrawInstanced was used
+    void deleteInstanceBuffer()
+    {
+        glDeleteBuffers(1, &instanceBuffer);
+        instanceBuffer = 0;
+        instanceCapacity = 0;
+    }
+
+    // positions only with the same LODs as Draw, the shader sets gl_Position (depth_prepass.vs)
+    void DrawDepth() const
+    {
+        if (arena)
+            arena->BindPositions();
+        for (const Mesh& mesh : meshes)
+            mesh.DrawDepth(arena != nullptr);
+        if (arena)
+            glBindVertexArray(0);
+    }
+
+    // object space box around all meshes
+    rg::Aabb GetBounds() const
+    {
+        if (meshes.empty())
+            return rg::Aabb();
+        rg::Aabb bounds = rg::Aabb::empty();
+        for (const Mesh& mesh : meshes)
+            bounds.expand(rg::Aabb(mesh.boundsMin, mesh.boundsMax));
+        return bounds;
+    }
+
+    MeshMemoryStats GetMemoryStats() const
+    {
+        MeshMemoryStats total;
+        for (const Mesh& mesh : meshes) {
+            total.sourceBytes += mesh.GetMemoryStats().sourceBytes;
+            total.residentBytes += mesh.GetMemoryStats().residentBytes;
+            total.gpuBytes += mesh.GetMemoryStats().gpuBytes;
+        }
+        return total;
+    }
+
+    // prints how much heap the model uses after upload compared to keeping the importer's data around
+    void PrintMemoryReport(const string& name) const
+    {
+        MeshMemoryStats stats = GetMemoryStats();
+        size_t saved = stats.sourceBytes > stats.residentBytes ? stats.sourceBytes - stats.residentBytes : 0;
+        cout << "MEMORY::" << name << ": " << meshes.size() << " meshes"
+             << ", source " << stats.sourceBytes / 1024 << " KiB"
+             << ", resident " << stats.residentBytes / 1024 << " KiB"
+             << ", gpu " << stats.gpuBytes / 1024 << " KiB"
+             << ", saved " << saved / 1024 << " KiB" << endl;
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
@@ -53,11 +184,36 @@ public:
         }
     }
 private:
+    bool texturesLoaded;
+    unsigned int instanceBuffer = 0;
+    unsigned int instanceCapacity = 0; // matrices
+
+    // specular maps are only read as .x, so they can be stored single channel
+    static rg::TextureUsage textureUsage(const string& typeName)
+    {
+        return typeName == "texture_specular" ? rg::TextureUsage::SingleChannel : rg::TextureUsage::Color;
+    }
+
+    // orphans the buffer before the copy, so a draw still reading last frame's matrices doesn't stall it.
+    // The capacity doubles when it runs out and never shrinks
+    void uploadInstances(const glm::mat4* transforms, unsigned int count)
+    {
+        if (!instanceBuffer)
+            glGenBuffers(1, &instanceBuffer);
+        if (count > instanceCapacity)
+            instanceCapacity = std::max(count, instanceCapacity * 2);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)instanceCapacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(glm::mat4), transforms);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
+        importer.SetIOHandler(new rg::VfsIOSystem); // the importer owns and deletes it
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
@@ -97,6 +253,8 @@ private:
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(mesh->mNumFaces * 3);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -161,6 +319,9 @@ private:
         // normal: texture_normalN
         aiColor3D color(0.0f, 0.0f, 0.0f);
         material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+        float shininess = 0.0f;
+        if (material->Get(AI_MATKEY_SHININESS, shininess) != AI_SUCCESS || shininess <= 0.0f)
+            shininess = 32.0f;
 
 
         // 1. diffuse maps
@@ -179,7 +340,9 @@ private:
 
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        Mesh result(std::move(vertices), std::move(indices), std::move(textures), residency, arena, lodSettings);
+        result.shininess = shininess;
+        return result;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -205,7 +368,7 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = texturesLoaded ? TextureFromFile(str.C_Str(), this->directory, false, textureUsage(typeName)) : 0;
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
@@ -217,41 +380,40 @@ private:
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, rg::TextureUsage usage)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    // precompressed BCn with its mip chain from the texture cache, no glGenerateMipmap needed
+    rg::CompressedTexture compressed = rg::loadCompressedTexture(filename, usage);
+    if (compressed.id)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return compressed.id;
+    }
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // decoded straight into a pixel unpack buffer
+    rg::ImageInfo info;
+    if (rg::uploadImageFile(GL_TEXTURE_2D, filename, info))
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else
     {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
 
     return textureID;
@@ -0,0 +1,212 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/Frustum.h>
+#include <rg/GLExtensions.h>
+
+#include <vector>
+using namespace std;
+
+// GPU occlusion culling with hardware queries. Every object (identified by a key picked by the caller)
+// gets one query object; after the opaque pass its world box is drawn with color and depth writes off
+// inside a GL_ANY_SAMPLES_PASSED(_CONSERVATIVE) query, so the answer is "was any part of the box in front
+// of what has been drawn this frame".
+//
+// Results are never waited for: BeginFrame only reads the queries whose result is already available, the
+// others stay in flight and keep the last known answer. Objects known to be visible are queried again
+// only every requeryInterval frames, hidden ones as soon as their previous query came back, so an object
+// that comes out from behind an occluder is noticed after a frame or two.
+//
+// Draws that can be submitted on their own can also be wrapped in BeginConditional/EndConditional: for a
+// hidden object the GPU then decides with the newest query, even if the CPU has not seen its result yet,
+// and draws anyway if it isn't done (GL_QUERY_NO_WAIT).
+class OcclusionQueries
+{
+public:
+    unsigned int requeryInterval = 8;
+    // the box's faces are clipped when the camera is inside (or close to) it, such objects are always visible
+    float cameraMargin = 0.2f;
+
+    struct Stats
+    {
+        unsigned int issued = 0;          // queries drawn last frame
+        unsigned int hidden = 0;          // objects known to be hidden
+        unsigned int conditionalDraws = 0; // draws wrapped in conditional render last frame
+    };
+
+    void Init()
+    {
+        target = rg::glExt.anySamplesPassedConservative ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+
+        float vertices[] = {
+            -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,
+            -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f
+        };
+        unsigned int indices[] = {
+            0, 2, 1, 0, 3, 2,  4, 5, 6, 4, 6, 7,  0, 1, 5, 0, 5, 4,
+            3, 7, 6, 3, 6, 2,  0, 4, 7, 0, 7, 3,  1, 2, 6, 1, 6, 5
+        };
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glBindVertexArray(0);
+    }
+
+    // collects the results that are ready, call once per frame before IsVisible
+    void BeginFrame()
+    {
+        frame++;
+        stats.issued = 0;
+        stats.conditionalDraws = 0;
+        stats.hidden = 0;
+        for (QueryState& state : states)
+        {
+            if (state.inFlight)
+            {
+                GLuint available = GL_FALSE;
+                glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint passed = GL_FALSE;
+                    glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &passed);
+                    state.visible = passed != GL_FALSE;
+                    state.inFlight = false;
+                }
+            }
+            if (!state.visible)
+                stats.hidden++;
+        }
+    }
+
+    // last known visibility of the object, and queues a new query for it if one is due.
+    // An object that wasn't asked about last frame (e.g. it was outside the frustum) counts as visible again.
+    bool IsVisible(unsigned int key, const rg::Aabb& box, const glm::vec3& cameraPosition)
+    {
+        if (key >= states.size())
+            states.resize(key + 1);
+        QueryState& state = states[key];
+        if (state.lastUsedFrame + 1 < frame)
+            state.visible = true;
+        state.lastUsedFrame = frame;
+        state.box = box;
+
+        bool cameraInside = true;
+        for (int axis = 0; axis < 3; axis++)
+            cameraInside = cameraInside && cameraPosition[axis] >= box.min[axis] - cameraMargin &&
+                                           cameraPosition[axis] <= box.max[axis] + cameraMargin;
+        if (cameraInside)
+        {
+            state.visible = true;
+            return true;
+        }
+
+        if (!state.inFlight && !state.queued && (!state.issued || !state.visible || frame - state.lastQueryFrame >= requeryInterval))
+        {
+            state.queued = true;
+            queued.push_back(key);
+        }
+        return state.visible;
+    }
+
+    // draws up to EndConditional are skipped by the GPU if the newest query of a hidden object found no samples
+    void BeginConditional(unsigned int key)
+    {
+        conditional = key < states.size() && states[key].issued && !states[key].visible;
+        if (conditional)
+        {
+            glBeginConditionalRender(states[key].query, GL_QUERY_NO_WAIT);
+            stats.conditionalDraws++;
+        }
+    }
+
+    void EndConditional()
+    {
+        if (conditional)
+            glEndConditionalRender();
+        conditional = false;
+    }
+
+    // draws the boxes of the queued objects, call after the opaque geometry is in the depth buffer.
+    // shader only needs the model, view and projection uniforms (light_cube.vs).
+    void IssueQueries(Shader& shader, const glm::mat4& projection, const glm::mat4& view)
+    {
+        if (queued.empty())
+            return;
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(VAO);
+        for (unsigned int key : queued)
+        {
+            QueryState& state = states[key];
+            if (!state.query)
+                glGenQueries(1, &state.query);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), state.box.center());
+            model = glm::scale(model, glm::max(state.box.extent(), glm::vec3(1e-3f)));
+            shader.setMat4("model", model);
+            glBeginQuery(target, state.query);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+            glEndQuery(target);
+            state.queued = false;
+            state.inFlight = true;
+            state.issued = true;
+            state.lastQueryFrame = frame;
+        }
+        stats.issued = queued.size();
+        queued.clear();
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+
+    const Stats& GetStats() const { return stats; }
+
+    void deleteBuffers()
+    {
+        for (QueryState& state : states)
+            if (state.query)
+                glDeleteQueries(1, &state.query);
+        states.clear();
+        queued.clear();
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+
+private:
+    struct QueryState
+    {
+        GLuint query = 0;
+        rg::Aabb box;
+        bool visible = true;
+        bool inFlight = false;
+        bool queued = false;
+        bool issued = false; // query holds a result (or will), usable for conditional render
+        unsigned int lastQueryFrame = 0;
+        unsigned int lastUsedFrame = 0;
+    };
+
+    vector<QueryState> states;
+    vector<unsigned int> queued;
+    GLenum target = GL_ANY_SAMPLES_PASSED;
+    unsigned int frame = 0;
+    bool conditional = false;
+    Stats stats;
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+};
+#endif
@@ -0,0 +1,331 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gpu_timer.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// HDR post stack over a floating point scene target, all fullscreen fragment passes (no compute in GL 3.3):
+//   bloom:    the bright part of the scene is downsampled through a chain of half resolution levels and
+//             upsampled back with additive blending (dual Kawase filters, bloom_downsample.fs and
+//             bloom_upsample.fs): 5 taps down, 8 taps up, and every level has a quarter of the pixels
+//             of the one above, so the whole chain costs about as much as one pass at half resolution.
+//   exposure: the log luminance of the scene goes into a fixed 64x64 texture whose mip chain is reduced
+//             down to one texel. That texel is copied into a pixel buffer and read a few frames later
+//             once its fence has signalled, so the CPU never waits; the exposure adapts to it over time.
+//   tone map: exposure, bloom and the ACES curve into an 8 bit output target (tonemap.fs).
+//
+// The passes don't depend on the scene content and the chain length and the luminance size are fixed, so
+// the cost only follows the render resolution. It is measured with a GPU timer to compare with the budget.
+//
+// Like the scene targets, everything is allocated at the largest size and the frame only covers the
+// bottom left render width x height of it.
+class PostProcess
+{
+public:
+    static const int BloomLevels = 5;
+    static const int LuminanceSize = 64;
+    static const int LuminanceLevels = 7; // 64 .. 1
+    static const unsigned int ReadbackLatency = 3;
+
+    float bloomThreshold = 1.0f;  // scene colour where the bloom starts
+    float bloomKnee = 0.5f;       // soft transition below the threshold
+    float bloomStrength = 0.08f;
+
+    bool autoExposure = true;
+    float exposureKey = 0.4f;     // average luminance the exposure maps the scene to
+    float adaptationSpeed = 1.5f; // per second
+    float minExposure = 0.25f, maxExposure = 4.0f;
+
+    double budgetMilliseconds = 1.5;
+
+    PostProcess(Shader& downsampleShader, Shader& upsampleShader, Shader& luminanceShader, Shader& tonemapShader)
+        : downsampleShader(downsampleShader), upsampleShader(upsampleShader),
+          luminanceShader(luminanceShader), tonemapShader(tonemapShader) {}
+
+    void Init(int width, int height)
+    {
+        createTargets(width, height);
+
+        glGenTextures(1, &luminance);
+        glBindTexture(GL_TEXTURE_2D, luminance);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, LuminanceSize, LuminanceSize, 0, GL_RED, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glGenFramebuffers(1, &luminanceFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, luminanceFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, luminance, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::POST_PROCESS:: luminance framebuffer is not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(ReadbackLatency, readbackBuffers);
+        for (unsigned int i = 0; i < ReadbackLatency; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float), NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // the targets are only reallocated when they have to grow
+    void Resize(int newWidth, int newHeight)
+    {
+        if (newWidth > targetWidth || newHeight > targetHeight)
+        {
+            int grownWidth = std::max(newWidth, targetWidth), grownHeight = std::max(newHeight, targetHeight);
+            deleteTargets();
+            createTargets(grownWidth, grownHeight);
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+
+    // runs the whole stack on the scene colour, which covers sceneUvScale of its texture, into the output
+    // target. Leaves the output framebuffer bound with the render viewport.
+    void Apply(unsigned int sceneTexture, const glm::vec2& sceneUvScale, float deltaTime)
+    {
+        timer.Begin();
+        readLuminance(deltaTime);
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(emptyVAO);
+        glActiveTexture(GL_TEXTURE0);
+
+        // bloom, down the chain
+        downsampleShader.use();
+        downsampleShader.setInt("source", 0);
+        for (int i = 0; i < BloomLevels; i++)
+        {
+            bool fromScene = i == 0;
+            glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[i]);
+            glViewport(0, 0, levelSize(width, i), levelSize(height, i));
+            glBindTexture(GL_TEXTURE_2D, fromScene ? sceneTexture : bloom[i - 1]);
+            downsampleShader.setBool("prefilter", fromScene);
+            downsampleShader.setFloat("threshold", bloomThreshold);
+            downsampleShader.setFloat("knee", bloomKnee);
+            downsampleShader.setVec2("uvScale", fromScene ? sceneUvScale : levelUvScale(i - 1));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+
+        // and back up, each level adds to the one above it
+        upsampleShader.use();
+        upsampleShader.setInt("source", 0);
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFunc(GL_ONE, GL_ONE);
+        for (int i = BloomLevels - 1; i > 0; i--)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO[i - 1]);
+            glViewport(0, 0, levelSize(width, i - 1), levelSize(height, i - 1));
+            glBindTexture(GL_TEXTURE_2D, bloom[i]);
+            upsampleShader.setVec2("uvScale", levelUvScale(i));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glDisable(GL_BLEND);
+
+        // log luminance, reduced to one texel by the mip chain and read back in later frames
+        glBindFramebuffer(GL_FRAMEBUFFER, luminanceFBO);
+        glViewport(0, 0, LuminanceSize, LuminanceSize);
+        luminanceShader.use();
+        luminanceShader.setInt("scene", 0);
+        luminanceShader.setVec2("uvScale", sceneUvScale);
+        glBindTexture(GL_TEXTURE_2D, sceneTexture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindTexture(GL_TEXTURE_2D, luminance);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        requestLuminance();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glViewport(0, 0, width, height);
+        tonemapShader.use();
+        glBindTexture(GL_TEXTURE_2D, sceneTexture);
+        tonemapShader.setInt("scene", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, bloom[0]);
+        tonemapShader.setInt("bloom", 1);
+        tonemapShader.setVec2("uvScale", sceneUvScale);
+        tonemapShader.setVec2("bloomUvScale", levelUvScale(0));
+        tonemapShader.setFloat("exposure", exposure);
+        tonemapShader.setFloat("bloomStrength", bloomStrength);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        timer.End();
+    }
+
+    unsigned int OutputFramebuffer() const { return outputFBO; }
+    unsigned int OutputTexture() const { return output; }
+    // part of the output texture covered by the frame, the targets only grow
+    glm::vec2 UvScale() const { return glm::vec2((float)width / targetWidth, (float)height / targetHeight); }
+    float Exposure() const { return exposure; }
+    // geometric mean of the scene luminance, 0 until the first readback
+    float AverageLuminance() const { return averageLuminance; }
+    bool Milliseconds(double& result) const { return timer.Milliseconds(result); }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteFramebuffers(1, &luminanceFBO);
+        glDeleteTextures(1, &luminance);
+        luminanceFBO = luminance = 0;
+        for (unsigned int i = 0; i < ReadbackLatency; i++)
+        {
+            if (fences[i])
+                glDeleteSync(fences[i]);
+            fences[i] = 0;
+        }
+        glDeleteBuffers(ReadbackLatency, readbackBuffers);
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+        timer.deleteQueries();
+    }
+
+private:
+    Shader& downsampleShader;
+    Shader& upsampleShader;
+    Shader& luminanceShader;
+    Shader& tonemapShader;
+
+    int width = 0, height = 0;             // drawn area
+    int targetWidth = 0, targetHeight = 0; // allocated
+    unsigned int bloomFBO[BloomLevels] = {};
+    unsigned int bloom[BloomLevels] = {};
+    unsigned int outputFBO = 0, output = 0;
+    unsigned int luminanceFBO = 0, luminance = 0;
+    unsigned int emptyVAO = 0;
+
+    GLuint readbackBuffers[ReadbackLatency] = {};
+    GLsync fences[ReadbackLatency] = {};
+    unsigned int nextReadback = 0;
+    float averageLuminance = 0.0f;
+    float adaptedLuminance = -1.0f;
+    float exposure = 1.0f;
+
+    GpuTimer timer;
+
+    // level 0 is half the scene resolution
+    static int levelSize(int size, int level) { return std::max(1, size >> (level + 1)); }
+
+    glm::vec2 levelUvScale(int level) const
+    {
+        return glm::vec2((float)levelSize(width, level) / levelSize(targetWidth, level),
+                         (float)levelSize(height, level) / levelSize(targetHeight, level));
+    }
+
+    void requestLuminance()
+    {
+        if (fences[nextReadback])
+            return; // all buffers still in flight, this frame isn't read
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[nextReadback]);
+        glGetTexImage(GL_TEXTURE_2D, LuminanceLevels - 1, GL_RED, GL_FLOAT, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[nextReadback] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        nextReadback = (nextReadback + 1) % ReadbackLatency;
+    }
+
+    // takes the newest finished readback without waiting and moves the exposure towards it
+    void readLuminance(float deltaTime)
+    {
+        for (unsigned int i = 0; i < ReadbackLatency; i++)
+        {
+            unsigned int slot = (nextReadback + i) % ReadbackLatency; // oldest first
+            if (!fences[slot])
+                continue;
+            GLenum status = glClientWaitSync(fences[slot], 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break; // the newer ones aren't done either
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffers[slot]);
+            float* logLuminance = (float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float), GL_MAP_READ_BIT);
+            if (logLuminance)
+            {
+                averageLuminance = std::exp(*logLuminance);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+
+        if (!autoExposure)
+        {
+            exposure = 1.0f;
+            adaptedLuminance = -1.0f;
+            return;
+        }
+        if (averageLuminance <= 0.0f)
+            return;
+        if (adaptedLuminance < 0.0f)
+            adaptedLuminance = averageLuminance;
+        else
+            adaptedLuminance += (averageLuminance - adaptedLuminance) * (1.0f - std::exp(-deltaTime * adaptationSpeed));
+        exposure = std::min(maxExposure, std::max(minExposure, exposureKey / adaptedLuminance));
+    }
+
+    static unsigned int createTarget(GLenum internalFormat, GLenum format, GLenum type, int width, int height)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    static unsigned int createFramebuffer(unsigned int texture)
+    {
+        unsigned int framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::POST_PROCESS:: framebuffer is not complete" << endl;
+        return framebuffer;
+    }
+
+    void createTargets(int newWidth, int newHeight)
+    {
+        width = targetWidth = newWidth;
+        height = targetHeight = newHeight;
+        for (int i = 0; i < BloomLevels; i++)
+        {
+            bloom[i] = createTarget(GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT,
+                                    levelSize(targetWidth, i), levelSize(targetHeight, i));
+            bloomFBO[i] = createFramebuffer(bloom[i]);
+        }
+        output = createTarget(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, targetWidth, targetHeight);
+        outputFBO = createFramebuffer(output);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(BloomLevels, bloomFBO);
+        glDeleteTextures(BloomLevels, bloom);
+        glDeleteFramebuffers(1, &outputFBO);
+        glDeleteTextures(1, &output);
+        for (int i = 0; i < BloomLevels; i++)
+            bloomFBO[i] = bloom[i] = 0;
+        outputFBO = output = 0;
+    }
+};
+#endif
@@ -5,8 +5,6 @@
 #include <glm/glm.hpp>
 
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 #include <common.h>
 class Shader
@@ -24,69 +22,46 @@ public:
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
+        // read through the virtual file system and passed to GL in place, with explicit lengths
+        rg::FileData vShaderFile;
+        rg::FileData fShaderFile;
+        rg::FileData gShaderFile;
+        bool read = rg::vfs.read(vertexPath, vShaderFile) && rg::vfs.read(fragmentPath, fShaderFile);
+        // if geometry shader path is present, also load a geometry shader
+        if(geometryPath != nullptr)
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                appendShaderFolderIfNotPresent(geometryPathString);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
+            std::string geometryPathString(geometryPath);
+            appendShaderFolderIfNotPresent(geometryPathString);
+            read = rg::vfs.read(geometryPathString, gShaderFile) && read;
         }
-        catch (std::ifstream::failure& e)
+        if (!read)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
+        const char* vShaderCode = vShaderFile.data;
+        const char * fShaderCode = fShaderFile.data;
+        GLint vShaderLength = vShaderFile.size;
+        GLint fShaderLength = fShaderFile.size;
         // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glShaderSource(vertex, 1, &vShaderCode, &vShaderLength);
         glCompileShader(vertex);
         checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glShaderSource(fragment, 1, &fShaderCode, &fShaderLength);
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
         unsigned int geometry;
         if(geometryPath != nullptr)
         {
-            const char * gShaderCode = geometryCode.c_str();
+            const char * gShaderCode = gShaderFile.data;
+            GLint gShaderLength = gShaderFile.size;
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glShaderSource(geometry, 1, &gShaderCode, &gShaderLength);
             glCompileShader(geometry);
             checkCompileErrors(geometry, "GEOMETRY");
         }
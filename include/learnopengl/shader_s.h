@@ -4,9 +4,8 @@
 #include <glad/glad.h>
 
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
+#include <rg/VirtualFileSystem.h>
 
 void appendShaderFolderIfNotPresent(std::string& path) {
     if (path.find("resources/shaders/") == std::string::npos) {
@@ -28,45 +27,27 @@ public:
         vertexPath = vertexPathString.c_str();
         fragmentPath = fragmentPathString.c_str();
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode   = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
+        // read through the virtual file system and passed to GL in place, with explicit lengths
+        rg::FileData vShaderFile;
+        rg::FileData fShaderFile;
+        if (!rg::vfs.read(vertexPath, vShaderFile) || !rg::vfs.read(fragmentPath, fShaderFile))
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
+        const char* vShaderCode = vShaderFile.data;
+        const char * fShaderCode = fShaderFile.data;
+        GLint vShaderLength = vShaderFile.size;
+        GLint fShaderLength = fShaderFile.size;
         // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glShaderSource(vertex, 1, &vShaderCode, &vShaderLength);
         glCompileShader(vertex);
         checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glShaderSource(fragment, 1, &fShaderCode, &fShaderLength);
         glCompileShader(fragment);
         checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
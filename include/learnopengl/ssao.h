@@ -0,0 +1,272 @@
+#ifndef SSAO_H
+#define SSAO_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gpu_timer.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+using namespace std;
+
+// screen space ambient occlusion from the scene depth, for the ambient terms of the lighting shaders.
+// Three fullscreen passes:
+//   ao:       at 1/divisor of the render resolution, every pixel's view space position and normal are
+//             reconstructed from the depth, and a hemisphere of sampleCount points around it is tested
+//             against the depth (ssao.fs). The kernel is rotated per pixel with interleaved gradient noise,
+//             which the blur below averages out. The output keeps the pixel's linear depth next to the
+//             occlusion, so the next passes don't read the depth buffer at low resolution again.
+//   blur:     separable, horizontal then vertical, with the taps weighted down where their depth differs
+//             from the centre's, so the occlusion doesn't bleed over silhouettes (ssao_blur.fs).
+//   upsample: to the render resolution, the four nearest low resolution pixels weighted by how close their
+//             depth is to the full resolution depth (ssao_upsample.fs), into an R8 texture.
+// The cost is mostly the ao pass, sampleCount depth reads per pixel, so it falls with the square of the
+// divisor. Every divisor has its own GPU timer, so switching between them shows what each one costs.
+//
+// The depth has to be complete before the lit objects are shaded: in forward shading from the depth
+// pre-pass, in deferred shading from the G-buffer. The lighting shaders read the result with texelFetch at
+// their gl_FragCoord (Bind); with the pass off they get a 1x1 white texture instead.
+//
+// Targets are allocated at the largest size and only the bottom left part is used, like the scene targets.
+class Ssao
+{
+public:
+    static const unsigned int TextureUnit = 5;
+    static const int MaxSamples = 32;
+    static const int DivisorCount = 3;
+
+    bool enabled = true;
+    int divisor = 2;        // 1, 2 or 4
+    int sampleCount = 16;   // up to MaxSamples
+    float radius = 0.5f;    // world units
+    float bias = 0.025f;
+    float power = 1.5f;     // contrast of the result
+    float depthSharpness = 16.0f; // how quickly the blur and the upsample stop mixing different depths
+
+    Ssao(Shader& ssaoShader, Shader& blurShader, Shader& upsampleShader)
+        : ssaoShader(ssaoShader), blurShader(blurShader), upsampleShader(upsampleShader) {}
+
+    void Init(int width, int height)
+    {
+        createTargets(width, height);
+        glGenVertexArrays(1, &emptyVAO);
+
+        const unsigned char white = 255;
+        glGenTextures(1, &whiteTexture);
+        glBindTexture(GL_TEXTURE_2D, whiteTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, 1, 1, 0, GL_RED, GL_UNSIGNED_BYTE, &white);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // the targets are only reallocated when they have to grow
+    void Resize(int newWidth, int newHeight)
+    {
+        if (newWidth > targetWidth || newHeight > targetHeight)
+        {
+            int grownWidth = std::max(newWidth, targetWidth), grownHeight = std::max(newHeight, targetHeight);
+            deleteTargets();
+            createTargets(grownWidth, grownHeight);
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+
+    // runs the three passes over the depth (a texture with the render width x height drawn to, made with
+    // projection) and leaves the framebuffer and viewport to the caller
+    void Compute(unsigned int depthTexture, const glm::mat4& projection)
+    {
+        if (!enabled)
+            return;
+        divisor = divisor >= 4 ? 4 : (divisor >= 2 ? 2 : 1);
+        sampleCount = std::min(MaxSamples, std::max(1, sampleCount));
+        int lowWidth = (width + divisor - 1) / divisor, lowHeight = (height + divisor - 1) / divisor;
+        glm::vec2 renderSize((float)width, (float)height);
+        GpuTimer& timer = timers[divisorIndex(divisor)];
+        timer.Begin();
+
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(emptyVAO);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, lowFBO[0]);
+        glViewport(0, 0, lowWidth, lowHeight);
+        ssaoShader.use();
+        if (uploadedSamples != sampleCount)
+            uploadKernel();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        ssaoShader.setInt("depth", 0);
+        ssaoShader.setMat4("projection", projection);
+        ssaoShader.setMat4("inverseProjection", glm::inverse(projection));
+        ssaoShader.setVec2("renderSize", renderSize);
+        ssaoShader.setInt("divisor", divisor);
+        ssaoShader.setInt("sampleCount", sampleCount);
+        ssaoShader.setFloat("radius", radius);
+        ssaoShader.setFloat("bias", bias);
+        ssaoShader.setFloat("power", power);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        blurShader.use();
+        blurShader.setInt("ao", 0);
+        blurShader.setVec2("size", glm::vec2((float)lowWidth, (float)lowHeight));
+        blurShader.setFloat("depthSharpness", depthSharpness);
+        for (int pass = 0; pass < 2; pass++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, lowFBO[1 - pass]);
+            glBindTexture(GL_TEXTURE_2D, lowTextures[pass]);
+            blurShader.setVec2("direction", pass == 0 ? glm::vec2(1.0f, 0.0f) : glm::vec2(0.0f, 1.0f));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+        glViewport(0, 0, width, height);
+        upsampleShader.use();
+        glBindTexture(GL_TEXTURE_2D, lowTextures[0]);
+        upsampleShader.setInt("ao", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        upsampleShader.setInt("depth", 1);
+        upsampleShader.setMat4("projection", projection);
+        upsampleShader.setVec2("lowSize", glm::vec2((float)lowWidth, (float)lowHeight));
+        upsampleShader.setInt("divisor", divisor);
+        upsampleShader.setFloat("depthSharpness", depthSharpness);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        timer.End();
+    }
+
+    // binds the occlusion (white with the pass off) for a lighting shader with an ambientOcclusion sampler
+    void Bind(Shader& shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + TextureUnit);
+        glBindTexture(GL_TEXTURE_2D, enabled ? output : whiteTexture);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("ambientOcclusion", TextureUnit);
+    }
+
+    // white for a lighting shader drawing something that isn't in the depth the occlusion was computed from,
+    // it would get the occlusion of whatever is behind it
+    void BindNone(Shader& shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + TextureUnit);
+        glBindTexture(GL_TEXTURE_2D, whiteTexture);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("ambientOcclusion", TextureUnit);
+    }
+
+    // newest measurement with the given divisor, false until there is one
+    bool Milliseconds(int forDivisor, double& result) const
+    {
+        return timers[divisorIndex(forDivisor)].Milliseconds(result);
+    }
+
+    unsigned int OutputTexture() const { return output; }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteTextures(1, &whiteTexture);
+        glDeleteVertexArrays(1, &emptyVAO);
+        whiteTexture = emptyVAO = 0;
+        for (GpuTimer& timer : timers)
+            timer.deleteQueries();
+    }
+
+private:
+    Shader& ssaoShader;
+    Shader& blurShader;
+    Shader& upsampleShader;
+
+    int width = 0, height = 0;             // drawn area
+    int targetWidth = 0, targetHeight = 0; // allocated
+    unsigned int lowTextures[2] = { 0, 0 }; // occlusion and linear depth, ao / vertical blur and horizontal blur
+    unsigned int lowFBO[2] = { 0, 0 };
+    unsigned int output = 0;
+    unsigned int outputFBO = 0;
+    unsigned int whiteTexture = 0;
+    unsigned int emptyVAO = 0;
+    int uploadedSamples = 0;
+    GpuTimer timers[DivisorCount]; // divisor 1, 2, 4
+
+    static int divisorIndex(int divisor) { return divisor >= 4 ? 2 : (divisor >= 2 ? 1 : 0); }
+
+    // points in the +z hemisphere, more of them close to the centre: the occluders nearby matter most
+    void uploadKernel()
+    {
+        std::default_random_engine generator(7);
+        std::uniform_real_distribution<float> random(0.0f, 1.0f);
+        for (int i = 0; i < sampleCount; i++)
+        {
+            glm::vec3 sample(random(generator) * 2.0f - 1.0f, random(generator) * 2.0f - 1.0f, random(generator));
+            sample = glm::normalize(sample) * random(generator);
+            float scale = (float)i / sampleCount;
+            sample *= 0.1f + 0.9f * scale * scale;
+            ssaoShader.setVec3("samples[" + std::to_string(i) + "]", sample);
+        }
+        uploadedSamples = sampleCount;
+    }
+
+    static unsigned int createTexture(int width, int height, GLint internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    static unsigned int createFramebuffer(unsigned int texture)
+    {
+        unsigned int framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::SSAO:: framebuffer is not complete" << endl;
+        return framebuffer;
+    }
+
+    void createTargets(int newWidth, int newHeight)
+    {
+        width = targetWidth = newWidth;
+        height = targetHeight = newHeight;
+        // room for the largest low resolution size, divisor 1
+        for (int i = 0; i < 2; i++)
+        {
+            lowTextures[i] = createTexture(targetWidth, targetHeight, GL_RG16F, GL_RG, GL_HALF_FLOAT);
+            lowFBO[i] = createFramebuffer(lowTextures[i]);
+        }
+        output = createTexture(targetWidth, targetHeight, GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+        outputFBO = createFramebuffer(output);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(2, lowFBO);
+        glDeleteTextures(2, lowTextures);
+        glDeleteFramebuffers(1, &outputFBO);
+        glDeleteTextures(1, &output);
+        lowFBO[0] = lowFBO[1] = lowTextures[0] = lowTextures[1] = 0;
+        outputFBO = output = 0;
+    }
+};
+#endif
@@ -0,0 +1,232 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <rg/GLExtensions.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// per-frame data (uniform blocks, vertex and instance data) bump allocated from one buffer that is
+// written by the CPU while the GPU still reads the previous frames:
+//   persistent: with GL 4.4 / ARB_buffer_storage the buffer holds FrameCount regions of bytesPerFrame and
+//               stays mapped (coherent) for its whole life. Every frame writes the next region; a fence
+//               placed after the frame's last draw is waited for before its region is reused, so the
+//               CPU can be at most FrameCount - 1 frames ahead and never overwrites data in flight.
+//   orphaning:  on GL 3.3 a buffer can't be drawn from while mapped, so allocations go to a CPU copy and
+//               Commit copies them with glBufferSubData. The buffer is orphaned (glBufferData with NULL)
+//               at the start of every frame, so the driver hands out fresh storage instead of waiting.
+// Either way an allocation is written through Allocation::data and then committed before the draw that
+// reads it. An allocation that doesn't fit in what is left of the frame fails (data is null) and is
+// counted; the peak per frame in Stats says how big bytesPerFrame has to be.
+//
+// Shader storage buffers need GL 4.3, so on the 3.3 context this is used for uniform blocks
+// (AllocateUniform keeps GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT) and vertex attributes.
+class StreamBuffer
+{
+public:
+    static const unsigned int FrameCount = 3;
+
+    struct Allocation
+    {
+        void* data = nullptr;
+        GLintptr offset = 0; // in Buffer()
+        GLsizeiptr size = 0;
+    };
+
+    struct Stats
+    {
+        size_t frameBytes = 0;      // used by the last finished frame
+        size_t peakBytes = 0;       // most any frame used
+        unsigned int allocations = 0; // in the last finished frame
+        unsigned int overflows = 0; // failed allocations, in total
+        unsigned int stalls = 0;    // frames that had to wait for their region, in total
+        double waitMilliseconds = 0.0; // spent waiting, in total
+    };
+
+    void Init(size_t bytesPerFrame)
+    {
+        frameSize = bytesPerFrame;
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = std::max(1, alignment);
+
+        persistent = rg::glExt.bufferStorage;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        if (persistent)
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            rg::glExt.BufferStorage(GL_COPY_WRITE_BUFFER, FrameCount * frameSize, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, FrameCount * frameSize, flags);
+            if (!mapped)
+            {
+                cout << "ERROR::STREAM_BUFFER:: persistent mapping failed, orphaning instead" << endl;
+                glDeleteBuffers(1, &buffer);
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                persistent = false;
+            }
+        }
+        if (!persistent)
+        {
+            glBufferData(GL_COPY_WRITE_BUFFER, frameSize, NULL, GL_STREAM_DRAW);
+            staging.resize(frameSize);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        cout << "STREAM_BUFFER:: " << FrameCount << " x " << frameSize / 1024 << " KiB, "
+             << (persistent ? "persistent mapping" : "orphaning") << endl;
+    }
+
+    // before the first allocation of the frame: waits until the GPU is done with the region this frame
+    // writes (persistent) or orphans the buffer
+    void BeginFrame()
+    {
+        head = 0;
+        allocations = 0;
+        if (!persistent)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, frameSize, NULL, GL_STREAM_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            return;
+        }
+        GLsync& fence = fences[region];
+        if (!fence)
+            return;
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            stats.stalls++;
+            auto waitStart = std::chrono::steady_clock::now();
+            do
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            while (result == GL_TIMEOUT_EXPIRED);
+            stats.waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+        }
+        if (result == GL_WAIT_FAILED)
+            cout << "ERROR::STREAM_BUFFER:: waiting for the fence failed" << endl;
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    // after the frame's last draw that reads the buffer
+    void EndFrame()
+    {
+        if (persistent)
+        {
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            region = (region + 1) % FrameCount;
+        }
+        stats.frameBytes = head;
+        stats.peakBytes = std::max(stats.peakBytes, head);
+        stats.allocations = allocations;
+    }
+
+    Allocation Allocate(size_t bytes, size_t alignment = 16)
+    {
+        Allocation allocation;
+        size_t offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + bytes > frameSize)
+        {
+            if (stats.overflows++ == 0)
+                cout << "ERROR::STREAM_BUFFER:: a frame needs more than " << frameSize / 1024 << " KiB" << endl;
+            return allocation;
+        }
+        head = offset + bytes;
+        allocations++;
+        allocation.size = bytes;
+        if (persistent)
+        {
+            allocation.offset = region * frameSize + offset;
+            allocation.data = mapped + allocation.offset;
+        }
+        else
+        {
+            allocation.offset = offset;
+            allocation.data = staging.data() + offset;
+        }
+        return allocation;
+    }
+
+    // with the offset alignment uniform block ranges need
+    Allocation AllocateUniform(size_t bytes)
+    {
+        return Allocate(bytes, uniformAlignment);
+    }
+
+    // makes the written allocation visible to the GPU, nothing to do with a coherent mapping
+    void Commit(const Allocation& allocation)
+    {
+        if (persistent || !allocation.data)
+            return;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, allocation.size, allocation.data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // allocate, copy and commit in one go
+    Allocation Write(const void* data, size_t bytes, size_t alignment = 16)
+    {
+        Allocation allocation = Allocate(bytes, alignment);
+        if (allocation.data)
+        {
+            memcpy(allocation.data, data, bytes);
+            Commit(allocation);
+        }
+        return allocation;
+    }
+
+    unsigned int Buffer() const { return buffer; }
+    bool Persistent() const { return persistent; }
+    size_t BytesPerFrame() const { return frameSize; }
+    const Stats& GetStats() const { return stats; }
+
+    void PrintStats(const string& name) const
+    {
+        cout << "STREAM_BUFFER::" << name << ": " << stats.frameBytes / 1024.0 << " KiB in " << stats.allocations
+             << " allocations last frame, peak " << stats.peakBytes / 1024.0 << " of " << frameSize / 1024
+             << " KiB, " << stats.overflows << " overflows, " << stats.stalls << " stalls ("
+             << stats.waitMilliseconds << " ms waited), " << (persistent ? "persistent" : "orphaning") << endl;
+    }
+
+    void deleteBuffers()
+    {
+        for (GLsync& fence : fences)
+        {
+            if (fence)
+                glDeleteSync(fence);
+            fence = 0;
+        }
+        if (persistent && buffer)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        mapped = nullptr;
+        vector<unsigned char>().swap(staging);
+    }
+
+private:
+    unsigned int buffer = 0;
+    bool persistent = false;
+    size_t frameSize = 0;
+    size_t uniformAlignment = 256;
+    unsigned char* mapped = nullptr;
+    vector<unsigned char> staging; // orphaning only
+    GLsync fences[FrameCount] = {};
+    unsigned int region = 0;
+    size_t head = 0;
+    unsigned int allocations = 0;
+    Stats stats;
+};
+#endif
@@ -0,0 +1,333 @@
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+using namespace std;
+
+// the shared state of the passes that accumulate over frames:
+//   jitter:         with jitter on, the projection is offset by a sub-pixel amount from a Halton (2, 3)
+//                   sequence every frame, so accumulated frames sample different points of each pixel
+//   motion vectors: for every pixel, how far its surface moved on screen since the last frame. The camera
+//                   part comes from the depth buffer and last frame's view-projection (camera_motion.fs),
+//                   moving objects are drawn over it with their current and previous model matrices
+//                   (motion_vectors.vs/fs). Both use the matrices without jitter, so a still camera gives
+//                   zero motion.
+// The accumulation itself is done by a TemporalAccumulator per effect, with its own resolve shader.
+//
+// The velocity target is allocated at the largest size and only the bottom left width x height is used,
+// like the scene targets.
+class Temporal
+{
+public:
+    static const unsigned int JitterPhases = 8;
+    bool jitter = false;
+
+    Temporal(Shader& cameraMotionShader, Shader& objectMotionShader)
+        : cameraMotionShader(cameraMotionShader), objectMotionShader(objectMotionShader) {}
+
+    void Init(int width, int height)
+    {
+        createTargets(width, height);
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // the targets are only reallocated when they have to grow
+    void Resize(int newWidth, int newHeight)
+    {
+        if (newWidth > targetWidth || newHeight > targetHeight)
+        {
+            int grownWidth = std::max(newWidth, targetWidth), grownHeight = std::max(newHeight, targetHeight);
+            deleteTargets();
+            createTargets(grownWidth, grownHeight);
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+
+    // once per frame after Resize, before anything is drawn with the projection
+    void BeginFrame(const glm::mat4& projection, const glm::mat4& view)
+    {
+        previousViewProjection = frame > 0 ? viewProjection : projection * view;
+        viewProjection = projection * view;
+        this->view = view;
+
+        jitterOffset = glm::vec2(0.0f);
+        if (jitter)
+        {
+            unsigned int index = frame % JitterPhases + 1; // the sequence starts at 0, 0 otherwise
+            jitterOffset = glm::vec2(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+        }
+        // a shift of the clip space x/y by w times the offset in NDC
+        jitteredProjection = projection;
+        jitteredProjection[2][0] += jitterOffset.x * 2.0f / width;
+        jitteredProjection[2][1] += jitterOffset.y * 2.0f / height;
+        frame++;
+    }
+
+    // the projection to draw with this frame
+    const glm::mat4& Projection() const { return jitteredProjection; }
+    // sub-pixel offset of this frame in pixels, in [-0.5, 0.5]
+    glm::vec2 Jitter() const { return jitterOffset; }
+    const glm::mat4& ViewProjection() const { return viewProjection; }
+    const glm::mat4& PreviousViewProjection() const { return previousViewProjection; }
+
+    // last frame's transform of an object (model itself the first time), called once per frame for every
+    // object that moves; remembers model for the next frame
+    glm::mat4 PreviousModel(unsigned int object, const glm::mat4& model)
+    {
+        auto it = previousModels.find(object);
+        glm::mat4 previous = it != previousModels.end() ? it->second : model;
+        previousModels[object] = model;
+        return previous;
+    }
+
+    // camera motion of every pixel from the scene depth, then binds the velocity target over that depth for
+    // the moving objects: SetObjectMotion and a draw of the positions (attribute 0) of each
+    void BeginMotionVectors(unsigned int depthTexture)
+    {
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glBindFramebuffer(GL_FRAMEBUFFER, cameraMotionFBO);
+        glViewport(0, 0, width, height);
+        cameraMotionShader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        cameraMotionShader.setInt("depth", 0);
+        cameraMotionShader.setMat4("inverseViewProjection", glm::inverse(jitteredProjection * view));
+        cameraMotionShader.setMat4("viewProjection", viewProjection);
+        cameraMotionShader.setMat4("previousViewProjection", previousViewProjection);
+        cameraMotionShader.setVec2("renderSize", glm::vec2(width, height));
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // the depth can't be sampled while it is attached, so the objects go through a second framebuffer.
+        // Attached every frame, a reallocated scene depth can come back with the same name
+        glBindFramebuffer(GL_FRAMEBUFFER, objectMotionFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        objectMotionShader.use();
+        objectMotionShader.setMat4("projection", jitteredProjection);
+        objectMotionShader.setMat4("view", view);
+        objectMotionShader.setMat4("viewProjection", viewProjection);
+        objectMotionShader.setMat4("previousViewProjection", previousViewProjection);
+    }
+
+    void SetObjectMotion(const glm::mat4& model, const glm::mat4& previousModel)
+    {
+        objectMotionShader.setMat4("model", model);
+        objectMotionShader.setMat4("previousModel", previousModel);
+    }
+
+    void EndMotionVectors()
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+
+    // screen space motion since the last frame in RG, in fractions of the frame (current - previous)
+    unsigned int VelocityTexture() const { return velocity; }
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+private:
+    Shader& cameraMotionShader;
+    Shader& objectMotionShader;
+
+    int width = 0, height = 0;             // drawn area
+    int targetWidth = 0, targetHeight = 0; // allocated
+    unsigned int velocity = 0;
+    unsigned int cameraMotionFBO = 0, objectMotionFBO = 0;
+    unsigned int emptyVAO = 0;
+
+    unsigned int frame = 0;
+    glm::vec2 jitterOffset = glm::vec2(0.0f);
+    glm::mat4 jitteredProjection = glm::mat4(1.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::mat4 previousViewProjection = glm::mat4(1.0f);
+    unordered_map<unsigned int, glm::mat4> previousModels;
+
+    static float halton(unsigned int index, unsigned int base)
+    {
+        float result = 0.0f, fraction = 1.0f;
+        for (; index > 0; index /= base)
+        {
+            fraction /= base;
+            result += fraction * (index % base);
+        }
+        return result;
+    }
+
+    void createTargets(int newWidth, int newHeight)
+    {
+        width = targetWidth = newWidth;
+        height = targetHeight = newHeight;
+        glGenTextures(1, &velocity);
+        glBindTexture(GL_TEXTURE_2D, velocity);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, targetWidth, targetHeight, 0, GL_RG, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &cameraMotionFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, cameraMotionFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, velocity, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::TEMPORAL:: framebuffer is not complete" << endl;
+        // the depth is attached when there is one, see BeginMotionVectors
+        glGenFramebuffers(1, &objectMotionFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, objectMotionFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, velocity, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(1, &cameraMotionFBO);
+        glDeleteFramebuffers(1, &objectMotionFBO);
+        glDeleteTextures(1, &velocity);
+        cameraMotionFBO = objectMotionFBO = velocity = 0;
+    }
+};
+
+// history of one temporally accumulated effect: two targets that swap every frame, the one written is the
+// output and next frame's history. Accumulate binds the inputs every resolve shader gets:
+//   current (unit 0), history (unit 1), velocity (unit 2), renderSize, historyUvScale (part of the history
+//   texture drawn last frame, the resolution can change in between) and historyValid,
+// the effect sets its own uniforms on the shader before. The history is dropped when the targets are
+// reallocated or Reset is called (e.g. while the effect is off).
+class TemporalAccumulator
+{
+public:
+    void Init(int width, int height, GLenum internalFormat, GLenum format)
+    {
+        this->internalFormat = internalFormat;
+        this->format = format;
+        createTargets(width, height);
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // the targets are only reallocated when they have to grow
+    void Resize(int newWidth, int newHeight)
+    {
+        if (newWidth > targetWidth || newHeight > targetHeight)
+        {
+            int grownWidth = std::max(newWidth, targetWidth), grownHeight = std::max(newHeight, targetHeight);
+            deleteTargets();
+            createTargets(grownWidth, grownHeight);
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+
+    void Reset() { historyValid = false; }
+
+    // resolves the current frame (a texture with the same pixel grid as the render area) with the history
+    // into the other target, which becomes the output. Leaves the output framebuffer bound.
+    void Accumulate(Shader& shader, unsigned int currentTexture, const Temporal& temporal)
+    {
+        unsigned int written = 1 - history;
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO[written]);
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+
+        shader.use();
+        const unsigned int inputs[] = { currentTexture, targets[history], temporal.VelocityTexture() };
+        const char* names[] = { "current", "history", "velocity" };
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, inputs[i]);
+            shader.setInt(names[i], i);
+        }
+        shader.setVec2("renderSize", glm::vec2(width, height));
+        shader.setVec2("historyUvScale", glm::vec2((float)historyWidth / targetWidth, (float)historyHeight / targetHeight));
+        shader.setBool("historyValid", historyValid);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        history = written;
+        historyWidth = width;
+        historyHeight = height;
+        historyValid = true;
+    }
+
+    unsigned int OutputFramebuffer() const { return FBO[history]; }
+    unsigned int OutputTexture() const { return targets[history]; }
+    // part of the output texture covered by the frame
+    glm::vec2 UvScale() const { return glm::vec2((float)width / targetWidth, (float)height / targetHeight); }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+private:
+    GLenum internalFormat = GL_RGBA16F, format = GL_RGBA;
+    int width = 0, height = 0;             // drawn area
+    int targetWidth = 0, targetHeight = 0; // allocated
+    unsigned int targets[2] = {};
+    unsigned int FBO[2] = {};
+    unsigned int emptyVAO = 0;
+    unsigned int history = 0;
+    int historyWidth = 0, historyHeight = 0;
+    bool historyValid = false;
+
+    void createTargets(int newWidth, int newHeight)
+    {
+        width = targetWidth = historyWidth = newWidth;
+        height = targetHeight = historyHeight = newHeight;
+        for (int i = 0; i < 2; i++)
+        {
+            glGenTextures(1, &targets[i]);
+            glBindTexture(GL_TEXTURE_2D, targets[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, targetWidth, targetHeight, 0, format, GL_HALF_FLOAT, NULL);
+            // the history is resampled where the motion points
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+            glGenFramebuffers(1, &FBO[i]);
+            glBindFramebuffer(GL_FRAMEBUFFER, FBO[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                cout << "ERROR::TEMPORAL:: history framebuffer is not complete" << endl;
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        historyValid = false;
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(2, FBO);
+        glDeleteTextures(2, targets);
+        FBO[0] = FBO[1] = targets[0] = targets[1] = 0;
+    }
+};
+#endif
@@ -0,0 +1,156 @@
+#ifndef WEIGHTED_OIT_H
+#define WEIGHTED_OIT_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <iostream>
+using namespace std;
+
+// weighted blended order-independent transparency (McGuire & Bavoil 2013). Translucent geometry is drawn
+// in any order between Begin and End, depth tested against the opaque scene but without writing depth,
+// into two targets (see oit_accumulate.fs):
+//   RGBA16F: sum of colour * alpha * weight, and the revealage (product of 1 - alpha) in alpha
+//   R16F:    sum of alpha * weight
+// Composite then blends the weighted average colour over the scene with the revealage, in one
+// fullscreen pass. Nothing has to be sorted, so the cost doesn't depend on how the layers overlap.
+//
+// Both targets use the same separate blend function, (ONE, ONE) for colour and (ZERO, ONE_MINUS_SRC_ALPHA)
+// for alpha, so GL 3.3 is enough (no per-target blending from GL 4.0).
+//
+// The opaque depth is copied in from the scene framebuffer by Begin, which needs a 24 bit depth /
+// 8 bit stencil buffer like the one GLFW creates.
+class WeightedOit
+{
+public:
+    void Init(int width, int height)
+    {
+        createTargets(width, height);
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // size of the area drawn to, from the bottom left corner. The targets are only reallocated when they
+    // have to grow, so a resolution that changes every frame doesn't allocate
+    void Resize(int newWidth, int newHeight)
+    {
+        if (newWidth > targetWidth || newHeight > targetHeight)
+        {
+            int grownWidth = std::max(newWidth, targetWidth), grownHeight = std::max(newHeight, targetHeight);
+            deleteTargets();
+            createTargets(grownWidth, grownHeight);
+        }
+        width = newWidth;
+        height = newHeight;
+    }
+
+    // the translucent draws follow, with a shader that writes both targets like oit_accumulate.fs
+    void Begin(unsigned int sceneFramebuffer = 0)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        const float clearAccumulation[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        const float clearWeightedAlpha[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, clearAccumulation);
+        glClearBufferfv(GL_COLOR, 1, clearWeightedAlpha);
+
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    void End()
+    {
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+    }
+
+    // blends the translucent layers over the scene framebuffer and leaves it bound
+    void Composite(Shader& shader, unsigned int sceneFramebuffer = 0)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+        shader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, accumulation);
+        shader.setInt("accumulation", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, weightedAlpha);
+        shader.setInt("weightedAlpha", 1);
+
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void deleteBuffers()
+    {
+        deleteTargets();
+        glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+    }
+
+private:
+    int width = 0, height = 0;             // drawn area
+    int targetWidth = 0, targetHeight = 0; // allocated
+    unsigned int FBO = 0;
+    unsigned int accumulation = 0, weightedAlpha = 0;
+    unsigned int depthRBO = 0;
+    unsigned int emptyVAO = 0;
+
+    static unsigned int createTarget(GLenum internalFormat, GLenum format, int width, int height)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_HALF_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        return texture;
+    }
+
+    void createTargets(int newWidth, int newHeight)
+    {
+        width = targetWidth = newWidth;
+        height = targetHeight = newHeight;
+        accumulation = createTarget(GL_RGBA16F, GL_RGBA, width, height);
+        weightedAlpha = createTarget(GL_R16F, GL_RED, width, height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weightedAlpha, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        const GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::WEIGHTED_OIT:: framebuffer is not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void deleteTargets()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &accumulation);
+        glDeleteTextures(1, &weightedAlpha);
+        glDeleteRenderbuffers(1, &depthRBO);
+        FBO = accumulation = weightedAlpha = depthRBO = 0;
+    }
+};
+#endif
@@ -0,0 +1,272 @@
+//
+// Packed asset archive: one file holding the whole resources/ tree so startup maps a single file
+// instead of opening every OBJ, MTL, image and shader on its own.
+//
+// Layout: Header, Entry[entryCount] sorted by name, the names (not null terminated), then every blob
+// at a 64 byte aligned offset. Blobs are stored as is or LZ4 block compressed, per entry.
+// Written by the pack_assets tool (tools/pack_assets.cpp), read through rg/VirtualFileSystem.h.
+//
+
+#ifndef PROJECT_BASE_ARCHIVE_H
+#define PROJECT_BASE_ARCHIVE_H
+
+#include <rg/LZ4.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace rg {
+
+namespace archive {
+    const char Magic[4] = { 'R', 'G', 'P', 'K' };
+    const uint32_t Version = 1;
+    const uint64_t BlobAlignment = 64;
+
+    enum class Compression : uint32_t {
+        None = 0,
+        LZ4 = 1
+    };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t namesSize;
+    };
+
+    struct Entry {
+        uint64_t offset;        // from the start of the archive
+        uint64_t storedSize;    // bytes in the archive
+        uint64_t size;          // bytes after decompression
+        uint32_t nameOffset;    // into the names block
+        uint32_t nameLength;
+        uint32_t compression;
+        uint32_t reserved;
+    };
+
+    // a file to be packed, name is the path the loaders ask for (relative to the project root)
+    struct Source {
+        std::string name;
+        std::vector<unsigned char> data;
+    };
+
+    struct WriteStats {
+        uint64_t originalBytes = 0;
+        uint64_t storedBytes = 0;
+        unsigned int compressedEntries = 0;
+    };
+};
+
+class Archive {
+public:
+    Archive() = default;
+    Archive(const Archive&) = delete;
+    Archive& operator=(const Archive&) = delete;
+    ~Archive() {
+        close();
+    }
+
+    // maps the whole archive read only and checks that the index stays inside the file
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(archive::Header)) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        base = (const unsigned char*)mapped;
+        mappedSize = info.st_size;
+        if (!validate()) {
+            close();
+            return false;
+        }
+        madvise(mapped, mappedSize, MADV_WILLNEED);
+        return true;
+    }
+
+    void close() {
+        if (base) {
+            munmap((void*)base, mappedSize);
+        }
+        base = nullptr;
+        mappedSize = 0;
+        entries = nullptr;
+        names = nullptr;
+        entryCount = 0;
+    }
+
+    bool isOpen() const {
+        return base != nullptr;
+    }
+
+    // binary search over the sorted index
+    const archive::Entry* find(const std::string& name) const {
+        const archive::Entry* end = entries + entryCount;
+        const archive::Entry* it = std::lower_bound(entries, end, name, [this](const archive::Entry& entry, const std::string& key) {
+            return compareName(entry, key) < 0;
+        });
+        return it != end && compareName(*it, name) == 0 ? it : nullptr;
+    }
+
+    // points into the mapping, valid until close()
+    const unsigned char* storedData(const archive::Entry& entry) const {
+        return base + entry.offset;
+    }
+
+    // copies (or decompresses) the entry into dst, which has to hold entry.size bytes
+    bool extract(const archive::Entry& entry, unsigned char* dst) const {
+        if ((archive::Compression)entry.compression == archive::Compression::None) {
+            std::memcpy(dst, storedData(entry), entry.size);
+            return true;
+        }
+        return lz4Decompress(storedData(entry), entry.storedSize, dst, entry.size);
+    }
+
+    std::string name(const archive::Entry& entry) const {
+        return std::string(names + entry.nameOffset, entry.nameLength);
+    }
+
+    unsigned int size() const {
+        return entryCount;
+    }
+
+    const archive::Entry& entry(unsigned int i) const {
+        return entries[i];
+    }
+
+    // entries are compressed only when that saves at least an eighth of their size,
+    // already compressed formats (JPG, PNG) end up stored as is
+    static bool write(const std::string& path, std::vector<archive::Source>& files, bool compress, archive::WriteStats& stats) {
+        std::sort(files.begin(), files.end(), [](const archive::Source& a, const archive::Source& b) {
+            return a.name < b.name;
+        });
+
+        std::vector<archive::Entry> index(files.size());
+        std::string namesBlock;
+        std::vector<std::vector<unsigned char>> blobs(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            archive::Entry& entry = index[i];
+            entry = {};
+            entry.nameOffset = namesBlock.size();
+            entry.nameLength = files[i].name.size();
+            entry.size = files[i].data.size();
+            namesBlock += files[i].name;
+
+            if (compress && !files[i].data.empty()) {
+                std::vector<unsigned char> packed(lz4CompressBound(files[i].data.size()));
+                size_t packedSize = lz4Compress(files[i].data.data(), files[i].data.size(), packed.data(), packed.size());
+                if (packedSize != 0 && packedSize <= files[i].data.size() - files[i].data.size() / 8) {
+                    packed.resize(packedSize);
+                    blobs[i] = std::move(packed);
+                    entry.compression = (uint32_t)archive::Compression::LZ4;
+                    stats.compressedEntries++;
+                }
+            }
+            if (entry.compression == (uint32_t)archive::Compression::None) {
+                blobs[i] = files[i].data;
+            }
+            entry.storedSize = blobs[i].size();
+            stats.originalBytes += entry.size;
+            stats.storedBytes += entry.storedSize;
+        }
+
+        uint64_t offset = sizeof(archive::Header) + index.size() * sizeof(archive::Entry) + namesBlock.size();
+        for (archive::Entry& entry : index) {
+            offset = alignUp(offset);
+            entry.offset = offset;
+            offset += entry.storedSize;
+        }
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        archive::Header header = {};
+        std::memcpy(header.magic, archive::Magic, sizeof(header.magic));
+        header.version = archive::Version;
+        header.entryCount = index.size();
+        header.namesSize = namesBlock.size();
+
+        bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+               && fwrite(index.data(), sizeof(archive::Entry), index.size(), file) == index.size()
+               && fwrite(namesBlock.data(), 1, namesBlock.size(), file) == namesBlock.size();
+        uint64_t position = sizeof(archive::Header) + index.size() * sizeof(archive::Entry) + namesBlock.size();
+        static const unsigned char padding[archive::BlobAlignment] = {};
+        for (size_t i = 0; ok && i < index.size(); ++i) {
+            size_t pad = index[i].offset - position;
+            ok = fwrite(padding, 1, pad, file) == pad
+              && fwrite(blobs[i].data(), 1, blobs[i].size(), file) == blobs[i].size();
+            position = index[i].offset + blobs[i].size();
+        }
+        ok = fclose(file) == 0 && ok;
+        if (!ok) {
+            remove(path.c_str());
+        }
+        return ok;
+    }
+
+private:
+    const unsigned char* base = nullptr;
+    size_t mappedSize = 0;
+    const archive::Entry* entries = nullptr;
+    const char* names = nullptr;
+    unsigned int entryCount = 0;
+
+    static uint64_t alignUp(uint64_t offset) {
+        return (offset + archive::BlobAlignment - 1) / archive::BlobAlignment * archive::BlobAlignment;
+    }
+
+    int compareName(const archive::Entry& entry, const std::string& key) const {
+        size_t common = std::min<size_t>(entry.nameLength, key.size());
+        int order = std::memcmp(names + entry.nameOffset, key.data(), common);
+        if (order != 0) {
+            return order;
+        }
+        return entry.nameLength < key.size() ? -1 : (entry.nameLength > key.size() ? 1 : 0);
+    }
+
+    bool validate() {
+        archive::Header header;
+        std::memcpy(&header, base, sizeof(header));
+        if (std::memcmp(header.magic, archive::Magic, sizeof(header.magic)) != 0 || header.version != archive::Version) {
+            return false;
+        }
+        uint64_t indexEnd = sizeof(archive::Header) + (uint64_t)header.entryCount * sizeof(archive::Entry);
+        if (indexEnd + header.namesSize > mappedSize) {
+            return false;
+        }
+        entries = (const archive::Entry*)(base + sizeof(archive::Header));
+        names = (const char*)(base + indexEnd);
+        entryCount = header.entryCount;
+        for (unsigned int i = 0; i < entryCount; ++i) {
+            const archive::Entry& entry = entries[i];
+            bool compressed = (archive::Compression)entry.compression == archive::Compression::LZ4;
+            if ((uint64_t)entry.nameOffset + entry.nameLength > header.namesSize
+                || entry.offset > mappedSize || entry.storedSize > mappedSize - entry.offset
+                || (!compressed && (entry.compression != 0 || entry.storedSize != entry.size))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+};
+#endif //PROJECT_BASE_ARCHIVE_H
@@ -0,0 +1,90 @@
+//
+// Assimp IO handler that reads through rg::vfs, so OBJ files and the MTL files they reference
+// come out of the packed archive like every other resource.
+//
+
+#ifndef PROJECT_BASE_ASSIMPVFS_H
+#define PROJECT_BASE_ASSIMPVFS_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <rg/VirtualFileSystem.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace rg {
+
+class VfsIOStream : public Assimp::IOStream {
+public:
+    explicit VfsIOStream(const FileData& file) : file(file) {}
+
+    size_t Read(void* buffer, size_t size, size_t count) override {
+        if (size == 0) {
+            return 0;
+        }
+        count = std::min(count, (file.size - position) / size);
+        std::memcpy(buffer, file.data + position, size * count);
+        position += size * count;
+        return count;
+    }
+
+    size_t Write(const void* buffer, size_t size, size_t count) override {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override {
+        size_t target = offset;
+        if (origin == aiOrigin_CUR) {
+            target = position + offset;
+        } else if (origin == aiOrigin_END) {
+            target = file.size - offset;
+        }
+        if (target > file.size) {
+            return aiReturn_FAILURE;
+        }
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override {
+        return position;
+    }
+
+    size_t FileSize() const override {
+        return file.size;
+    }
+
+    void Flush() override {}
+
+private:
+    FileData file;
+    size_t position = 0;
+};
+
+// read only, Open fails for any write mode
+class VfsIOSystem : public Assimp::IOSystem {
+public:
+    bool Exists(const char* path) const override {
+        return vfs.exists(path);
+    }
+
+    char getOsSeparator() const override {
+        return '/';
+    }
+
+    Assimp::IOStream* Open(const char* path, const char* mode) override {
+        FileData file;
+        if (std::strpbrk(mode, "wa+") || !vfs.read(path, file)) {
+            return nullptr;
+        }
+        return new VfsIOStream(file);
+    }
+
+    void Close(Assimp::IOStream* stream) override {
+        delete stream;
+    }
+};
+
+};
+#endif //PROJECT_BASE_ASSIMPVFS_H
@@ -0,0 +1,291 @@
+//
+// CPU encoder for the BCn block formats the GL 3.3 path can sample: BC1/BC3 (S3TC) for colour and
+// BC4/BC5 (RGTC) for one and two channel data. Every 4x4 block is encoded independently with a
+// bounding box range fit, blocks are spread over worker threads and the block min/max uses SSE2.
+//
+
+#ifndef PROJECT_BASE_BLOCKCOMPRESSION_H
+#define PROJECT_BASE_BLOCKCOMPRESSION_H
+
+#include <glad/glad.h>
+#include <rg/Parallel.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace rg {
+
+enum class BlockFormat {
+    BC1, // RGB, 8 bytes per block
+    BC3, // RGBA, BC4 style alpha + BC1 colour, 16 bytes per block
+    BC4, // single channel (red), 8 bytes per block
+    BC5  // two channels (red, green), 16 bytes per block
+};
+
+struct CompressedLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> data;
+};
+
+struct CompressedImage {
+    BlockFormat format = BlockFormat::BC1;
+    std::vector<CompressedLevel> levels;
+};
+
+unsigned int blockBytes(BlockFormat format);
+GLenum glInternalFormat(BlockFormat format);
+GLenum glBaseFormat(BlockFormat format);
+bool needsS3TC(BlockFormat format);
+void downsampleRGBA(const unsigned char* src, int width, int height, std::vector<unsigned char>& dst);
+void encodeLevel(const unsigned char* rgba, int width, int height, BlockFormat format, CompressedLevel& level);
+CompressedImage compressImage(const unsigned char* rgba, int width, int height, BlockFormat format, bool mipmaps);
+
+namespace detail {
+
+    inline uint16_t packRGB565(const unsigned char* c) {
+        return (uint16_t)((((c[0] * 31 + 127) / 255) << 11) | (((c[1] * 63 + 127) / 255) << 5) | ((c[2] * 31 + 127) / 255));
+    }
+
+    inline void unpackRGB565(uint16_t v, int* c) {
+        int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+        c[0] = (r << 3) | (r >> 2);
+        c[1] = (g << 2) | (g >> 4);
+        c[2] = (b << 3) | (b >> 2);
+    }
+
+    // gathers a 4x4 block as 16 RGBA texels, edge blocks repeat the last row/column
+    inline void fetchBlock(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char* block) {
+        for (int y = 0; y < 4; ++y) {
+            int sy = std::min(by * 4 + y, height - 1);
+            for (int x = 0; x < 4; ++x) {
+                int sx = std::min(bx * 4 + x, width - 1);
+                std::memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+            }
+        }
+    }
+
+    inline void blockMinMax(const unsigned char* block, unsigned char* minColor, unsigned char* maxColor) {
+#ifdef __SSE2__
+        __m128i a = _mm_loadu_si128((const __m128i*)(block));
+        __m128i b = _mm_loadu_si128((const __m128i*)(block + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(block + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(block + 48));
+        __m128i mn = _mm_min_epu8(_mm_min_epu8(a, b), _mm_min_epu8(c, d));
+        __m128i mx = _mm_max_epu8(_mm_max_epu8(a, b), _mm_max_epu8(c, d));
+        // fold the four texels per register down to one
+        mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(1, 0, 3, 2)));
+        mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(1, 0, 3, 2)));
+        mn = _mm_min_epu8(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(2, 3, 0, 1)));
+        mx = _mm_max_epu8(mx, _mm_shuffle_epi32(mx, _MM_SHUFFLE(2, 3, 0, 1)));
+        int minBits = _mm_cvtsi128_si32(mn);
+        int maxBits = _mm_cvtsi128_si32(mx);
+        std::memcpy(minColor, &minBits, 4);
+        std::memcpy(maxColor, &maxBits, 4);
+#else
+        std::memcpy(minColor, block, 4);
+        std::memcpy(maxColor, block, 4);
+        for (int i = 1; i < 16; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                minColor[c] = std::min(minColor[c], block[i * 4 + c]);
+                maxColor[c] = std::max(maxColor[c], block[i * 4 + c]);
+            }
+        }
+#endif
+    }
+
+    inline void encodeColorBlock(const unsigned char* block, const unsigned char* minColor, const unsigned char* maxColor, unsigned char* out) {
+        // pull the end points in a little, the box corners are rarely hit exactly
+        unsigned char lo[3], hi[3];
+        for (int c = 0; c < 3; ++c) {
+            int inset = (maxColor[c] - minColor[c]) >> 4;
+            lo[c] = (unsigned char)(minColor[c] + inset);
+            hi[c] = (unsigned char)(maxColor[c] - inset);
+        }
+        uint16_t c0 = packRGB565(hi);
+        uint16_t c1 = packRGB565(lo);
+        if (c0 < c1) {
+            std::swap(c0, c1);
+        }
+
+        uint32_t indices = 0;
+        if (c0 != c1) {
+            int palette[4][3];
+            unpackRGB565(c0, palette[0]);
+            unpackRGB565(c1, palette[1]);
+            for (int c = 0; c < 3; ++c) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; ++i) {
+                int best = 0, bestError = 1 << 30;
+                for (int p = 0; p < 4; ++p) {
+                    int dr = block[i * 4] - palette[p][0];
+                    int dg = block[i * 4 + 1] - palette[p][1];
+                    int db = block[i * 4 + 2] - palette[p][2];
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError) {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+        out[0] = c0 & 0xFF;
+        out[1] = c0 >> 8;
+        out[2] = c1 & 0xFF;
+        out[3] = c1 >> 8;
+        std::memcpy(out + 4, &indices, 4);
+    }
+
+    // one channel of the block (channel = byte offset inside a texel) as an 8 value BC4 block
+    inline void encodeChannelBlock(const unsigned char* block, int channel, unsigned char minValue, unsigned char maxValue, unsigned char* out) {
+        out[0] = maxValue;
+        out[1] = minValue;
+        uint64_t indices = 0;
+        if (maxValue != minValue) {
+            int palette[8];
+            palette[0] = maxValue;
+            palette[1] = minValue;
+            for (int p = 1; p < 7; ++p) {
+                palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+            }
+            for (int i = 0; i < 16; ++i) {
+                int value = block[i * 4 + channel];
+                int best = 0, bestError = 256;
+                for (int p = 0; p < 8; ++p) {
+                    int error = std::abs(value - palette[p]);
+                    if (error < bestError) {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint64_t)best << (3 * i);
+            }
+        }
+        for (int b = 0; b < 6; ++b) {
+            out[2 + b] = (unsigned char)(indices >> (8 * b));
+        }
+    }
+
+};
+
+    unsigned int blockBytes(BlockFormat format) {
+        return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+    }
+
+    GLenum glInternalFormat(BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BlockFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+            case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+        }
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+
+    GLenum glBaseFormat(BlockFormat format) {
+        switch (format) {
+            case BlockFormat::BC1: return GL_RGB;
+            case BlockFormat::BC3: return GL_RGBA;
+            case BlockFormat::BC4: return GL_RED;
+            case BlockFormat::BC5: return GL_RG;
+        }
+        return GL_RGB;
+    }
+
+    bool needsS3TC(BlockFormat format) {
+        return format == BlockFormat::BC1 || format == BlockFormat::BC3;
+    }
+
+    void downsampleRGBA(const unsigned char* src, int width, int height, std::vector<unsigned char>& dst) {
+        int w = std::max(1, width / 2);
+        int h = std::max(1, height / 2);
+        dst.resize((size_t)w * h * 4);
+        for (int y = 0; y < h; ++y) {
+            int y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+            for (int x = 0; x < w; ++x) {
+                int x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; ++c) {
+                    int sum = src[((size_t)y0 * width + x0) * 4 + c] + src[((size_t)y0 * width + x1) * 4 + c]
+                            + src[((size_t)y1 * width + x0) * 4 + c] + src[((size_t)y1 * width + x1) * 4 + c];
+                    dst[((size_t)y * w + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+    }
+
+    void encodeLevel(const unsigned char* rgba, int width, int height, BlockFormat format, CompressedLevel& level) {
+        int blocksX = (width + 3) / 4;
+        int blocksY = (height + 3) / 4;
+        unsigned int bytes = blockBytes(format);
+        level.width = width;
+        level.height = height;
+        level.data.resize((size_t)blocksX * blocksY * bytes);
+
+        parallelFor(blocksY, [&](unsigned int by) {
+            unsigned char block[64];
+            unsigned char minColor[4], maxColor[4];
+            for (int bx = 0; bx < blocksX; ++bx) {
+                detail::fetchBlock(rgba, width, height, bx, by, block);
+                detail::blockMinMax(block, minColor, maxColor);
+                unsigned char* out = level.data.data() + ((size_t)by * blocksX + bx) * bytes;
+                switch (format) {
+                    case BlockFormat::BC1:
+                        detail::encodeColorBlock(block, minColor, maxColor, out);
+                        break;
+                    case BlockFormat::BC3:
+                        detail::encodeChannelBlock(block, 3, minColor[3], maxColor[3], out);
+                        detail::encodeColorBlock(block, minColor, maxColor, out + 8);
+                        break;
+                    case BlockFormat::BC4:
+                        detail::encodeChannelBlock(block, 0, minColor[0], maxColor[0], out);
+                        break;
+                    case BlockFormat::BC5:
+                        detail::encodeChannelBlock(block, 0, minColor[0], maxColor[0], out);
+                        detail::encodeChannelBlock(block, 1, minColor[1], maxColor[1], out + 8);
+                        break;
+                }
+            }
+        }, 4);
+    }
+
+    // encodes the image and, if asked, a full box filtered mip chain down to 1x1
+    CompressedImage compressImage(const unsigned char* rgba, int width, int height, BlockFormat format, bool mipmaps) {
+        CompressedImage image;
+        image.format = format;
+
+        std::vector<unsigned char> current, next;
+        const unsigned char* source = rgba;
+        for (;;) {
+            image.levels.emplace_back();
+            encodeLevel(source, width, height, format, image.levels.back());
+            if (!mipmaps || (width == 1 && height == 1)) {
+                break;
+            }
+            downsampleRGBA(source, width, height, next);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+            current.swap(next);
+            source = current.data();
+        }
+        return image;
+    }
+
+};
+#endif //PROJECT_BASE_BLOCKCOMPRESSION_H
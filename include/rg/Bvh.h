@@ -0,0 +1,397 @@
+//
+// Bounding volume hierarchy over object boxes (world space AABBs of scene objects). Built top down with
+// the binned surface area heuristic; objects that move get their box replaced with update(), which refits
+// only the path from their leaf to the root and stops as soon as a node's box does not change. The tree
+// shape is not rebuilt, so after a lot of movement a new build() gives better queries.
+//
+// Queries: every object whose box intersects a frustum (nodes fully inside skip the remaining tests),
+// the first box a ray hits, and the object whose box is closest to a point. Objects are the indices of
+// the boxes passed to build().
+//
+
+#ifndef PROJECT_BASE_BVH_H
+#define PROJECT_BASE_BVH_H
+
+#include <glm/glm.hpp>
+#include <rg/Frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace rg {
+
+class Bvh {
+public:
+    static const unsigned int InvalidObject = ~0u;
+    static const unsigned int MaxLeafObjects = 4;
+    static const unsigned int MaxDepth = 96; // traversal stacks are fixed arrays of this size
+
+    void build(const std::vector<Aabb>& bounds);
+    void update(unsigned int object, const Aabb& bounds);
+
+    // calls visit(object) for every object whose box is at least partly inside
+    template<typename Visit>
+    void queryFrustum(const Frustum& frustum, Visit visit) const;
+
+    // closest object whose box the ray hits within maxDistance, distance is where the ray enters the box
+    unsigned int raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+    // object whose box is closest to point (0 when the point is inside it)
+    unsigned int nearest(const glm::vec3& point, float& distance) const;
+
+    unsigned int objectCount() const { return objectBounds.size(); }
+    unsigned int nodeCount() const { return nodes.size(); }
+    const Aabb& bounds(unsigned int object) const { return objectBounds[object]; }
+
+private:
+    struct Node {
+        Aabb bounds;
+        unsigned int first = 0;  // leaf: first entry in objects, inner node: left child (right is first + 1)
+        unsigned int count = 0;  // objects in a leaf, 0 for inner nodes
+    };
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> parents;
+    std::vector<unsigned int> objects;       // object indices in leaf order
+    std::vector<unsigned int> objectLeaf;    // leaf node of every object
+    std::vector<Aabb> objectBounds;
+    std::vector<glm::vec3> centroids;        // only used while building
+
+    void split(unsigned int node, unsigned int depth);
+    Aabb leafBounds(const Node& node) const;
+    template<typename Visit>
+    void visitSubtree(unsigned int node, Visit& visit) const;
+};
+
+const unsigned int Bvh::InvalidObject;
+const unsigned int Bvh::MaxLeafObjects;
+const unsigned int Bvh::MaxDepth;
+
+namespace detail {
+    const unsigned int bvhBins = 16;
+
+    // entry distance of a ray into a box, or a negative value when it misses within maxDistance
+    inline float rayBoxEntry(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+        float entry = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxDistance));
+        return entry <= exit ? entry : -1.0f;
+    }
+
+    inline float pointBoxDistance2(const Aabb& box, const glm::vec3& point) {
+        glm::vec3 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+        return glm::dot(d, d);
+    }
+};
+
+    void Bvh::build(const std::vector<Aabb>& bounds) {
+        objectBounds = bounds;
+        unsigned int count = bounds.size();
+        objects.resize(count);
+        centroids.resize(count);
+        for (unsigned int i = 0; i < count; ++i) {
+            objects[i] = i;
+            centroids[i] = bounds[i].center();
+        }
+        objectLeaf.assign(count, 0);
+        nodes.clear();
+        parents.clear();
+        nodes.reserve(count > 0 ? 2 * count : 1);
+        parents.reserve(nodes.capacity());
+
+        Node root;
+        root.first = 0;
+        root.count = count;
+        root.bounds = count > 0 ? leafBounds(root) : Aabb();
+        nodes.push_back(root);
+        parents.push_back(InvalidObject);
+        if (count > 0) {
+            split(0, 0);
+        }
+        std::vector<glm::vec3>().swap(centroids);
+    }
+
+    // splits a leaf by the cheapest of 16 bin boundaries per axis, or keeps it when that is not
+    // cheaper than a leaf (and it is small enough to be one). Recursion goes depth first and stops
+    // at MaxDepth, so the traversal stacks can not overflow.
+    void Bvh::split(unsigned int nodeIndex, unsigned int depth) {
+        Node node = nodes[nodeIndex];
+        unsigned int first = node.first, count = node.count;
+        if (count <= 1 || depth + 2 >= MaxDepth) {
+            for (unsigned int i = first; i < first + count; ++i) {
+                objectLeaf[objects[i]] = nodeIndex;
+            }
+            return;
+        }
+
+        Aabb centroidBounds = Aabb::empty();
+        for (unsigned int i = first; i < first + count; ++i) {
+            centroidBounds.min = glm::min(centroidBounds.min, centroids[objects[i]]);
+            centroidBounds.max = glm::max(centroidBounds.max, centroids[objects[i]]);
+        }
+
+        // cost of testing the objects vs. testing two children and then their objects, in units of
+        // box tests scaled by the chance (surface area) of reaching a node
+        int bestAxis = -1;
+        unsigned int bestBin = 0;
+        float nodeArea = node.bounds.surfaceArea();
+        float bestCost = nodeArea * count;
+        glm::vec3 extent = centroidBounds.extent();
+        for (int axis = 0; axis < 3; ++axis) {
+            if (extent[axis] <= 0.0f) {
+                continue;
+            }
+            Aabb binBounds[detail::bvhBins];
+            unsigned int binCount[detail::bvhBins] = {};
+            for (Aabb& box : binBounds) {
+                box = Aabb::empty();
+            }
+            float scale = detail::bvhBins / extent[axis];
+            for (unsigned int i = first; i < first + count; ++i) {
+                unsigned int object = objects[i];
+                unsigned int bin = std::min((unsigned int)((centroids[object][axis] - centroidBounds.min[axis]) * scale), detail::bvhBins - 1);
+                binBounds[bin].expand(objectBounds[object]);
+                binCount[bin]++;
+            }
+
+            // sweep from the right to get the cost of the right side of every boundary
+            float rightArea[detail::bvhBins];
+            unsigned int rightCount[detail::bvhBins];
+            Aabb right = Aabb::empty();
+            unsigned int rightSum = 0;
+            for (unsigned int b = detail::bvhBins - 1; b > 0; --b) {
+                right.expand(binBounds[b]);
+                rightSum += binCount[b];
+                rightArea[b] = rightSum ? right.surfaceArea() : 0.0f;
+                rightCount[b] = rightSum;
+            }
+            Aabb left = Aabb::empty();
+            unsigned int leftSum = 0;
+            for (unsigned int b = 1; b < detail::bvhBins; ++b) {
+                left.expand(binBounds[b - 1]);
+                leftSum += binCount[b - 1];
+                if (leftSum == 0 || rightCount[b] == 0) {
+                    continue;
+                }
+                float cost = nodeArea + left.surfaceArea() * leftSum + rightArea[b] * rightCount[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        unsigned int middle;
+        if (bestAxis >= 0) {
+            float scale = detail::bvhBins / extent[bestAxis];
+            float minimum = centroidBounds.min[bestAxis];
+            middle = std::partition(objects.begin() + first, objects.begin() + first + count, [&](unsigned int object) {
+                unsigned int bin = std::min((unsigned int)((centroids[object][bestAxis] - minimum) * scale), detail::bvhBins - 1);
+                return bin < bestBin;
+            }) - objects.begin();
+        } else if (count > MaxLeafObjects) {
+            // no useful boundary (e.g. all centroids in one bin) but too many objects for a leaf
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            middle = first + count / 2;
+            std::nth_element(objects.begin() + first, objects.begin() + middle, objects.begin() + first + count,
+                             [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+        } else {
+            for (unsigned int i = first; i < first + count; ++i) {
+                objectLeaf[objects[i]] = nodeIndex;
+            }
+            return;
+        }
+
+        unsigned int leftIndex = nodes.size();
+        Node leftNode, rightNode;
+        leftNode.first = first;
+        leftNode.count = middle - first;
+        leftNode.bounds = leafBounds(leftNode);
+        rightNode.first = middle;
+        rightNode.count = first + count - middle;
+        rightNode.bounds = leafBounds(rightNode);
+        nodes.push_back(leftNode);
+        nodes.push_back(rightNode);
+        parents.push_back(nodeIndex);
+        parents.push_back(nodeIndex);
+        nodes[nodeIndex].first = leftIndex;
+        nodes[nodeIndex].count = 0;
+
+        split(leftIndex, depth + 1);
+        split(leftIndex + 1, depth + 1);
+    }
+
+    Aabb Bvh::leafBounds(const Node& node) const {
+        Aabb box = Aabb::empty();
+        for (unsigned int i = node.first; i < node.first + node.count; ++i) {
+            box.expand(objectBounds[objects[i]]);
+        }
+        return box;
+    }
+
+    void Bvh::update(unsigned int object, const Aabb& bounds) {
+        objectBounds[object] = bounds;
+        unsigned int node = objectLeaf[object];
+        Aabb box = leafBounds(nodes[node]);
+        while (node != InvalidObject) {
+            if (nodes[node].count == 0) {
+                box = nodes[nodes[node].first].bounds;
+                box.expand(nodes[nodes[node].first + 1].bounds);
+            }
+            if (box == nodes[node].bounds) {
+                return;
+            }
+            nodes[node].bounds = box;
+            node = parents[node];
+        }
+    }
+
+    template<typename Visit>
+    void Bvh::visitSubtree(unsigned int node, Visit& visit) const {
+        unsigned int stack[MaxDepth];
+        unsigned int size = 0;
+        stack[size++] = node;
+        while (size > 0) {
+            const Node& current = nodes[stack[--size]];
+            if (current.count > 0) {
+                for (unsigned int i = current.first; i < current.first + current.count; ++i) {
+                    visit(objects[i]);
+                }
+            } else {
+                stack[size++] = current.first;
+                stack[size++] = current.first + 1;
+            }
+        }
+    }
+
+    template<typename Visit>
+    void Bvh::queryFrustum(const Frustum& frustum, Visit visit) const {
+        if (objectBounds.empty()) {
+            return;
+        }
+        unsigned int stack[MaxDepth];
+        unsigned int size = 0;
+        stack[size++] = 0;
+        while (size > 0) {
+            unsigned int index = stack[--size];
+            const Node& node = nodes[index];
+            FrustumTest test = frustum.test(node.bounds);
+            if (test == FrustumTest::Outside) {
+                continue;
+            }
+            if (test == FrustumTest::Inside) {
+                visitSubtree(index, visit);
+            } else if (node.count > 0) {
+                for (unsigned int i = node.first; i < node.first + node.count; ++i) {
+                    if (frustum.test(objectBounds[objects[i]]) != FrustumTest::Outside) {
+                        visit(objects[i]);
+                    }
+                }
+            } else {
+                stack[size++] = node.first;
+                stack[size++] = node.first + 1;
+            }
+        }
+    }
+
+    // children are visited near one first and skipped when their entry is behind the best hit so far
+    unsigned int Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const {
+        unsigned int hit = InvalidObject;
+        if (objectBounds.empty()) {
+            return hit;
+        }
+        glm::vec3 inverseDirection = glm::vec3(1.0f) / direction;
+        float best = maxDistance;
+        unsigned int stack[MaxDepth];
+        unsigned int size = 0;
+        if (detail::rayBoxEntry(nodes[0].bounds, origin, inverseDirection, best) >= 0.0f) {
+            stack[size++] = 0;
+        }
+        while (size > 0) {
+            const Node& node = nodes[stack[--size]];
+            if (node.count > 0) {
+                for (unsigned int i = node.first; i < node.first + node.count; ++i) {
+                    float entry = detail::rayBoxEntry(objectBounds[objects[i]], origin, inverseDirection, best);
+                    if (entry >= 0.0f && (hit == InvalidObject || entry < best)) {
+                        best = entry;
+                        hit = objects[i];
+                    }
+                }
+                continue;
+            }
+            unsigned int a = node.first, b = node.first + 1;
+            float entryA = detail::rayBoxEntry(nodes[a].bounds, origin, inverseDirection, best);
+            float entryB = detail::rayBoxEntry(nodes[b].bounds, origin, inverseDirection, best);
+            if (entryA >= 0.0f && entryB >= 0.0f && entryB < entryA) {
+                std::swap(a, b);
+                std::swap(entryA, entryB);
+            }
+            // the nearer child goes on top of the stack
+            if (entryB >= 0.0f) {
+                stack[size++] = b;
+            }
+            if (entryA >= 0.0f) {
+                stack[size++] = a;
+            }
+        }
+        if (hit != InvalidObject) {
+            distance = best;
+        }
+        return hit;
+    }
+
+    unsigned int Bvh::nearest(const glm::vec3& point, float& distance) const {
+        unsigned int result = InvalidObject;
+        if (objectBounds.empty()) {
+            return result;
+        }
+        float best = 3.0e38f;
+        unsigned int stack[MaxDepth];
+        float stackDistance[MaxDepth];
+        unsigned int size = 0;
+        stack[size] = 0;
+        stackDistance[size++] = detail::pointBoxDistance2(nodes[0].bounds, point);
+        while (size > 0) {
+            --size;
+            if (stackDistance[size] >= best) {
+                continue;
+            }
+            const Node& node = nodes[stack[size]];
+            if (node.count > 0) {
+                for (unsigned int i = node.first; i < node.first + node.count; ++i) {
+                    float d = detail::pointBoxDistance2(objectBounds[objects[i]], point);
+                    if (d < best) {
+                        best = d;
+                        result = objects[i];
+                    }
+                }
+                continue;
+            }
+            unsigned int a = node.first, b = node.first + 1;
+            float da = detail::pointBoxDistance2(nodes[a].bounds, point);
+            float db = detail::pointBoxDistance2(nodes[b].bounds, point);
+            if (db < da) {
+                std::swap(a, b);
+                std::swap(da, db);
+            }
+            if (db < best) {
+                stack[size] = b;
+                stackDistance[size++] = db;
+            }
+            if (da < best) {
+                stack[size] = a;
+                stackDistance[size++] = da;
+            }
+        }
+        if (result != InvalidObject) {
+            distance = std::sqrt(best);
+        }
+        return result;
+    }
+
+};
+#endif //PROJECT_BASE_BVH_H
@@ -0,0 +1,215 @@
+//
+// File reading without stream copies. Small files are read with a single read() into an exactly sized
+// buffer, large ones are mapped. Either way the result is a FileData that callers use in place
+// (glShaderSource with an explicit length, stbi_load_from_memory, ...) through a StringView.
+// Existence checks go through a stat cache, shader search paths are probed once per run.
+//
+
+#ifndef PROJECT_BASE_FILE_H
+#define PROJECT_BASE_FILE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// non-owning characters, the part of C++17's std::string_view the loaders need
+class StringView {
+public:
+    static const size_t npos = (size_t)-1;
+
+    StringView() = default;
+    StringView(const char* data, size_t size) : ptr(data), length(size) {}
+    StringView(const std::string& text) : ptr(text.data()), length(text.size()) {}
+
+    const char* data() const { return ptr; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const char* begin() const { return ptr; }
+    const char* end() const { return ptr + length; }
+    char operator[](size_t i) const { return ptr[i]; }
+
+    StringView substr(size_t pos, size_t count = npos) const {
+        pos = std::min(pos, length);
+        return StringView(ptr + pos, std::min(count, length - pos));
+    }
+
+    size_t find(char c, size_t pos = 0) const {
+        for (size_t i = pos; i < length; ++i) {
+            if (ptr[i] == c) {
+                return i;
+            }
+        }
+        return npos;
+    }
+
+    bool operator==(StringView other) const {
+        return length == other.length && std::memcmp(ptr, other.ptr, length) == 0;
+    }
+
+    std::string str() const {
+        return std::string(ptr, length);
+    }
+
+private:
+    const char* ptr = "";
+    size_t length = 0;
+};
+
+// file contents; storage keeps whatever data points into alive (a read buffer, a mapping, a
+// decompressed archive entry) and is empty when data points into the mounted archive
+struct FileData {
+    const char* data = "";
+    size_t size = 0;
+    std::shared_ptr<const void> storage;
+
+    StringView view() const {
+        return StringView(data, size);
+    }
+
+    std::string str() const {
+        return std::string(data, size);
+    }
+};
+
+struct FileStatus {
+    bool exists = false;
+    bool regular = false;
+    long long modificationTime = -1;
+};
+
+// stat results by path. Files written while running (texture cache, state file) have to be invalidated.
+class StatCache {
+public:
+    FileStatus status(const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(path);
+            if (it != entries.end()) {
+                hits++;
+                return it->second;
+            }
+        }
+        FileStatus result;
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0) {
+            result.exists = true;
+            result.regular = S_ISREG(info.st_mode);
+            result.modificationTime = (long long)info.st_mtime;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        entries[path] = result;
+        misses++;
+        return result;
+    }
+
+    bool isFile(const std::string& path) {
+        return status(path).regular;
+    }
+
+    void invalidate(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.erase(path);
+    }
+
+    unsigned int hitCount() const { return hits; }
+    unsigned int missCount() const { return misses; }
+
+private:
+    std::mutex mutex;
+    std::unordered_map<std::string, FileStatus> entries;
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+};
+
+StatCache statCache;
+
+bool readFile(const std::string& path, FileData& file);
+bool parseFloat(StringView text, size_t& pos, float& value);
+
+namespace detail {
+    // below this a read() into a buffer is cheaper than setting up a mapping and taking its page faults
+    const size_t mapThreshold = 64 * 1024;
+};
+
+    bool readFile(const std::string& path, FileData& file) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+        size_t size = info.st_size;
+
+        if (size >= detail::mapThreshold) {
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                ::close(fd);
+                file.data = (const char*)mapped;
+                file.size = size;
+                file.storage = std::shared_ptr<const void>(mapped, [size](const void* p) {
+                    munmap((void*)p, size);
+                });
+                return true;
+            }
+        }
+
+        // one byte more so small text files stay null terminated
+        auto buffer = std::make_shared<std::vector<char>>(size + 1, '\0');
+        size_t done = 0;
+        while (done < size) {
+            ssize_t count = ::read(fd, buffer->data() + done, size - done);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                break;
+            }
+            done += count;
+        }
+        ::close(fd);
+        if (done != size) {
+            return false;
+        }
+        file.data = buffer->data();
+        file.size = size;
+        file.storage = buffer;
+        return true;
+    }
+
+    // reads the next whitespace separated number starting at pos and moves pos past it
+    bool parseFloat(StringView text, size_t& pos, float& value) {
+        while (pos < text.size() && std::strchr(" \t\r\n", text[pos])) {
+            ++pos;
+        }
+        char token[64];
+        size_t length = 0;
+        while (pos < text.size() && !std::strchr(" \t\r\n", text[pos]) && length + 1 < sizeof(token)) {
+            token[length++] = text[pos++];
+        }
+        token[length] = '\0';
+        char* end = nullptr;
+        float parsed = std::strtof(token, &end);
+        if (length == 0 || end != token + length) {
+            return false;
+        }
+        value = parsed;
+        return true;
+    }
+
+};
+#endif //PROJECT_BASE_FILE_H
@@ -0,0 +1,116 @@
+//
+// View frustum as 6 normalized planes (Gribb & Hartmann), extracted from a projection * view matrix or,
+// with the model matrix multiplied in, directly in an object's own space. Points with
+// dot(plane.xyz, p) + plane.w >= 0 are on the inner side of a plane.
+//
+
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+namespace rg {
+
+struct Aabb {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    Aabb() = default;
+    Aabb(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return max - min; }
+
+    float surfaceArea() const {
+        glm::vec3 e = glm::max(max - min, glm::vec3(0.0f));
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    void expand(const Aabb& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    bool operator==(const Aabb& other) const {
+        return min == other.min && max == other.max;
+    }
+
+    // box around a local space box after transform, without transforming all 8 corners (Arvo)
+    static Aabb transformed(const Aabb& local, const glm::mat4& transform);
+    static Aabb empty();
+};
+
+enum class FrustumTest { Outside, Intersects, Inside };
+
+struct Frustum {
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    static Frustum fromMatrix(const glm::mat4& m);
+    bool sphereVisible(const glm::vec3& center, float radius) const;
+    FrustumTest test(const Aabb& box) const;
+};
+
+    Aabb Aabb::transformed(const Aabb& local, const glm::mat4& transform) {
+        Aabb result;
+        result.min = result.max = glm::vec3(transform[3]);
+        for (int column = 0; column < 3; ++column) {
+            for (int row = 0; row < 3; ++row) {
+                float a = transform[column][row] * local.min[column];
+                float b = transform[column][row] * local.max[column];
+                result.min[row] += a < b ? a : b;
+                result.max[row] += a < b ? b : a;
+            }
+        }
+        return result;
+    }
+
+    Aabb Aabb::empty() {
+        const float big = 3.0e38f;
+        return Aabb(glm::vec3(big), glm::vec3(-big));
+    }
+
+    Frustum Frustum::fromMatrix(const glm::mat4& m) {
+        Frustum frustum;
+        glm::vec4 row[4];
+        for (int r = 0; r < 4; ++r) {
+            row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+        }
+        for (int p = 0; p < 6; ++p) {
+            glm::vec4 plane = (p & 1) ? row[3] - row[p / 2] : row[3] + row[p / 2];
+            float length = glm::length(glm::vec3(plane));
+            frustum.planes[p] = length > 0.0f ? plane / length : plane;
+        }
+        return frustum;
+    }
+
+    bool Frustum::sphereVisible(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the corner furthest along each plane normal decides outside, the nearest one inside
+    FrustumTest Frustum::test(const Aabb& box) const {
+        FrustumTest result = FrustumTest::Inside;
+        for (const glm::vec4& plane : planes) {
+            glm::vec3 far(plane.x >= 0.0f ? box.max.x : box.min.x,
+                          plane.y >= 0.0f ? box.max.y : box.min.y,
+                          plane.z >= 0.0f ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), far) + plane.w < 0.0f) {
+                return FrustumTest::Outside;
+            }
+            glm::vec3 near(plane.x >= 0.0f ? box.min.x : box.max.x,
+                           plane.y >= 0.0f ? box.min.y : box.max.y,
+                           plane.z >= 0.0f ? box.min.z : box.max.z);
+            if (glm::dot(glm::vec3(plane), near) + plane.w < 0.0f) {
+                result = FrustumTest::Intersects;
+            }
+        }
+        return result;
+    }
+
+};
+#endif //PROJECT_BASE_FRUSTUM_H
@@ -0,0 +1,121 @@
+//
+// Entry points and enums above the GL 3.3 core profile that glad was generated for.
+// They are loaded at runtime after gladLoadGLLoader, every user checks the matching flag
+// and falls back to a 3.3 code path when the driver does not provide the feature.
+//
+
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+#include <glad/glad.h>
+#include <cstring>
+#include <iostream>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+#ifndef GL_TEXTURE_IMMUTABLE_FORMAT
+#define GL_TEXTURE_IMMUTABLE_FORMAT 0x912F
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+namespace rg {
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+typedef void (APIENTRYP PFN_glMultiDrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFN_glTexStorage2D)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFN_glBufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+struct GLExtensions {
+    int major = 3;
+    int minor = 3;
+
+    // GL 4.3 / ARB_multi_draw_indirect (baseInstance in the command needs 4.2 / ARB_base_instance)
+    bool multiDrawIndirect = false;
+    PFN_glMultiDrawElementsIndirect MultiDrawElementsIndirect = nullptr;
+
+    // GL 4.2 / ARB_texture_storage, immutable textures allocated with all levels up front
+    bool textureStorage = false;
+    PFN_glTexStorage2D TexStorage2D = nullptr;
+
+    // GL 4.4 / ARB_buffer_storage, immutable buffers that can stay mapped while the GPU reads them
+    bool bufferStorage = false;
+    PFN_glBufferStorage BufferStorage = nullptr;
+
+    // GL 4.3 / ARB_ES3_compatibility, occlusion queries that may answer "passed" without exact rasterization
+    bool anySamplesPassedConservative = false;
+
+    // EXT_texture_compression_s3tc, BC1/BC3 uploads (RGTC is core since 3.0)
+    bool textureCompressionS3TC = false;
+
+    bool hasVersion(int wantMajor, int wantMinor) const {
+        return major > wantMajor || (major == wantMajor && minor >= wantMinor);
+    }
+};
+
+GLExtensions glExt;
+
+bool hasGLExtension(const char* name);
+void loadGLExtensions(GLADloadproc load);
+
+    bool hasGLExtension(const char* name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (extension && std::strcmp(extension, name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void loadGLExtensions(GLADloadproc load) {
+        glGetIntegerv(GL_MAJOR_VERSION, &glExt.major);
+        glGetIntegerv(GL_MINOR_VERSION, &glExt.minor);
+
+        if (glExt.hasVersion(4, 3) ||
+            (hasGLExtension("GL_ARB_multi_draw_indirect") && hasGLExtension("GL_ARB_base_instance"))) {
+            glExt.MultiDrawElementsIndirect = (PFN_glMultiDrawElementsIndirect)load("glMultiDrawElementsIndirect");
+            glExt.multiDrawIndirect = glExt.MultiDrawElementsIndirect != nullptr;
+        }
+
+        if (glExt.hasVersion(4, 2) || hasGLExtension("GL_ARB_texture_storage")) {
+            glExt.TexStorage2D = (PFN_glTexStorage2D)load("glTexStorage2D");
+            glExt.textureStorage = glExt.TexStorage2D != nullptr;
+        }
+
+        if (glExt.hasVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) {
+            glExt.BufferStorage = (PFN_glBufferStorage)load("glBufferStorage");
+            glExt.bufferStorage = glExt.BufferStorage != nullptr;
+        }
+
+        glExt.anySamplesPassedConservative = glExt.hasVersion(4, 3) || hasGLExtension("GL_ARB_ES3_compatibility");
+
+        glExt.textureCompressionS3TC = hasGLExtension("GL_EXT_texture_compression_s3tc");
+
+        std::cout << "OpenGL " << glExt.major << "." << glExt.minor
+                  << ", multi draw indirect: " << (glExt.multiDrawIndirect ? "yes" : "no")
+                  << ", texture storage: " << (glExt.textureStorage ? "yes" : "no")
+                  << ", buffer storage: " << (glExt.bufferStorage ? "yes" : "no")
+                  << ", conservative occlusion queries: " << (glExt.anySamplesPassedConservative ? "yes" : "no")
+                  << ", s3tc: " << (glExt.textureCompressionS3TC ? "yes" : "no") << std::endl;
+    }
+
+};
+#endif //PROJECT_BASE_GLEXTENSIONS_H
@@ -0,0 +1,220 @@
+//
+// Image loading on top of stb_image, files are read through rg::vfs. stb decodes at the file's native
+// channel count without flipping (its own flip and channel conversion are separate passes over the whole
+// image), and the vertical flip and channel expansion happen here in a single pass straight into the
+// caller's memory, e.g. a mapped pixel unpack buffer. The RGB -> RGBA row kernel is picked at runtime
+// (AVX2, SSSE3 or scalar).
+//
+
+#ifndef PROJECT_BASE_IMAGEDECODE_H
+#define PROJECT_BASE_IMAGEDECODE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <rg/VirtualFileSystem.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RG_IMAGE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace rg {
+
+struct ImageInfo {
+    int width = 0;
+    int height = 0;
+    int components = 0; // channels stored in the file, the decoded data has the requested count
+};
+
+void setFlipVerticallyOnLoad(bool flip);
+bool flipVerticallyOnLoad();
+void convertPixels(const unsigned char* src, int srcComponents, unsigned char* dst, int dstComponents,
+                   int width, int height, bool flip);
+bool decodeImage(const std::string& path, int components, std::vector<unsigned char>& pixels, ImageInfo& info);
+GLenum imageFormat(int components);
+bool uploadImageFile(GLenum target, const std::string& path, ImageInfo& info);
+
+namespace detail {
+    bool flipOnLoad = false; // stb_image's own flag stays off, see decodeImageWith
+
+    typedef void (*ExpandRowFn)(const unsigned char* src, unsigned char* dst, int width);
+
+    inline void expandRGBToRGBAScalar(const unsigned char* src, unsigned char* dst, int width) {
+        for (int x = 0; x < width; ++x) {
+            dst[x * 4 + 0] = src[x * 3 + 0];
+            dst[x * 4 + 1] = src[x * 3 + 1];
+            dst[x * 4 + 2] = src[x * 3 + 2];
+            dst[x * 4 + 3] = 255;
+        }
+    }
+
+#ifdef RG_IMAGE_X86_DISPATCH
+    // 4 pixels per step from a 16 byte load of which 12 bytes are used, so the loop stops
+    // early enough never to read past the end of the row
+    __attribute__((target("ssse3")))
+    void expandRGBToRGBASSSE3(const unsigned char* src, unsigned char* dst, int width) {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+        int x = 0;
+        for (; x + 6 <= width; x += 4) {
+            __m128i rgb = _mm_loadu_si128((const __m128i*)(src + x * 3));
+            _mm_storeu_si128((__m128i*)(dst + x * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+        }
+        expandRGBToRGBAScalar(src + x * 3, dst + x * 4, width - x);
+    }
+
+    // same as above with 8 pixels per step, the byte shuffle works per 128 bit lane so each lane
+    // gets its own 12 source bytes
+    __attribute__((target("avx2")))
+    void expandRGBToRGBAAVX2(const unsigned char* src, unsigned char* dst, int width) {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32((int)0xFF000000);
+        int x = 0;
+        for (; x + 10 <= width; x += 8) {
+            __m128i lo = _mm_loadu_si128((const __m128i*)(src + x * 3));
+            __m128i hi = _mm_loadu_si128((const __m128i*)(src + x * 3 + 12));
+            __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256((__m256i*)(dst + x * 4), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+        }
+        expandRGBToRGBAScalar(src + x * 3, dst + x * 4, width - x);
+    }
+#endif
+
+    inline ExpandRowFn selectExpandRGBToRGBA() {
+#ifdef RG_IMAGE_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return expandRGBToRGBAAVX2;
+        }
+        if (__builtin_cpu_supports("ssse3")) {
+            return expandRGBToRGBASSSE3;
+        }
+#endif
+        return expandRGBToRGBAScalar;
+    }
+
+    ExpandRowFn expandRGBToRGBA = selectExpandRGBToRGBA();
+
+    // any other channel combination, same rules as stb_image's own conversion
+    inline void convertRowScalar(const unsigned char* src, int srcComponents, unsigned char* dst, int dstComponents, int width) {
+        for (int x = 0; x < width; ++x, src += srcComponents, dst += dstComponents) {
+            unsigned char rgba[4];
+            if (srcComponents <= 2) {
+                rgba[0] = rgba[1] = rgba[2] = src[0];
+                rgba[3] = srcComponents == 2 ? src[1] : 255;
+            } else {
+                rgba[0] = src[0];
+                rgba[1] = src[1];
+                rgba[2] = src[2];
+                rgba[3] = srcComponents == 4 ? src[3] : 255;
+            }
+            if (dstComponents <= 2) {
+                dst[0] = srcComponents <= 2 ? rgba[0] : (unsigned char)((rgba[0] * 77 + rgba[1] * 150 + rgba[2] * 29) >> 8);
+                if (dstComponents == 2) {
+                    dst[1] = rgba[3];
+                }
+            } else {
+                std::memcpy(dst, rgba, dstComponents);
+            }
+        }
+    }
+
+    // decodes path and converts it into the memory returned by allocate(info, bytes), which may
+    // return nullptr to cancel. Tightly packed rows, flipped when flipVerticallyOnLoad() is set.
+    template<typename Allocate>
+    bool decodeImageWith(const std::string& path, int components, Allocate allocate, ImageInfo& info) {
+        FileData file;
+        if (!vfs.read(path, file)) {
+            return false;
+        }
+        unsigned char* data = stbi_load_from_memory((const stbi_uc*)file.data, (int)file.size,
+                                                    &info.width, &info.height, &info.components, 0);
+        if (!data) {
+            return false;
+        }
+        unsigned char* dst = allocate(info, (size_t)info.width * info.height * components);
+        if (dst) {
+            convertPixels(data, info.components, dst, components, info.width, info.height, flipOnLoad);
+        }
+        stbi_image_free(data);
+        return dst != nullptr;
+    }
+};
+
+    // stb_image's flip flag is global and not thread safe to toggle, so it is never set and the
+    // flip is applied in convertPixels instead
+    void setFlipVerticallyOnLoad(bool flip) {
+        detail::flipOnLoad = flip;
+    }
+
+    bool flipVerticallyOnLoad() {
+        return detail::flipOnLoad;
+    }
+
+    void convertPixels(const unsigned char* src, int srcComponents, unsigned char* dst, int dstComponents,
+                       int width, int height, bool flip) {
+        size_t srcStride = (size_t)width * srcComponents;
+        size_t dstStride = (size_t)width * dstComponents;
+        for (int y = 0; y < height; ++y) {
+            const unsigned char* srcRow = src + (size_t)(flip ? height - 1 - y : y) * srcStride;
+            unsigned char* dstRow = dst + (size_t)y * dstStride;
+            if (srcComponents == dstComponents) {
+                std::memcpy(dstRow, srcRow, dstStride);
+            } else if (srcComponents == 3 && dstComponents == 4) {
+                detail::expandRGBToRGBA(srcRow, dstRow, width);
+            } else {
+                detail::convertRowScalar(srcRow, srcComponents, dstRow, dstComponents, width);
+            }
+        }
+    }
+
+    bool decodeImage(const std::string& path, int components, std::vector<unsigned char>& pixels, ImageInfo& info) {
+        return detail::decodeImageWith(path, components, [&](const ImageInfo&, size_t bytes) {
+            pixels.resize(bytes);
+            return pixels.data();
+        }, info);
+    }
+
+    // unsized format matching the channels of the source file, like the loaders always used
+    GLenum imageFormat(int components) {
+        if (components == 1) {
+            return GL_RED;
+        }
+        return components == 3 ? GL_RGB : GL_RGBA;
+    }
+
+    // decodes straight into a pixel unpack buffer and specifies level 0 of target (the texture has to be
+    // bound) from it. Rows are always expanded to RGBA so the default unpack alignment of 4 holds.
+    bool uploadImageFile(GLenum target, const std::string& path, ImageInfo& info) {
+        unsigned int pixelBuffer;
+        glGenBuffers(1, &pixelBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+
+        bool mapped = false;
+        bool ok = detail::decodeImageWith(path, 4, [&](const ImageInfo&, size_t bytes) {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+            void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            mapped = dst != nullptr;
+            return (unsigned char*)dst;
+        }, info);
+        if (mapped) {
+            // false means the buffer contents were lost while mapped (e.g. a mode switch)
+            ok = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE && ok;
+        }
+        if (ok) {
+            GLenum format = imageFormat(info.components);
+            glTexImage2D(target, 0, format, info.width, info.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pixelBuffer);
+        return ok;
+    }
+
+};
+#endif //PROJECT_BASE_IMAGEDECODE_H
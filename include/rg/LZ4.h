@@ -0,0 +1,193 @@
+//
+// LZ4 block format (no frame header), used for compressed entries of the asset archive.
+// The compressor is the plain greedy single-probe variant, the decompressor validates every
+// length and offset so a corrupted archive fails to read instead of writing out of bounds.
+//
+
+#ifndef PROJECT_BASE_LZ4_H
+#define PROJECT_BASE_LZ4_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace rg {
+
+size_t lz4CompressBound(size_t size);
+size_t lz4Compress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstCapacity);
+bool lz4Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize);
+
+namespace detail {
+    const size_t lz4MinMatch = 4;
+    const size_t lz4LastLiterals = 5;   // the block has to end with at least 5 literals
+    const size_t lz4MatchLimit = 12;    // and the last match has to start 12 bytes before the end
+    const size_t lz4MaxOffset = 65535;
+    const unsigned int lz4HashBits = 12;
+
+    inline uint32_t read32(const unsigned char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t lz4Hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - lz4HashBits);
+    }
+
+    // writes the 255-run continuation of a length that did not fit into its 4 bit token field
+    inline bool lz4WriteLength(size_t length, unsigned char*& op, const unsigned char* end) {
+        for (; length >= 255; length -= 255) {
+            if (op >= end) {
+                return false;
+            }
+            *op++ = 255;
+        }
+        if (op >= end) {
+            return false;
+        }
+        *op++ = (unsigned char)length;
+        return true;
+    }
+
+    inline bool lz4ReadLength(size_t& length, const unsigned char*& ip, const unsigned char* end) {
+        unsigned char byte;
+        do {
+            if (ip >= end) {
+                return false;
+            }
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    // one sequence: token, literal run, and unless it is the last one the match offset and length
+    inline bool lz4WriteSequence(const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength,
+                                 unsigned char*& op, const unsigned char* end) {
+        if (op >= end) {
+            return false;
+        }
+        unsigned char* token = op++;
+        *token = (unsigned char)(std::min<size_t>(literalLength, 15) << 4);
+        if (literalLength >= 15 && !lz4WriteLength(literalLength - 15, op, end)) {
+            return false;
+        }
+        if ((size_t)(end - op) < literalLength) {
+            return false;
+        }
+        std::memcpy(op, literals, literalLength);
+        op += literalLength;
+        if (matchLength == 0) {
+            return true;
+        }
+
+        if (end - op < 2) {
+            return false;
+        }
+        *op++ = (unsigned char)(offset & 0xFF);
+        *op++ = (unsigned char)(offset >> 8);
+        size_t extra = matchLength - lz4MinMatch;
+        *token |= (unsigned char)std::min<size_t>(extra, 15);
+        return extra < 15 || lz4WriteLength(extra - 15, op, end);
+    }
+};
+
+    size_t lz4CompressBound(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    // returns the compressed size, or 0 when dst is too small
+    size_t lz4Compress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstCapacity) {
+        using namespace detail;
+        unsigned char* op = dst;
+        const unsigned char* end = dst + dstCapacity;
+        size_t anchor = 0;
+
+        if (srcSize > lz4MatchLimit) {
+            // positions + 1, so 0 marks an empty slot
+            std::vector<uint32_t> table((size_t)1 << lz4HashBits, 0);
+            size_t matchStartLimit = srcSize - lz4MatchLimit;
+            size_t matchEndLimit = srcSize - lz4LastLiterals;
+            size_t ip = 0;
+            while (ip <= matchStartLimit) {
+                uint32_t sequence = read32(src + ip);
+                uint32_t& slot = table[lz4Hash(sequence)];
+                size_t candidate = slot;
+                slot = (uint32_t)(ip + 1);
+                if (candidate == 0 || ip - (candidate - 1) > lz4MaxOffset || read32(src + candidate - 1) != sequence) {
+                    ++ip;
+                    continue;
+                }
+                size_t ref = candidate - 1;
+                size_t length = lz4MinMatch;
+                while (ip + length < matchEndLimit && src[ref + length] == src[ip + length]) {
+                    ++length;
+                }
+                if (!lz4WriteSequence(src + anchor, ip - anchor, ip - ref, length, op, end)) {
+                    return 0;
+                }
+                ip += length;
+                anchor = ip;
+            }
+        }
+
+        if (!lz4WriteSequence(src + anchor, srcSize - anchor, 0, 0, op, end)) {
+            return 0;
+        }
+        return op - dst;
+    }
+
+    // dstSize is the exact decompressed size, which the archive index stores next to each entry
+    bool lz4Decompress(const unsigned char* src, size_t srcSize, unsigned char* dst, size_t dstSize) {
+        using namespace detail;
+        const unsigned char* ip = src;
+        const unsigned char* srcEnd = src + srcSize;
+        unsigned char* op = dst;
+        unsigned char* dstEnd = dst + dstSize;
+
+        while (ip < srcEnd) {
+            unsigned char token = *ip++;
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !lz4ReadLength(literalLength, ip, srcEnd)) {
+                return false;
+            }
+            if ((size_t)(srcEnd - ip) < literalLength || (size_t)(dstEnd - op) < literalLength) {
+                return false;
+            }
+            std::memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+            if (ip == srcEnd) {
+                break;
+            }
+
+            if (srcEnd - ip < 2) {
+                return false;
+            }
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > (size_t)(op - dst)) {
+                return false;
+            }
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !lz4ReadLength(matchLength, ip, srcEnd)) {
+                return false;
+            }
+            matchLength += lz4MinMatch;
+            if ((size_t)(dstEnd - op) < matchLength) {
+                return false;
+            }
+            // byte by byte, the match may overlap the bytes it produces
+            const unsigned char* match = op - offset;
+            for (size_t i = 0; i < matchLength; ++i) {
+                op[i] = match[i];
+            }
+            op += matchLength;
+        }
+        return op == dstEnd;
+    }
+
+};
+#endif //PROJECT_BASE_LZ4_H
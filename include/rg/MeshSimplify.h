@@ -0,0 +1,339 @@
+//
+// Quadric error metric simplification (Garland & Heckbert) by edge collapse onto existing vertices.
+// The result is a new index list over the original vertex array, so a LOD only costs an index range
+// next to the base mesh and shares its vertex buffer.
+//
+// Vertices are first welded by position so UV/normal splits do not stop the collapses. A position
+// with more than one distinct vertex (a UV or hard normal seam) and non-manifold vertices never move;
+// border vertices only slide along the border, which also carries an extra quadric to keep its shape.
+// Differences in normal and UV between the two ends add to the collapse cost (attributeWeight).
+//
+
+#ifndef PROJECT_BASE_MESHSIMPLIFY_H
+#define PROJECT_BASE_MESHSIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace rg {
+
+// interleaved vertex data, offsets in bytes
+struct SimplifyInput {
+    const unsigned char* vertices = nullptr;
+    size_t vertexCount = 0;
+    size_t stride = 0;
+    size_t positionOffset = 0;
+    size_t normalOffset = 0;
+    size_t texCoordOffset = 0;
+};
+
+struct SimplifySettings {
+    float maxError = 0.05f;         // relative to the bounding box diagonal, no collapse above it is made
+    float attributeWeight = 0.01f;  // cost per squared normal + UV difference, relative to the squared diagonal
+};
+
+float simplifyMesh(const SimplifyInput& input, const std::vector<unsigned int>& indices, size_t targetIndexCount,
+                   const SimplifySettings& settings, std::vector<unsigned int>& result);
+
+namespace detail {
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        double b0 = 0, b1 = 0, b2 = 0, c = 0;
+        double weight = 0;
+
+        // plane n.x + d = 0 with unit normal n
+        void addPlane(const glm::dvec3& n, double d, double w) {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+            b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        Quadric& operator+=(const Quadric& q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+            weight += q.weight;
+            return *this;
+        }
+
+        // weighted sum of squared distances to the planes
+        double error(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            return a00 * x * x + a11 * y * y + a22 * z * z + 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                 + 2 * (b0 * x + b1 * y + b2 * z) + c;
+        }
+    };
+
+    enum class SimplifyVertexKind : unsigned char {
+        Simple,     // one distinct vertex, interior
+        Border,     // one distinct vertex on an open edge, moves only along it
+        Locked      // seam or non-manifold, never moves
+    };
+
+    inline uint64_t edgeKey(unsigned int a, unsigned int b) {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    // hash of raw float bits, used for exact welding
+    struct FloatBitsHash {
+        size_t operator()(const std::vector<uint32_t>& key) const {
+            size_t h = 0;
+            for (uint32_t v : key) {
+                h = h * 31 + v * 2654435761u;
+            }
+            return h;
+        }
+    };
+
+    struct CollapseCandidate {
+        unsigned int from;      // vertex (wedge) that disappears
+        unsigned int to;
+        double cost;            // geometric + attribute
+        double geometricError;  // mean squared distance to the merged planes
+    };
+};
+
+    // returns the geometric error of the result (root mean square distance to the source planes, the
+    // attribute term only orders the collapses) in object space units. Stops early when the error
+    // limit is reached before the target count.
+    float simplifyMesh(const SimplifyInput& input, const std::vector<unsigned int>& indices, size_t targetIndexCount,
+                       const SimplifySettings& settings, std::vector<unsigned int>& result) {
+        using namespace detail;
+        size_t vertexCount = input.vertexCount;
+        std::vector<glm::vec3> positions(vertexCount), normals(vertexCount);
+        std::vector<glm::vec2> texCoords(vertexCount);
+        glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            const unsigned char* vertex = input.vertices + i * input.stride;
+            std::memcpy(&positions[i], vertex + input.positionOffset, sizeof(glm::vec3));
+            std::memcpy(&normals[i], vertex + input.normalOffset, sizeof(glm::vec3));
+            std::memcpy(&texCoords[i], vertex + input.texCoordOffset, sizeof(glm::vec2));
+            boundsMin = glm::min(boundsMin, positions[i]);
+            boundsMax = glm::max(boundsMax, positions[i]);
+        }
+        double diagonal2 = vertexCount ? glm::dot(boundsMax - boundsMin, boundsMax - boundsMin) : 0.0;
+
+        // wedge = first vertex with identical position, normal and uv; position = first vertex with the same position
+        std::vector<unsigned int> wedgeOf(vertexCount), positionOf(vertexCount);
+        {
+            std::unordered_map<std::vector<uint32_t>, unsigned int, FloatBitsHash> wedges, welded;
+            wedges.reserve(vertexCount);
+            welded.reserve(vertexCount);
+            std::vector<uint32_t> key(8);
+            for (size_t i = 0; i < vertexCount; ++i) {
+                std::memcpy(&key[0], &positions[i], sizeof(glm::vec3));
+                std::memcpy(&key[3], &normals[i], sizeof(glm::vec3));
+                std::memcpy(&key[6], &texCoords[i], sizeof(glm::vec2));
+                wedgeOf[i] = wedges.emplace(key, (unsigned int)i).first->second;
+                key.resize(3);
+                positionOf[i] = welded.emplace(key, (unsigned int)i).first->second;
+                key.resize(8);
+            }
+        }
+
+        std::vector<SimplifyVertexKind> kind(vertexCount, SimplifyVertexKind::Simple);
+        {
+            std::vector<unsigned int> firstWedge(vertexCount, ~0u);
+            for (size_t i = 0; i < vertexCount; ++i) {
+                unsigned int p = positionOf[i];
+                if (firstWedge[p] == ~0u) {
+                    firstWedge[p] = wedgeOf[i];
+                } else if (firstWedge[p] != wedgeOf[i]) {
+                    kind[p] = SimplifyVertexKind::Locked;
+                }
+            }
+        }
+
+        // triangles as wedge triplets, degenerate ones dropped
+        std::vector<unsigned int> triangles;
+        triangles.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            unsigned int a = wedgeOf[indices[i]], b = wedgeOf[indices[i + 1]], c = wedgeOf[indices[i + 2]];
+            if (positionOf[a] != positionOf[b] && positionOf[b] != positionOf[c] && positionOf[a] != positionOf[c]) {
+                triangles.insert(triangles.end(), { a, b, c });
+            }
+        }
+
+        // plane quadrics per welded position, area weighted
+        std::vector<Quadric> quadrics(vertexCount);
+        std::unordered_map<uint64_t, unsigned int> edgeUse;
+        edgeUse.reserve(triangles.size());
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            unsigned int p[3] = { positionOf[triangles[t]], positionOf[triangles[t + 1]], positionOf[triangles[t + 2]] };
+            glm::dvec3 p0(positions[p[0]]), p1(positions[p[1]]), p2(positions[p[2]]);
+            glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+            double length = glm::length(n);
+            if (length > 0) {
+                n /= length;
+                for (unsigned int k = 0; k < 3; ++k) {
+                    quadrics[p[k]].addPlane(n, -glm::dot(n, p0), length * 0.5);
+                }
+            }
+            for (unsigned int k = 0; k < 3; ++k) {
+                edgeUse[edgeKey(p[k], p[(k + 1) % 3])]++;
+            }
+        }
+        // open edges get a plane through the edge perpendicular to the face, weighted heavily
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            unsigned int p[3] = { positionOf[triangles[t]], positionOf[triangles[t + 1]], positionOf[triangles[t + 2]] };
+            glm::dvec3 faceNormal = glm::cross(glm::dvec3(positions[p[1]] - positions[p[0]]), glm::dvec3(positions[p[2]] - positions[p[0]]));
+            for (unsigned int k = 0; k < 3; ++k) {
+                unsigned int a = p[k], b = p[(k + 1) % 3];
+                unsigned int uses = edgeUse[edgeKey(a, b)];
+                if (uses == 1) {
+                    glm::dvec3 edge = glm::dvec3(positions[b]) - glm::dvec3(positions[a]);
+                    glm::dvec3 n = glm::cross(edge, faceNormal);
+                    double length = glm::length(n);
+                    if (length > 0) {
+                        n /= length;
+                        double w = glm::dot(edge, edge) * 10.0;
+                        quadrics[a].addPlane(n, -glm::dot(n, glm::dvec3(positions[a])), w);
+                        quadrics[b].addPlane(n, -glm::dot(n, glm::dvec3(positions[a])), w);
+                    }
+                    for (unsigned int v : { a, b }) {
+                        if (kind[v] == SimplifyVertexKind::Simple) {
+                            kind[v] = SimplifyVertexKind::Border;
+                        }
+                    }
+                } else if (uses > 2) {
+                    kind[a] = kind[b] = SimplifyVertexKind::Locked;
+                }
+            }
+        }
+
+        double errorLimit = (double)settings.maxError * settings.maxError * diagonal2;
+        double attributeScale = settings.attributeWeight * diagonal2;
+        double worstError = 0.0;
+        std::vector<unsigned int> remap(vertexCount);
+        std::vector<unsigned char> touched(vertexCount);
+        std::vector<unsigned int> adjacencyStart(vertexCount + 1), adjacency;
+
+        while (triangles.size() > targetIndexCount) {
+            // current open edges and triangles around every position
+            edgeUse.clear();
+            std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+            for (size_t t = 0; t < triangles.size(); t += 3) {
+                for (unsigned int k = 0; k < 3; ++k) {
+                    edgeUse[edgeKey(positionOf[triangles[t + k]], positionOf[triangles[t + (k + 1) % 3]])]++;
+                    adjacencyStart[positionOf[triangles[t + k]] + 1]++;
+                }
+            }
+            for (size_t i = 0; i < vertexCount; ++i) {
+                adjacencyStart[i + 1] += adjacencyStart[i];
+            }
+            adjacency.resize(triangles.size());
+            {
+                std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+                for (size_t t = 0; t < triangles.size(); t += 3) {
+                    for (unsigned int k = 0; k < 3; ++k) {
+                        adjacency[fill[positionOf[triangles[t + k]]]++] = (unsigned int)(t / 3);
+                    }
+                }
+            }
+
+            std::vector<CollapseCandidate> candidates;
+            candidates.reserve(triangles.size() * 2);
+            for (size_t t = 0; t < triangles.size(); t += 3) {
+                for (unsigned int k = 0; k < 3; ++k) {
+                    unsigned int wa = triangles[t + k], wb = triangles[t + (k + 1) % 3];
+                    for (unsigned int dir = 0; dir < 2; ++dir) {
+                        unsigned int from = dir ? wb : wa, to = dir ? wa : wb;
+                        unsigned int pf = positionOf[from], pt = positionOf[to];
+                        unsigned int uses = edgeUse[edgeKey(pf, pt)];
+                        if (kind[pf] == SimplifyVertexKind::Locked || uses > 2
+                            || (kind[pf] == SimplifyVertexKind::Border && uses != 1)) {
+                            continue;
+                        }
+                        Quadric q = quadrics[pf];
+                        q += quadrics[pt];
+                        double error = std::max(0.0, q.error(positions[pt]) / std::max(q.weight, 1e-20));
+                        glm::vec3 dn = normals[from] - normals[to];
+                        glm::vec2 duv = texCoords[from] - texCoords[to];
+                        double cost = error + attributeScale * (glm::dot(dn, dn) + glm::dot(duv, duv));
+                        candidates.push_back({ from, to, cost, error });
+                    }
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const CollapseCandidate& a, const CollapseCandidate& b) {
+                return a.cost < b.cost;
+            });
+
+            for (size_t i = 0; i < vertexCount; ++i) {
+                remap[i] = (unsigned int)i;
+            }
+            std::fill(touched.begin(), touched.end(), 0);
+            size_t remaining = triangles.size();
+            unsigned int collapses = 0;
+            for (const CollapseCandidate& candidate : candidates) {
+                if (remaining <= targetIndexCount || candidate.cost > errorLimit) {
+                    break;
+                }
+                unsigned int pf = positionOf[candidate.from], pt = positionOf[candidate.to];
+                if (touched[pf] || touched[pt]) {
+                    continue;
+                }
+
+                // reject collapses that flip a triangle around the moving vertex
+                bool flips = false;
+                unsigned int removed = 0;
+                for (unsigned int a = adjacencyStart[pf]; a < adjacencyStart[pf + 1] && !flips; ++a) {
+                    const unsigned int* tri = &triangles[adjacency[a] * 3];
+                    unsigned int p[3] = { positionOf[tri[0]], positionOf[tri[1]], positionOf[tri[2]] };
+                    if (p[0] == pt || p[1] == pt || p[2] == pt) {
+                        removed += 3;
+                        continue;
+                    }
+                    glm::vec3 before = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+                    glm::vec3 moved[3];
+                    for (unsigned int k = 0; k < 3; ++k) {
+                        moved[k] = positions[p[k] == pf ? pt : p[k]];
+                    }
+                    glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                    flips = glm::dot(before, after) <= 0.0f;
+                }
+                if (flips) {
+                    continue;
+                }
+
+                // the neighbourhood is frozen for the rest of the pass, its triangles are stale until rebuilt
+                for (unsigned int a = adjacencyStart[pf]; a < adjacencyStart[pf + 1]; ++a) {
+                    const unsigned int* tri = &triangles[adjacency[a] * 3];
+                    for (unsigned int k = 0; k < 3; ++k) {
+                        touched[positionOf[tri[k]]] = 1;
+                    }
+                }
+                remap[candidate.from] = candidate.to;
+                quadrics[pt] += quadrics[pf];
+                remaining -= removed;
+                worstError = std::max(worstError, candidate.geometricError);
+                collapses++;
+            }
+            if (collapses == 0) {
+                break;
+            }
+
+            size_t write = 0;
+            for (size_t t = 0; t < triangles.size(); t += 3) {
+                unsigned int a = remap[triangles[t]], b = remap[triangles[t + 1]], c = remap[triangles[t + 2]];
+                if (positionOf[a] != positionOf[b] && positionOf[b] != positionOf[c] && positionOf[a] != positionOf[c]) {
+                    triangles[write++] = a;
+                    triangles[write++] = b;
+                    triangles[write++] = c;
+                }
+            }
+            triangles.resize(write);
+        }
+
+        result = triangles;
+        return (float)std::sqrt(worstError);
+    }
+
+};
+#endif //PROJECT_BASE_MESHSIMPLIFY_H
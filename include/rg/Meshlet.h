@@ -0,0 +1,379 @@
+//
+// Splits a mesh into meshlets (small clusters of at most 64 vertices / 124 triangles) and culls them on the
+// CPU. The triangles of every meshlet are made contiguous in the mesh's own index list, so a visible meshlet
+// is just an index range and runs of visible meshlets can be drawn with one command.
+//
+// Each meshlet keeps a bounding sphere and a normal cone: if every triangle of the meshlet faces away from
+// the camera the whole meshlet can be skipped. Culling happens in the mesh's object space (frustum planes
+// taken from projection * view * model, the camera moved by the inverse model matrix), so the bounds never
+// have to be transformed. The culling loop tests 4 meshlets at a time with SSE.
+//
+
+#ifndef PROJECT_BASE_MESHLET_H
+#define PROJECT_BASE_MESHLET_H
+
+#include <glm/glm.hpp>
+#include <rg/Frustum.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define RG_MESHLET_SSE
+#include <emmintrin.h>
+#endif
+
+namespace rg {
+
+struct MeshletSettings {
+    unsigned int maxVertices = 64;
+    unsigned int maxTriangles = 124;
+};
+
+struct Meshlet {
+    unsigned int firstIndex = 0;   // into the mesh's index list
+    unsigned int indexCount = 0;
+    unsigned int vertexCount = 0;  // distinct positions, meshes are imported without joining identical vertices
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    glm::vec3 coneAxis = glm::vec3(0.0f);
+    float coneCutoff = 1.0f;       // sine of the cone's spread, 1 for meshlets that can always be seen from some side
+};
+
+// meshlet bounds as separate arrays, padded to a multiple of 4 with meshlets that are never visible
+struct MeshletCullData {
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> axisX, axisY, axisZ, cutoff;
+    unsigned int count = 0;
+
+    void assign(const std::vector<Meshlet>& meshlets);
+    size_t heapBytes() const;
+};
+
+// everything the culling loop needs, already moved into the mesh's object space
+struct MeshletView {
+    Frustum frustum;
+    glm::vec3 camera = glm::vec3(0.0f);
+    bool backfaceCulling = true;
+
+    // viewProjection * model gives object space planes; a mirroring model matrix turns the cone test off
+    // since it flips which side of a triangle is the front
+    static MeshletView fromModel(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition,
+                                 bool backfaceCulling);
+};
+
+// reorders the triangles of indices[firstIndex, firstIndex + indexCount) so every meshlet is contiguous and
+// appends the meshlets. positions is interleaved vertex data with the given stride.
+void buildMeshlets(const unsigned char* positions, size_t vertexCount, size_t stride, std::vector<unsigned int>& indices,
+                   unsigned int firstIndex, unsigned int indexCount, const MeshletSettings& settings,
+                   std::vector<Meshlet>& meshlets);
+
+// writes 1 for visible and 0 for culled meshlets in [begin, end) to visible[begin, end), begin a multiple of 4
+void cullMeshlets(const MeshletCullData& data, unsigned int begin, unsigned int end, const MeshletView& view,
+                  unsigned char* visible);
+
+namespace detail {
+    inline glm::vec3 meshletPosition(const unsigned char* positions, size_t stride, unsigned int index) {
+        glm::vec3 p;
+        std::memcpy(&p, positions + index * stride, sizeof(glm::vec3));
+        return p;
+    }
+
+    // first vertex with the same position for every vertex, so triangles of unindexed meshes are still neighbours
+    inline std::vector<unsigned int> weldPositions(const unsigned char* positions, size_t vertexCount, size_t stride) {
+        struct Key {
+            uint32_t bits[3];
+            bool operator==(const Key& o) const {
+                return bits[0] == o.bits[0] && bits[1] == o.bits[1] && bits[2] == o.bits[2];
+            }
+        };
+        struct KeyHash {
+            size_t operator()(const Key& k) const {
+                return (k.bits[0] * 73856093u) ^ (k.bits[1] * 19349663u) ^ (k.bits[2] * 83492791u);
+            }
+        };
+        std::unordered_map<Key, unsigned int, KeyHash> lookup;
+        lookup.reserve(vertexCount);
+        std::vector<unsigned int> remap(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            Key key;
+            std::memcpy(key.bits, positions + v * stride, sizeof(key.bits));
+            remap[v] = lookup.emplace(key, (unsigned int)v).first->second;
+        }
+        return remap;
+    }
+
+    // sphere around the box of the meshlet's vertices and a cone around the average face normal
+    inline void computeMeshletBounds(const unsigned char* positions, size_t stride, const unsigned int* indices,
+                                     Meshlet& meshlet) {
+        glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+        for (unsigned int i = 0; i < meshlet.indexCount; ++i) {
+            glm::vec3 p = meshletPosition(positions, stride, indices[i]);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        meshlet.center = (lo + hi) * 0.5f;
+        float radius2 = 0.0f;
+        for (unsigned int i = 0; i < meshlet.indexCount; ++i) {
+            glm::vec3 d = meshletPosition(positions, stride, indices[i]) - meshlet.center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        meshlet.radius = std::sqrt(radius2);
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.indexCount / 3);
+        glm::vec3 sum(0.0f);
+        for (unsigned int i = 0; i + 2 < meshlet.indexCount; i += 3) {
+            glm::vec3 a = meshletPosition(positions, stride, indices[i]);
+            glm::vec3 n = glm::cross(meshletPosition(positions, stride, indices[i + 1]) - a,
+                                     meshletPosition(positions, stride, indices[i + 2]) - a);
+            float length = glm::length(n);
+            if (length > 0.0f) {
+                normals.push_back(n / length);
+                sum += n / length;
+            }
+        }
+        meshlet.coneAxis = glm::vec3(0.0f);
+        meshlet.coneCutoff = 1.0f;
+        float sumLength = glm::length(sum);
+        if (normals.empty() || sumLength < 1e-6f) {
+            return;
+        }
+        glm::vec3 axis = sum / sumLength;
+        float minDot = 1.0f;
+        for (const glm::vec3& n : normals) {
+            minDot = std::min(minDot, glm::dot(axis, n));
+        }
+        // wider than a half space, some triangle faces every direction
+        if (minDot <= 0.0f) {
+            return;
+        }
+        meshlet.coneAxis = axis;
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    inline void cullMeshletsScalar(const MeshletCullData& data, unsigned int begin, unsigned int end,
+                                   const MeshletView& view, unsigned char* visible) {
+        for (unsigned int i = begin; i < end; ++i) {
+            glm::vec3 center(data.centerX[i], data.centerY[i], data.centerZ[i]);
+            bool inside = view.frustum.sphereVisible(center, data.radius[i]);
+            if (inside && view.backfaceCulling) {
+                glm::vec3 toCenter = center - view.camera;
+                glm::vec3 axis(data.axisX[i], data.axisY[i], data.axisZ[i]);
+                inside = glm::dot(toCenter, axis) < data.cutoff[i] * glm::length(toCenter) + data.radius[i];
+            }
+            visible[i] = inside ? 1 : 0;
+        }
+    }
+
+#ifdef RG_MESHLET_SSE
+    inline __m128 dot3(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+    }
+
+    inline void cullMeshletsSSE(const MeshletCullData& data, unsigned int begin, unsigned int end,
+                                const MeshletView& view, unsigned char* visible) {
+        unsigned int i = begin;
+        for (; i + 4 <= end; i += 4) {
+            __m128 cx = _mm_loadu_ps(&data.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&data.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&data.centerZ[i]);
+            __m128 r = _mm_loadu_ps(&data.radius[i]);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), r);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p) {
+                const glm::vec4& plane = view.frustum.planes[p];
+                __m128 distance = _mm_add_ps(dot3(cx, cy, cz, _mm_set1_ps(plane.x), _mm_set1_ps(plane.y), _mm_set1_ps(plane.z)),
+                                             _mm_set1_ps(plane.w));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negR));
+            }
+
+            if (view.backfaceCulling) {
+                __m128 tx = _mm_sub_ps(cx, _mm_set1_ps(view.camera.x));
+                __m128 ty = _mm_sub_ps(cy, _mm_set1_ps(view.camera.y));
+                __m128 tz = _mm_sub_ps(cz, _mm_set1_ps(view.camera.z));
+                __m128 length = _mm_sqrt_ps(dot3(tx, ty, tz, tx, ty, tz));
+                __m128 along = dot3(tx, ty, tz, _mm_loadu_ps(&data.axisX[i]), _mm_loadu_ps(&data.axisY[i]),
+                                    _mm_loadu_ps(&data.axisZ[i]));
+                __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&data.cutoff[i]), length), r);
+                inside = _mm_and_ps(inside, _mm_cmplt_ps(along, limit));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            visible[i + 0] = mask & 1;
+            visible[i + 1] = (mask >> 1) & 1;
+            visible[i + 2] = (mask >> 2) & 1;
+            visible[i + 3] = (mask >> 3) & 1;
+        }
+        cullMeshletsScalar(data, i, end, view, visible);
+    }
+#endif
+};
+
+    void MeshletCullData::assign(const std::vector<Meshlet>& meshlets) {
+        count = meshlets.size();
+        size_t padded = (meshlets.size() + 3) & ~size_t(3);
+        // padding: a sphere of negative radius fails every plane test
+        for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &axisX, &axisY, &axisZ, &cutoff }) {
+            array->assign(padded, 0.0f);
+        }
+        radius.assign(padded, -1.0f);
+        for (size_t i = 0; i < meshlets.size(); ++i) {
+            centerX[i] = meshlets[i].center.x;
+            centerY[i] = meshlets[i].center.y;
+            centerZ[i] = meshlets[i].center.z;
+            radius[i] = meshlets[i].radius;
+            axisX[i] = meshlets[i].coneAxis.x;
+            axisY[i] = meshlets[i].coneAxis.y;
+            axisZ[i] = meshlets[i].coneAxis.z;
+            cutoff[i] = meshlets[i].coneCutoff;
+        }
+    }
+
+    size_t MeshletCullData::heapBytes() const {
+        return 8 * centerX.capacity() * sizeof(float);
+    }
+
+    MeshletView MeshletView::fromModel(const glm::mat4& viewProjection, const glm::mat4& model,
+                                       const glm::vec3& cameraPosition, bool backfaceCulling) {
+        MeshletView view;
+        view.frustum = Frustum::fromMatrix(viewProjection * model);
+        view.camera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPosition, 1.0f));
+        view.backfaceCulling = backfaceCulling && glm::determinant(glm::mat3(model)) > 0.0f;
+        return view;
+    }
+
+    // greedy growth: the next triangle is the unused one next to the meshlet that adds the fewest new
+    // vertices (ties go to the one closest to the meshlet's centroid). A meshlet is closed when it is full
+    // or nothing touches it anymore, and the next one starts at the first unused triangle.
+    void buildMeshlets(const unsigned char* positions, size_t vertexCount, size_t stride, std::vector<unsigned int>& indices,
+                       unsigned int firstIndex, unsigned int indexCount, const MeshletSettings& settings,
+                       std::vector<Meshlet>& meshlets) {
+        unsigned int triangleCount = indexCount / 3;
+        const unsigned int* original = indices.data() + firstIndex;
+
+        // adjacency and the vertex limit work on welded positions
+        std::vector<unsigned int> remap = detail::weldPositions(positions, vertexCount, stride);
+        std::vector<unsigned int> welded(triangleCount * 3);
+        for (unsigned int i = 0; i < triangleCount * 3; ++i) {
+            welded[i] = remap[original[i]];
+        }
+        const unsigned int* source = welded.data();
+
+        // triangles around every vertex
+        std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+        for (unsigned int i = 0; i < triangleCount * 3; ++i) {
+            adjacencyOffset[source[i] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; ++v) {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        std::vector<unsigned int> adjacency(triangleCount * 3);
+        std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (unsigned int t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                adjacency[fill[source[t * 3 + k]]++] = t;
+            }
+        }
+
+        std::vector<glm::vec3> triangleCenter(triangleCount);
+        for (unsigned int t = 0; t < triangleCount; ++t) {
+            triangleCenter[t] = (detail::meshletPosition(positions, stride, source[t * 3])
+                               + detail::meshletPosition(positions, stride, source[t * 3 + 1])
+                               + detail::meshletPosition(positions, stride, source[t * 3 + 2])) / 3.0f;
+        }
+
+        std::vector<unsigned int> ordered;
+        ordered.reserve(triangleCount * 3);
+        std::vector<bool> used(triangleCount, false);
+        std::vector<unsigned int> vertexMeshlet(vertexCount, ~0u); // meshlet a vertex was last added to
+        std::vector<unsigned int> meshletVertices;
+        unsigned int seed = 0;
+        unsigned int meshletId = 0;
+
+        while (true) {
+            while (seed < triangleCount && used[seed]) {
+                ++seed;
+            }
+            if (seed == triangleCount) {
+                break;
+            }
+
+            Meshlet meshlet;
+            meshlet.firstIndex = firstIndex + ordered.size();
+            meshletVertices.clear();
+            glm::vec3 centroidSum(0.0f);
+            unsigned int triangles = 0;
+            unsigned int next = seed;
+
+            while (next != ~0u) {
+                used[next] = true;
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int v = source[next * 3 + k];
+                    ordered.push_back(original[next * 3 + k]);
+                    if (vertexMeshlet[v] != meshletId) {
+                        vertexMeshlet[v] = meshletId;
+                        meshletVertices.push_back(v);
+                    }
+                }
+                centroidSum += triangleCenter[next];
+                ++triangles;
+                if (triangles == settings.maxTriangles) {
+                    break;
+                }
+
+                glm::vec3 centroid = centroidSum / (float)triangles;
+                next = ~0u;
+                int bestNew = 4;
+                float bestDistance = 0.0f;
+                for (unsigned int v : meshletVertices) {
+                    for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a) {
+                        unsigned int t = adjacency[a];
+                        if (used[t]) {
+                            continue;
+                        }
+                        int added = 0;
+                        for (int k = 0; k < 3; ++k) {
+                            added += vertexMeshlet[source[t * 3 + k]] != meshletId;
+                        }
+                        if (meshletVertices.size() + added > settings.maxVertices) {
+                            continue;
+                        }
+                        glm::vec3 d = triangleCenter[t] - centroid;
+                        float distance = glm::dot(d, d);
+                        if (added < bestNew || (added == bestNew && distance < bestDistance)) {
+                            next = t;
+                            bestNew = added;
+                            bestDistance = distance;
+                        }
+                    }
+                }
+            }
+
+            meshlet.indexCount = firstIndex + ordered.size() - meshlet.firstIndex;
+            meshlet.vertexCount = meshletVertices.size();
+            detail::computeMeshletBounds(positions, stride, ordered.data() + (meshlet.firstIndex - firstIndex), meshlet);
+            meshlets.push_back(meshlet);
+            ++meshletId;
+        }
+
+        std::copy(ordered.begin(), ordered.end(), indices.begin() + firstIndex);
+    }
+
+    void cullMeshlets(const MeshletCullData& data, unsigned int begin, unsigned int end, const MeshletView& view,
+                      unsigned char* visible) {
+#ifdef RG_MESHLET_SSE
+        detail::cullMeshletsSSE(data, begin, end, view, visible);
+#else
+        detail::cullMeshletsScalar(data, begin, end, view, visible);
+#endif
+    }
+
+};
+#endif //PROJECT_BASE_MESHLET_H
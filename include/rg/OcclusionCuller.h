@@ -0,0 +1,344 @@
+//
+// Software occlusion culling. A few large occluder meshes are rasterized on the CPU into a small depth
+// buffer, a hierarchical-Z pyramid (every texel the farthest depth of the 2x2 below it) is built on top,
+// and objects are tested by the screen rectangle and nearest depth of their world space box before they
+// are submitted.
+//
+// The depth buffer is split into horizontal bands that are rasterized on separate threads, every band
+// walks all triangles touching it so no two threads write the same row. Vertices are transformed and
+// rows are filled 4 pixels at a time with SSE. Triangles crossing the near plane are skipped, that only
+// makes the buffer emptier. Pixels count as covered when their center is, so box tests look one pixel
+// past the box to make up for occluder edges that were rounded outwards.
+//
+
+#ifndef PROJECT_BASE_OCCLUSIONCULLER_H
+#define PROJECT_BASE_OCCLUSIONCULLER_H
+
+#include <glm/glm.hpp>
+#include <rg/Frustum.h>
+#include <rg/Parallel.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define RG_OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+namespace rg {
+
+// occluder geometry in object space, usually a mesh's collision proxy or a hand made low poly shape
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+};
+
+struct OcclusionStats {
+    unsigned int occluderTriangles = 0;  // rasterized this frame
+    unsigned int tested = 0;
+    unsigned int rejected = 0;
+    double rasterMilliseconds = 0.0;     // transform + raster + pyramid
+};
+
+class OcclusionCuller {
+public:
+    static const int BandHeight = 16;
+
+    // width is rounded up to a multiple of 4 for the SIMD row loop
+    OcclusionCuller(int width, int height);
+
+    // clears the depth buffer and the occluders of the last frame
+    void beginFrame(const glm::mat4& viewProjection);
+    // the mesh has to stay alive until rasterize()
+    void addOccluder(const OccluderMesh& mesh, const glm::mat4& transform);
+    void rasterize();
+
+    // false only if the whole box is behind the occluders; boxes crossing the near plane or the
+    // screen edges count as visible, frustum culling is a separate step
+    bool isVisible(const Aabb& worldBounds);
+
+    const OcclusionStats& stats() const { return frameStats; }
+    int width() const { return bufferWidth; }
+    int height() const { return bufferHeight; }
+    // depth in [0, 1] of a level 0 texel, for debugging
+    float depth(int x, int y) const { return levels[0].depth[y * levels[0].width + x]; }
+
+private:
+    struct Occluder {
+        const OccluderMesh* mesh;
+        glm::mat4 transform;
+    };
+    struct ScreenTriangle {
+        glm::vec3 v[3];          // pixel x, pixel y, depth in [0, 1]
+        int minX, maxX, minY, maxY;
+    };
+    struct Level {
+        int width = 0, height = 0;
+        std::vector<float> depth;
+    };
+
+    int bufferWidth, bufferHeight;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<Occluder> occluders;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<glm::vec4> clip;  // scratch for transformed vertices
+    std::vector<Level> levels;
+    OcclusionStats frameStats;
+
+    void setupTriangles();
+    void rasterizeBand(int band);
+    void buildPyramid();
+};
+
+namespace detail {
+    // row y of a triangle, pixels [x0, x1] with x0 a multiple of 4 and the row padded to a multiple of 4
+    inline void rasterizeRowScalar(const float* e0, const float* e1, const float* e2, const float* z,
+                                   float px, int x0, int x1, float* row) {
+        for (int x = x0; x <= x1; ++x, px += 1.0f) {
+            float a = e0[0] + e0[1] * px, b = e1[0] + e1[1] * px, c = e2[0] + e2[1] * px;
+            if (a >= 0.0f && b >= 0.0f && c >= 0.0f) {
+                row[x] = std::min(row[x], z[0] + z[1] * px);
+            }
+        }
+    }
+
+#ifdef RG_OCCLUSION_SSE
+    inline void rasterizeRowSSE(const float* e0, const float* e1, const float* e2, const float* z,
+                                float px, int x0, int x1, float* row) {
+        const __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        __m128 step = _mm_set1_ps(4.0f);
+        __m128 x = _mm_add_ps(_mm_set1_ps(px), offsets);
+        __m128 zero = _mm_setzero_ps();
+        __m128 a0 = _mm_set1_ps(e0[0]), a1 = _mm_set1_ps(e0[1]);
+        __m128 b0 = _mm_set1_ps(e1[0]), b1 = _mm_set1_ps(e1[1]);
+        __m128 c0 = _mm_set1_ps(e2[0]), c1 = _mm_set1_ps(e2[1]);
+        __m128 z0 = _mm_set1_ps(z[0]), z1 = _mm_set1_ps(z[1]);
+        __m128i lastPixel = _mm_set1_epi32(x1);
+        __m128i pixel = _mm_add_epi32(_mm_set1_epi32(x0), _mm_setr_epi32(0, 1, 2, 3));
+        for (int i = x0; i <= x1; i += 4) {
+            __m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(a0, _mm_mul_ps(a1, x)), zero),
+                            _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(b0, _mm_mul_ps(b1, x)), zero),
+                                       _mm_cmpge_ps(_mm_add_ps(c0, _mm_mul_ps(c1, x)), zero)));
+            inside = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(pixel, lastPixel)), inside);
+            __m128 old = _mm_loadu_ps(row + i);
+            __m128 nearer = _mm_min_ps(old, _mm_add_ps(z0, _mm_mul_ps(z1, x)));
+            _mm_storeu_ps(row + i, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            x = _mm_add_ps(x, step);
+            pixel = _mm_add_epi32(pixel, _mm_set1_epi32(4));
+        }
+    }
+#endif
+};
+
+    OcclusionCuller::OcclusionCuller(int width, int height)
+        : bufferWidth((std::max(width, 4) + 3) & ~3), bufferHeight(std::max(height, 1)) {
+        int w = bufferWidth, h = bufferHeight;
+        while (true) {
+            Level level;
+            level.width = w;
+            level.height = h;
+            // the SIMD loop reads and writes whole groups of 4 at level 0
+            level.depth.assign((size_t)((w + 3) & ~3) * h, 1.0f);
+            levels.push_back(std::move(level));
+            if (w == 1 && h == 1) {
+                break;
+            }
+            w = std::max(1, (w + 1) / 2);
+            h = std::max(1, (h + 1) / 2);
+        }
+    }
+
+    void OcclusionCuller::beginFrame(const glm::mat4& viewProjection) {
+        this->viewProjection = viewProjection;
+        occluders.clear();
+        frameStats = OcclusionStats();
+    }
+
+    void OcclusionCuller::addOccluder(const OccluderMesh& mesh, const glm::mat4& transform) {
+        Occluder occluder;
+        occluder.mesh = &mesh;
+        occluder.transform = transform;
+        occluders.push_back(occluder);
+    }
+
+    void OcclusionCuller::rasterize() {
+        auto start = std::chrono::steady_clock::now();
+        std::fill(levels[0].depth.begin(), levels[0].depth.end(), 1.0f);
+        setupTriangles();
+        int bands = (bufferHeight + BandHeight - 1) / BandHeight;
+        rg::parallelFor(bands, [this](unsigned int band) {
+            rasterizeBand(band);
+        });
+        buildPyramid();
+        frameStats.occluderTriangles = triangles.size();
+        frameStats.rasterMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // clip space transform of every vertex, then triangle setup in pixel coordinates
+    void OcclusionCuller::setupTriangles() {
+        triangles.clear();
+        for (const Occluder& occluder : occluders) {
+            const OccluderMesh& mesh = *occluder.mesh;
+            glm::mat4 m = viewProjection * occluder.transform;
+            clip.resize(mesh.positions.size());
+#ifdef RG_OCCLUSION_SSE
+            __m128 c0 = _mm_loadu_ps(&m[0][0]), c1 = _mm_loadu_ps(&m[1][0]);
+            __m128 c2 = _mm_loadu_ps(&m[2][0]), c3 = _mm_loadu_ps(&m[3][0]);
+            for (size_t i = 0; i < mesh.positions.size(); ++i) {
+                const glm::vec3& p = mesh.positions[i];
+                __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y))),
+                                      _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3));
+                _mm_storeu_ps(&clip[i][0], r);
+            }
+#else
+            for (size_t i = 0; i < mesh.positions.size(); ++i) {
+                clip[i] = m * glm::vec4(mesh.positions[i], 1.0f);
+            }
+#endif
+            for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+                ScreenTriangle triangle;
+                bool skip = false;
+                for (int k = 0; k < 3; ++k) {
+                    const glm::vec4& c = clip[mesh.indices[t + k]];
+                    if (c.w <= 1e-4f || c.z < -c.w) {
+                        skip = true;
+                        break;
+                    }
+                    float inverseW = 1.0f / c.w;
+                    triangle.v[k] = glm::vec3((c.x * inverseW * 0.5f + 0.5f) * bufferWidth,
+                                              (c.y * inverseW * 0.5f + 0.5f) * bufferHeight,
+                                              std::min(c.z * inverseW * 0.5f + 0.5f, 1.0f));
+                }
+                if (skip) {
+                    continue;
+                }
+                float minX = std::min(triangle.v[0].x, std::min(triangle.v[1].x, triangle.v[2].x));
+                float maxX = std::max(triangle.v[0].x, std::max(triangle.v[1].x, triangle.v[2].x));
+                float minY = std::min(triangle.v[0].y, std::min(triangle.v[1].y, triangle.v[2].y));
+                float maxY = std::max(triangle.v[0].y, std::max(triangle.v[1].y, triangle.v[2].y));
+                // pixel centers inside the box
+                triangle.minX = std::max(0, (int)std::ceil(minX - 0.5f));
+                triangle.maxX = std::min(bufferWidth - 1, (int)std::floor(maxX - 0.5f));
+                triangle.minY = std::max(0, (int)std::ceil(minY - 0.5f));
+                triangle.maxY = std::min(bufferHeight - 1, (int)std::floor(maxY - 0.5f));
+                if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+                    continue;
+                }
+                triangles.push_back(triangle);
+            }
+        }
+    }
+
+    void OcclusionCuller::rasterizeBand(int band) {
+        int bandMin = band * BandHeight;
+        int bandMax = std::min(bufferHeight, bandMin + BandHeight) - 1;
+        Level& level = levels[0];
+        for (const ScreenTriangle& t : triangles) {
+            if (t.maxY < bandMin || t.minY > bandMax) {
+                continue;
+            }
+            const glm::vec3& v0 = t.v[0];
+            const glm::vec3& v1 = t.v[1];
+            const glm::vec3& v2 = t.v[2];
+            float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+            if (std::fabs(area) < 1e-8f) {
+                continue;
+            }
+            // both windings are drawn (the umbrella is seen from above and below), edges point inwards
+            float sign = area > 0.0f ? 1.0f : -1.0f;
+            const glm::vec3* v[3] = { &v0, &v1, &v2 };
+            float edgeA[3], edgeB[3], edgeC[3]; // e = A * x + B * y + C
+            for (int k = 0; k < 3; ++k) {
+                const glm::vec3& a = *v[k];
+                const glm::vec3& b = *v[(k + 1) % 3];
+                edgeA[k] = -(b.y - a.y) * sign;
+                edgeB[k] = (b.x - a.x) * sign;
+                edgeC[k] = ((b.y - a.y) * a.x - (b.x - a.x) * a.y) * sign;
+            }
+            // depth plane z = zA * x + zB * y + zC
+            float zA = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+            float zB = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+            float zC = v0.z - zA * v0.x - zB * v0.y;
+
+            int x0 = t.minX & ~3;
+            for (int y = std::max(t.minY, bandMin); y <= std::min(t.maxY, bandMax); ++y) {
+                float py = y + 0.5f;
+                float e0[2] = { edgeB[0] * py + edgeC[0], edgeA[0] };
+                float e1[2] = { edgeB[1] * py + edgeC[1], edgeA[1] };
+                float e2[2] = { edgeB[2] * py + edgeC[2], edgeA[2] };
+                float z[2] = { zB * py + zC, zA };
+                float* row = level.depth.data() + (size_t)y * level.width;
+#ifdef RG_OCCLUSION_SSE
+                detail::rasterizeRowSSE(e0, e1, e2, z, x0 + 0.5f, x0, t.maxX, row);
+#else
+                detail::rasterizeRowScalar(e0, e1, e2, z, x0 + 0.5f, x0, t.maxX, row);
+#endif
+            }
+        }
+    }
+
+    void OcclusionCuller::buildPyramid() {
+        for (size_t l = 1; l < levels.size(); ++l) {
+            const Level& below = levels[l - 1];
+            Level& level = levels[l];
+            for (int y = 0; y < level.height; ++y) {
+                int y0 = std::min(2 * y, below.height - 1), y1 = std::min(2 * y + 1, below.height - 1);
+                for (int x = 0; x < level.width; ++x) {
+                    int x0 = std::min(2 * x, below.width - 1), x1 = std::min(2 * x + 1, below.width - 1);
+                    level.depth[y * level.width + x] = std::max(
+                            std::max(below.depth[y0 * below.width + x0], below.depth[y0 * below.width + x1]),
+                            std::max(below.depth[y1 * below.width + x0], below.depth[y1 * below.width + x1]));
+                }
+            }
+        }
+    }
+
+    bool OcclusionCuller::isVisible(const Aabb& worldBounds) {
+        frameStats.tested++;
+        float minX = 3.0e38f, minY = 3.0e38f, maxX = -3.0e38f, maxY = -3.0e38f, nearest = 1.0f;
+        for (int corner = 0; corner < 8; ++corner) {
+            glm::vec3 p((corner & 1) ? worldBounds.max.x : worldBounds.min.x,
+                        (corner & 2) ? worldBounds.max.y : worldBounds.min.y,
+                        (corner & 4) ? worldBounds.max.z : worldBounds.min.z);
+            glm::vec4 c = viewProjection * glm::vec4(p, 1.0f);
+            if (c.w <= 1e-4f || c.z < -c.w) {
+                return true;
+            }
+            float x = (c.x / c.w * 0.5f + 0.5f) * bufferWidth;
+            float y = (c.y / c.w * 0.5f + 0.5f) * bufferHeight;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::min(nearest, c.z / c.w * 0.5f + 0.5f);
+        }
+
+        // one pixel of margin, see the top of the file
+        int x0 = std::max(0, (int)std::floor(minX) - 1), x1 = std::min(bufferWidth - 1, (int)std::floor(maxX) + 1);
+        int y0 = std::max(0, (int)std::floor(minY) - 1), y1 = std::min(bufferHeight - 1, (int)std::floor(maxY) + 1);
+        if (x0 > x1 || y0 > y1) {
+            return true;
+        }
+        // coarsest level at which the rectangle still covers at most 4x4 texels
+        size_t l = 0;
+        while (l + 1 < levels.size() && ((x1 >> l) - (x0 >> l) > 3 || (y1 >> l) - (y0 >> l) > 3)) {
+            ++l;
+        }
+        const Level& level = levels[l];
+        for (int y = y0 >> l; y <= (y1 >> l); ++y) {
+            for (int x = x0 >> l; x <= (x1 >> l); ++x) {
+                if (level.depth[y * level.width + x] >= nearest) {
+                    return true;
+                }
+            }
+        }
+        frameStats.rejected++;
+        return false;
+    }
+
+};
+#endif //PROJECT_BASE_OCCLUSIONCULLER_H
@@ -0,0 +1,58 @@
+//
+// Minimal fork/join helper for CPU side work (texture encoding, image decoding, culling).
+//
+
+#ifndef PROJECT_BASE_PARALLEL_H
+#define PROJECT_BASE_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace rg {
+
+    inline unsigned int workerCount() {
+        unsigned int count = std::thread::hardware_concurrency();
+        return count == 0 ? 1 : count;
+    }
+
+    // calls fn(i) for every i in [0, count), items are handed out in chunks from a shared counter
+    // so uneven work still balances. Runs inline when there is too little work to pay for threads.
+    template<typename Fn>
+    void parallelFor(unsigned int count, Fn fn, unsigned int chunk = 1) {
+        unsigned int threads = std::min(workerCount(), (count + chunk - 1) / std::max(chunk, 1u));
+        if (threads <= 1) {
+            for (unsigned int i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::atomic<unsigned int> next(0);
+        auto worker = [&]() {
+            for (;;) {
+                unsigned int begin = next.fetch_add(chunk);
+                if (begin >= count) {
+                    return;
+                }
+                unsigned int end = std::min(begin + chunk, count);
+                for (unsigned int i = begin; i < end; ++i) {
+                    fn(i);
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (unsigned int t = 0; t + 1 < threads; ++t) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+    }
+
+};
+#endif //PROJECT_BASE_PARALLEL_H
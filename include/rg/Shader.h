@@ -8,8 +8,6 @@
 #include <string>
 #include <glad/glad.h>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <rg/Error.h>
 #include <common.h>
 #include <glm/glm.hpp>
@@ -22,11 +20,13 @@ public:
         // build and compile our shader program
         // ------------------------------------
         // vertex shader
-        std::string vsString = readFileContents(vertexShaderPath);
-        ASSERT(!vsString.empty(), "Vertex shader source is empty!");
-        const char* vertexShaderSource = vsString.c_str();
+        rg::FileData vsFile;
+        rg::vfs.read(vertexShaderPath, vsFile);
+        ASSERT(vsFile.size != 0, "Vertex shader source is empty!");
+        const char* vertexShaderSource = vsFile.data;
+        GLint vertexShaderLength = vsFile.size;
         int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+        glShaderSource(vertexShader, 1, &vertexShaderSource, &vertexShaderLength);
         glCompileShader(vertexShader);
         // check for shader compile errors
         int success;
@@ -39,10 +39,12 @@ public:
         }
         // fragment shader
         int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        std::string fsString = readFileContents(fragmentShaderPath);
-        ASSERT(!fsString.empty(), "Fragment shader empty!");
-        const char* fragmentShaderSource = fsString.c_str();
-        glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+        rg::FileData fsFile;
+        rg::vfs.read(fragmentShaderPath, fsFile);
+        ASSERT(fsFile.size != 0, "Fragment shader empty!");
+        const char* fragmentShaderSource = fsFile.data;
+        GLint fragmentShaderLength = fsFile.size;
+        glShaderSource(fragmentShader, 1, &fragmentShaderSource, &fragmentShaderLength);
         glCompileShader(fragmentShader);
         // check for shader compile errors
         glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
@@ -0,0 +1,228 @@
+//
+// Loads textures as precompressed BCn images with a full mip chain. The first run decodes the source
+// image, encodes it with rg/BlockCompression.h and stores the result as a KTX (version 1) file under
+// resources/cache; later runs read the KTX file and upload it with glCompressedTexImage2D directly.
+//
+
+#ifndef PROJECT_BASE_TEXTURECACHE_H
+#define PROJECT_BASE_TEXTURECACHE_H
+
+#include <glad/glad.h>
+#include <learnopengl/filesystem.h>
+#include <rg/BlockCompression.h>
+#include <rg/GLExtensions.h>
+#include <rg/ImageDecode.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+
+namespace rg {
+
+// decides the block format, the cache keeps one file per usage so the same image can be stored twice
+enum class TextureUsage {
+    Color,          // BC1, or BC3 when the image has an alpha channel that is not fully opaque
+    SingleChannel,  // BC4 of the red channel, e.g. specular masks sampled as .x
+    NormalMap       // BC5 of red and green, the shader has to reconstruct z
+};
+
+struct CompressedTexture {
+    unsigned int id = 0;    // 0 when the texture could not be loaded or compressed
+    BlockFormat format = BlockFormat::BC1;
+    unsigned int levels = 0;
+};
+
+std::string textureCachePath(const std::string& source, TextureUsage usage);
+bool writeKTX(const std::string& path, const CompressedImage& image);
+bool readKTX(const std::string& path, CompressedImage& image);
+unsigned int uploadCompressedImage(GLenum target, const CompressedImage& image);
+bool compressTextureFile(const std::string& path, TextureUsage usage, CompressedImage& image);
+bool loadCompressedImage(const std::string& path, TextureUsage usage, CompressedImage& image);
+CompressedTexture loadCompressedTexture(const std::string& path, TextureUsage usage = TextureUsage::Color);
+
+namespace detail {
+    const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct KtxHeader {
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    inline bool formatFromGL(uint32_t internalFormat, BlockFormat& format) {
+        for (BlockFormat candidate : { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5 }) {
+            if (glInternalFormat(candidate) == internalFormat) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline long long modificationTime(const std::string& path) {
+        return statCache.status(path).modificationTime;
+    }
+};
+
+    std::string textureCachePath(const std::string& source, TextureUsage usage) {
+        std::string name;
+        for (char c : source) {
+            name += (c == '/' || c == '\\' || c == ':') ? '_' : c;
+        }
+        static const char* usageNames[] = { "color", "mask", "normal" };
+        name += std::string("-") + usageNames[(int)usage] + (flipVerticallyOnLoad() ? "-flip" : "") + ".ktx";
+        return FileSystem::getPath("resources/cache/") + name;
+    }
+
+    bool writeKTX(const std::string& path, const CompressedImage& image) {
+        std::string directory = path.substr(0, path.find_last_of('/'));
+        mkdir(directory.c_str(), 0755);
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        detail::KtxHeader header = {};
+        header.endianness = 0x04030201;
+        header.glTypeSize = 1;
+        header.glInternalFormat = glInternalFormat(image.format);
+        header.glBaseInternalFormat = glBaseFormat(image.format);
+        header.pixelWidth = image.levels[0].width;
+        header.pixelHeight = image.levels[0].height;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = image.levels.size();
+
+        bool ok = fwrite(detail::ktxIdentifier, sizeof(detail::ktxIdentifier), 1, file) == 1
+               && fwrite(&header, sizeof(header), 1, file) == 1;
+        for (const CompressedLevel& level : image.levels) {
+            // block data is a multiple of 8 bytes, so the 4 byte mip padding of KTX is never needed
+            uint32_t imageSize = level.data.size();
+            ok = ok && fwrite(&imageSize, sizeof(imageSize), 1, file) == 1
+                    && fwrite(level.data.data(), 1, imageSize, file) == imageSize;
+        }
+        fclose(file);
+        if (!ok) {
+            remove(path.c_str());
+        }
+        statCache.invalidate(path);
+        return ok;
+    }
+
+    bool readKTX(const std::string& path, CompressedImage& image) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            return false;
+        }
+        unsigned char identifier[12];
+        detail::KtxHeader header = {};
+        bool ok = fread(identifier, sizeof(identifier), 1, file) == 1
+               && std::memcmp(identifier, detail::ktxIdentifier, sizeof(identifier)) == 0
+               && fread(&header, sizeof(header), 1, file) == 1
+               && header.endianness == 0x04030201
+               && header.numberOfFaces == 1
+               && detail::formatFromGL(header.glInternalFormat, image.format)
+               && fseek(file, header.bytesOfKeyValueData, SEEK_CUR) == 0;
+
+        image.levels.clear();
+        int width = header.pixelWidth, height = header.pixelHeight;
+        for (uint32_t i = 0; ok && i < header.numberOfMipmapLevels; ++i) {
+            uint32_t imageSize = 0;
+            ok = fread(&imageSize, sizeof(imageSize), 1, file) == 1;
+            image.levels.emplace_back();
+            CompressedLevel& level = image.levels.back();
+            level.width = width;
+            level.height = height;
+            level.data.resize(imageSize);
+            ok = ok && fread(level.data.data(), 1, imageSize, file) == imageSize;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        fclose(file);
+        return ok && !image.levels.empty();
+    }
+
+    // uploads every level to target (GL_TEXTURE_2D or a cube map face), the texture has to be bound
+    unsigned int uploadCompressedImage(GLenum target, const CompressedImage& image) {
+        GLenum internalFormat = glInternalFormat(image.format);
+        for (unsigned int i = 0; i < image.levels.size(); ++i) {
+            const CompressedLevel& level = image.levels[i];
+            glCompressedTexImage2D(target, i, internalFormat, level.width, level.height, 0, level.data.size(), level.data.data());
+        }
+        return image.levels.size();
+    }
+
+    // decodes the source image and encodes it with a full mip chain
+    bool compressTextureFile(const std::string& path, TextureUsage usage, CompressedImage& image) {
+        ImageInfo info;
+        std::vector<unsigned char> pixels;
+        if (!decodeImage(path, 4, pixels, info)) {
+            return false;
+        }
+        const unsigned char* data = pixels.data();
+        BlockFormat format = BlockFormat::BC1;
+        if (usage == TextureUsage::SingleChannel) {
+            format = BlockFormat::BC4;
+        } else if (usage == TextureUsage::NormalMap) {
+            format = BlockFormat::BC5;
+        } else if (info.components == 4) {
+            for (size_t i = 0; i < (size_t)info.width * info.height; ++i) {
+                if (data[i * 4 + 3] != 255) {
+                    format = BlockFormat::BC3;
+                    break;
+                }
+            }
+        }
+        image = compressImage(data, info.width, info.height, format, true);
+        return true;
+    }
+
+    // the cached KTX file if it is newer than the source, otherwise compresses the source and caches it.
+    // Doesn't touch GL, so it can run on worker threads
+    bool loadCompressedImage(const std::string& path, TextureUsage usage, CompressedImage& image) {
+        std::string cachePath = textureCachePath(path, usage);
+        if (detail::modificationTime(cachePath) >= detail::modificationTime(path) && readKTX(cachePath, image)) {
+            return true;
+        }
+        if (!compressTextureFile(path, usage, image)) {
+            return false;
+        }
+        if (!writeKTX(cachePath, image)) {
+            std::cout << "TEXTURE_CACHE:: could not write " << cachePath << std::endl;
+        }
+        return true;
+    }
+
+    // returns the texture bound to GL_TEXTURE_2D with all mip levels uploaded; wrap and filter
+    // parameters are left to the caller like with the uncompressed loaders
+    CompressedTexture loadCompressedTexture(const std::string& path, TextureUsage usage) {
+        CompressedTexture texture;
+        if (usage == TextureUsage::Color && !glExt.textureCompressionS3TC) {
+            return texture;
+        }
+        CompressedImage image;
+        if (!loadCompressedImage(path, usage, image)) {
+            return texture;
+        }
+        glGenTextures(1, &texture.id);
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        texture.levels = uploadCompressedImage(GL_TEXTURE_2D, image);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+        texture.format = image.format;
+        return texture;
+    }
+
+};
+#endif //PROJECT_BASE_TEXTURECACHE_H
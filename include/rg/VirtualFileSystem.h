@@ -0,0 +1,141 @@
+//
+// Read only view of the project's resources. With a mounted archive (see rg/Archive.h) every lookup
+// is a binary search in the mapped index and uncompressed entries are returned without copying;
+// paths that are not in the archive, or every path when there is none, are read from disk with
+// rg::readFile. Paths are matched relative to the project root, so FileSystem::getPath results and paths
+// relative to the working directory both work.
+//
+
+#ifndef PROJECT_BASE_VIRTUALFILESYSTEM_H
+#define PROJECT_BASE_VIRTUALFILESYSTEM_H
+
+#include <learnopengl/filesystem.h>
+#include <rg/Archive.h>
+#include <rg/File.h>
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rg {
+
+std::string normalizePath(const std::string& path);
+
+class VirtualFileSystem {
+public:
+    // the archive has to stay valid until unmount, the index is checked once here
+    bool mount(const std::string& archivePath) {
+        root = normalizePath(FileSystem::getPath(""));
+        if (!archive.open(archivePath)) {
+            std::cout << "VFS:: no archive at " << archivePath << ", reading loose files" << std::endl;
+            return false;
+        }
+        std::cout << "VFS:: mounted " << archivePath << " (" << archive.size() << " entries)" << std::endl;
+        return true;
+    }
+
+    void unmount() {
+        archive.close();
+    }
+
+    bool isMounted() const {
+        return archive.isOpen();
+    }
+
+    // archive-relative name of a path, e.g. /home/x/project/resources/a/../b.png -> resources/b.png
+    std::string key(const std::string& path) const {
+        std::string normalized = normalizePath(path);
+        if (!root.empty() && normalized.compare(0, root.size(), root) == 0 && normalized.size() > root.size()
+            && normalized[root.size()] == '/') {
+            return normalized.substr(root.size() + 1);
+        }
+        return normalized;
+    }
+
+    bool exists(const std::string& path) const {
+        if (archive.isOpen() && archive.find(key(path))) {
+            return true;
+        }
+        return statCache.isFile(path);
+    }
+
+    // safe to call from several threads, the archive is only read and the counters are atomic
+    bool read(const std::string& path, FileData& file) const {
+        if (archive.isOpen()) {
+            const archive::Entry* entry = archive.find(key(path));
+            if (entry) {
+                archiveReads++;
+                if ((archive::Compression)entry->compression == archive::Compression::None) {
+                    file.data = (const char*)archive.storedData(*entry);
+                    file.size = entry->size;
+                    file.storage.reset();
+                    return true;
+                }
+                auto storage = std::make_shared<std::vector<char>>(entry->size + 1, '\0');
+                if (!archive.extract(*entry, (unsigned char*)storage->data())) {
+                    std::cout << "VFS:: corrupted archive entry " << path << std::endl;
+                    return false;
+                }
+                decompressedBytes += entry->size;
+                file.data = storage->data();
+                file.size = entry->size;
+                file.storage = storage;
+                return true;
+            }
+        }
+
+        if (!readFile(path, file)) {
+            return false;
+        }
+        looseReads++;
+        return true;
+    }
+
+    void printStats() const {
+        std::cout << "VFS:: " << archiveReads << " archive reads (" << decompressedBytes / 1024 << " KiB decompressed), "
+                  << looseReads << " loose file reads, stat cache " << statCache.hitCount() << " hits / "
+                  << statCache.missCount() << " misses" << std::endl;
+    }
+
+private:
+    Archive archive;
+    std::string root;
+    mutable std::atomic<unsigned int> archiveReads{0};
+    mutable std::atomic<unsigned int> looseReads{0};
+    mutable std::atomic<unsigned long long> decompressedBytes{0};
+};
+
+VirtualFileSystem vfs;
+
+    // collapses '.', '..', repeated and back slashes; keeps a leading '/'
+    std::string normalizePath(const std::string& path) {
+        std::vector<std::string> parts;
+        std::string part;
+        for (size_t i = 0; i <= path.size(); ++i) {
+            if (i < path.size() && path[i] != '/' && path[i] != '\\') {
+                part += path[i];
+                continue;
+            }
+            if (part == "..") {
+                if (!parts.empty() && parts.back() != "..") {
+                    parts.pop_back();
+                } else {
+                    parts.push_back(part);
+                }
+            } else if (!part.empty() && part != ".") {
+                parts.push_back(part);
+            }
+            part.clear();
+        }
+
+        std::string result = !path.empty() && path[0] == '/' ? "/" : "";
+        for (size_t i = 0; i < parts.size(); ++i) {
+            result += (i ? "/" : "") + parts[i];
+        }
+        return result;
+    }
+
+};
+#endif //PROJECT_BASE_VIRTUALFILESYSTEM_H
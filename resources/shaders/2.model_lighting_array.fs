@@ -0,0 +1,107 @@
+#version 330 core
+out vec4 FragColor;
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+
+    float cutOff;
+    float outerCutOff;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+};
+
+// x = diffuse layer, y = specular layer (-1 if the material has none), z = shininess
+layout (std140) uniform Materials {
+    vec4 materials[256];
+};
+uniform sampler2DArray materialTextures;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+flat in int MaterialIndex;
+
+// written once per frame into the stream buffer, see LightingBlock in main.cpp
+layout (std140) uniform Lighting {
+    PointLight pointLight;
+    PointLight pointLight1;
+    SpotLight spotLight;
+    vec3 viewPosition;
+};
+uniform sampler2D ambientOcclusion; // screen space, white without it
+float occlusion;
+
+// the layers are fetched once in main and shared by all lights
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMask, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * albedo * occlusion;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMask;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMask, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+
+    float attenuation = 1.0;
+
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+    vec3 ambient = light.ambient * albedo * occlusion;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMask;
+    return (ambient + diffuse + specular) * attenuation * intensity;
+}
+
+void main()
+{
+    occlusion = texelFetch(ambientOcclusion, min(ivec2(gl_FragCoord.xy), textureSize(ambientOcclusion, 0) - 1), 0).r;
+    vec4 material = materials[MaterialIndex];
+    vec3 albedo = material.x >= 0.0 ? texture(materialTextures, vec3(TexCoords, material.x)).rgb : vec3(1.0);
+    float specularMask = material.y >= 0.0 ? texture(materialTextures, vec3(TexCoords, material.y)).r : 0.0;
+
+    vec3 normal = normalize(Normal);
+    vec3 viewDir = normalize(viewPosition - FragPos);
+    vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir, albedo, specularMask, material.z);
+    result += CalcPointLight(pointLight1, normal, FragPos, viewDir, albedo, specularMask, material.z);
+    result += CalcSpotLight(spotLight, normal, FragPos, viewDir, albedo, specularMask, material.z);
+    FragColor = vec4(result, 1.0);
+}
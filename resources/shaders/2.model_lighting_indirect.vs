@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aDrawId;
+
+invariant gl_Position; // matches depth_prepass_indirect.vs for the GL_EQUAL pass
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+flat out int MaterialIndex;
+
+// per draw: 4 texels of model matrix columns, then (materialIndex, 0, 0, 0)
+uniform samplerBuffer drawData;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    int base = int(aDrawId) * 5;
+    mat4 model = mat4(texelFetch(drawData, base),
+                      texelFetch(drawData, base + 1),
+                      texelFetch(drawData, base + 2),
+                      texelFetch(drawData, base + 3));
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+    MaterialIndex = int(texelFetch(drawData, base + 4).x);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 6) in mat4 aInstanceModel; // locations 6-9, see setupInstanceAttributes
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 FragPos;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// 2.model_lighting.vs with the model matrix per instance (Model::DrawInstanced)
+void main()
+{
+    FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+    // the copies are rotated differently, so the normal has to follow (the scale is uniform)
+    Normal = mat3(aInstanceModel) * aNormal;
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
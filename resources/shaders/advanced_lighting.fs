@@ -11,12 +11,14 @@ uniform sampler2D floorTexture;
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 uniform bool blinn;
+uniform sampler2D ambientOcclusion; // screen space, white without it
 
 void main()
 {
     vec3 color = texture(floorTexture, fs_in.TexCoords).rgb;
     // ambient
-    vec3 ambient = 0.05 * color;
+    float occlusion = texelFetch(ambientOcclusion, min(ivec2(gl_FragCoord.xy), textureSize(ambientOcclusion, 0) - 1), 0).r;
+    vec3 ambient = 0.05 * color * occlusion;
     // diffuse
     vec3 lightDir = normalize(lightPos - fs_in.FragPos);
     vec3 normal = normalize(fs_in.Normal);
@@ -3,6 +3,8 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
+invariant gl_Position; // matches depth_prepass.vs for the GL_EQUAL pass
+
 // declare an interface block; see 'Advanced GLSL' for what these are.
 out VS_OUT {
     vec3 FragPos;
@@ -10,13 +12,15 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
+uniform mat4 model;
 uniform mat4 projection;
 uniform mat4 view;
 
 void main()
 {
-    vs_out.FragPos = aPos;
-    vs_out.Normal = aNormal;
+    // the same expression as depth_prepass.vs, invariant only holds for identical computations
+    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vs_out.Normal = mat3(model) * aNormal;
     vs_out.TexCoords = aTexCoords;
-    gl_Position = projection * view * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 uvScale;   // part of the source that was rendered to
+uniform bool prefilter; // first level, from the scene
+uniform float threshold;
+uniform float knee;
+
+// dual Kawase downsample: the centre and four diagonal taps one source texel away, each a bilinear
+// average of four texels, so a 4x4 footprint in five fetches
+vec3 fetch(vec2 uv, vec2 minUv, vec2 maxUv)
+{
+    return texture(source, clamp(uv, minUv, maxUv)).rgb;
+}
+
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(source, 0));
+    vec2 minUv = 0.5 * texelSize, maxUv = uvScale - 0.5 * texelSize;
+    vec2 uv = TexCoords * uvScale;
+
+    vec3 color = fetch(uv, minUv, maxUv) * 4.0;
+    color += fetch(uv + vec2(-texelSize.x, -texelSize.y), minUv, maxUv);
+    color += fetch(uv + vec2( texelSize.x, -texelSize.y), minUv, maxUv);
+    color += fetch(uv + vec2(-texelSize.x,  texelSize.y), minUv, maxUv);
+    color += fetch(uv + vec2( texelSize.x,  texelSize.y), minUv, maxUv);
+    color /= 8.0;
+
+    if (prefilter) {
+        // soft knee threshold on the brightest channel
+        float brightness = max(color.r, max(color.g, color.b));
+        float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+        soft = soft * soft / (4.0 * knee + 1e-4);
+        color *= max(soft, brightness - threshold) / max(brightness, 1e-4);
+    }
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source;
+uniform vec2 uvScale; // part of the source that was rendered to
+
+// dual Kawase upsample: four taps on the axes one source texel away and four diagonal ones half a texel
+// away with twice the weight, a tent over the smaller level. Added to the level above by blending.
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(source, 0));
+    vec2 minUv = 0.5 * texelSize, maxUv = uvScale - 0.5 * texelSize;
+    vec2 uv = TexCoords * uvScale;
+    vec2 h = 0.5 * texelSize;
+
+    vec3 color = texture(source, clamp(uv + vec2(-2.0 * h.x, 0.0), minUv, maxUv)).rgb;
+    color += texture(source, clamp(uv + vec2( 2.0 * h.x, 0.0), minUv, maxUv)).rgb;
+    color += texture(source, clamp(uv + vec2(0.0, -2.0 * h.y), minUv, maxUv)).rgb;
+    color += texture(source, clamp(uv + vec2(0.0,  2.0 * h.y), minUv, maxUv)).rgb;
+    color += texture(source, clamp(uv + vec2(-h.x, -h.y), minUv, maxUv)).rgb * 2.0;
+    color += texture(source, clamp(uv + vec2( h.x, -h.y), minUv, maxUv)).rgb * 2.0;
+    color += texture(source, clamp(uv + vec2(-h.x,  h.y), minUv, maxUv)).rgb * 2.0;
+    color += texture(source, clamp(uv + vec2( h.x,  h.y), minUv, maxUv)).rgb * 2.0;
+    FragColor = vec4(color / 12.0, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+out vec2 Velocity;
+
+uniform sampler2D depth;
+uniform mat4 inverseViewProjection;  // this frame's, with the jitter the depth was drawn with
+uniform mat4 viewProjection;         // without jitter
+uniform mat4 previousViewProjection; // last frame's, without jitter
+uniform vec2 renderSize;
+
+// screen space motion of the static scene: the pixel's position from the depth, projected with this and
+// last frame's camera
+void main()
+{
+    float d = texelFetch(depth, ivec2(gl_FragCoord.xy), 0).r;
+    vec4 ndc = vec4(gl_FragCoord.xy / renderSize * 2.0 - 1.0, d * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * ndc;
+    world /= world.w;
+
+    vec4 current = viewProjection * world;
+    vec4 previous = previousViewProjection * world;
+    Velocity = (current.xy / current.w - previous.xy / previous.w) * 0.5;
+}
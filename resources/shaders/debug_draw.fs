@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec4 Color;
+
+// unlit, see DebugDraw
+void main()
+{
+    FragColor = Color;
+}
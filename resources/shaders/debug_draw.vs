@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;  // per instance for the shapes, per vertex for the lines
+layout (location = 2) in mat4 aModel;  // locations 2-5, per instance, the identity for the lines
+
+out vec4 Color;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    Color = aColor;
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
+}
@@ -0,0 +1,125 @@
+#version 330 core
+out vec4 FragColor;
+
+struct PointLight {
+    vec3 position;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+
+    float cutOff;
+    float outerCutOff;
+
+    vec3 specular;
+    vec3 diffuse;
+    vec3 ambient;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+};
+
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+uniform vec2 screenSize;
+
+// written once per frame into the stream buffer, see LightingBlock in main.cpp
+layout (std140) uniform Lighting {
+    PointLight pointLight;
+    PointLight pointLight1;
+    SpotLight spotLight;
+    vec3 viewPosition;
+};
+uniform int lightIndex; // 0 = pointLight, 1 = pointLight1, 2 = spotLight
+uniform sampler2D ambientOcclusion; // screen space, white without it
+float occlusion;
+
+vec3 decodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// same terms as 2.model_lighting_array.fs
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMask, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // combine results
+    vec3 ambient = light.ambient * albedo * occlusion;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMask;
+    return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMask, float shininess)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float diff = max(dot(normal, lightDir), 0.0);
+
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+    vec3 ambient = light.ambient * albedo * occlusion;
+    vec3 diffuse = light.diffuse * diff * albedo;
+    vec3 specular = light.specular * spec * specularMask;
+    return (ambient + diffuse + specular) * intensity;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    // nothing was drawn here, the background keeps its colour
+    if (depth == 1.0)
+        discard;
+
+    vec4 clip = vec4(gl_FragCoord.xy / screenSize * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverseViewProjection * clip;
+    vec3 fragPos = world.xyz / world.w;
+
+    vec4 albedoSpec = texelFetch(gAlbedoSpec, pixel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, pixel, 0);
+    vec3 normal = decodeNormal(normalShininess.xy);
+    float shininess = normalShininess.z * 1023.0;
+    vec3 viewDir = normalize(viewPosition - fragPos);
+    occlusion = texelFetch(ambientOcclusion, min(ivec2(gl_FragCoord.xy), textureSize(ambientOcclusion, 0) - 1), 0).r;
+
+    vec3 result;
+    if (lightIndex == 0)
+        result = CalcPointLight(pointLight, normal, fragPos, viewDir, albedoSpec.rgb, albedoSpec.a, shininess);
+    else if (lightIndex == 1)
+        result = CalcPointLight(pointLight1, normal, fragPos, viewDir, albedoSpec.rgb, albedoSpec.a, shininess);
+    else
+        result = CalcSpotLight(spotLight, normal, fragPos, viewDir, albedoSpec.rgb, albedoSpec.a, shininess);
+    FragColor = vec4(result, 1.0);
+}
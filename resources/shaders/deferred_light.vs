@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform bool fullscreen;
+
+void main()
+{
+    if (fullscreen)
+    {
+        // one triangle covering the screen, drawn without vertex data
+        vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    }
+    else
+        gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
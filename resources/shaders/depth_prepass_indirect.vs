@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aDrawId;
+
+// has to compute gl_Position exactly like 2.model_lighting_indirect.vs
+invariant gl_Position;
+
+// per draw: 4 texels of model matrix columns, then (materialIndex, 0, 0, 0)
+uniform samplerBuffer drawData;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    int base = int(aDrawId) * 5;
+    mat4 model = mat4(texelFetch(drawData, base),
+                      texelFetch(drawData, base + 1),
+                      texelFetch(drawData, base + 2),
+                      texelFetch(drawData, base + 3));
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,133 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D source; // tone mapped, luma in alpha
+uniform vec2 uvScale;     // part of the source that was rendered to
+
+const float EdgeThreshold = 0.125;
+const float EdgeThresholdMin = 0.0312;
+const float SubpixelQuality = 0.75;
+const int SearchSteps = 10;
+const float StepSizes[SearchSteps] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 4.0);
+
+vec2 minUv, maxUv;
+
+float luma(vec2 uv)
+{
+    return texture(source, clamp(uv, minUv, maxUv)).a;
+}
+
+// FXAA 3.11 quality (Lottes): local contrast test, edge direction from the second derivatives of the
+// luma, a search along the edge for its ends and a resample across it by the distance to the nearer end,
+// blended with a subpixel term for features smaller than a pixel
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(source, 0));
+    minUv = 0.5 * texelSize;
+    maxUv = uvScale - 0.5 * texelSize;
+    vec2 uv = TexCoords * uvScale;
+
+    vec4 center = texture(source, uv);
+    float lumaCenter = center.a;
+    float lumaDown = luma(uv + vec2(0.0, -texelSize.y));
+    float lumaUp = luma(uv + vec2(0.0, texelSize.y));
+    float lumaLeft = luma(uv + vec2(-texelSize.x, 0.0));
+    float lumaRight = luma(uv + vec2(texelSize.x, 0.0));
+
+    float lumaMin = min(lumaCenter, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+    float lumaMax = max(lumaCenter, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+    float lumaRange = lumaMax - lumaMin;
+    if (lumaRange < max(EdgeThresholdMin, lumaMax * EdgeThreshold)) {
+        FragColor = vec4(center.rgb, 1.0);
+        return;
+    }
+
+    float lumaDownLeft = luma(uv + vec2(-texelSize.x, -texelSize.y));
+    float lumaUpRight = luma(uv + vec2(texelSize.x, texelSize.y));
+    float lumaUpLeft = luma(uv + vec2(-texelSize.x, texelSize.y));
+    float lumaDownRight = luma(uv + vec2(texelSize.x, -texelSize.y));
+
+    float lumaDownUp = lumaDown + lumaUp;
+    float lumaLeftRight = lumaLeft + lumaRight;
+    float lumaLeftCorners = lumaDownLeft + lumaUpLeft;
+    float lumaDownCorners = lumaDownLeft + lumaDownRight;
+    float lumaRightCorners = lumaDownRight + lumaUpRight;
+    float lumaUpCorners = lumaUpRight + lumaUpLeft;
+
+    float edgeHorizontal = abs(-2.0 * lumaLeft + lumaLeftCorners) + abs(-2.0 * lumaCenter + lumaDownUp) * 2.0
+                         + abs(-2.0 * lumaRight + lumaRightCorners);
+    float edgeVertical = abs(-2.0 * lumaUp + lumaUpCorners) + abs(-2.0 * lumaCenter + lumaLeftRight) * 2.0
+                       + abs(-2.0 * lumaDown + lumaDownCorners);
+    bool isHorizontal = edgeHorizontal >= edgeVertical;
+
+    // which side of the pixel the edge is on
+    float luma1 = isHorizontal ? lumaDown : lumaLeft;
+    float luma2 = isHorizontal ? lumaUp : lumaRight;
+    float gradient1 = luma1 - lumaCenter;
+    float gradient2 = luma2 - lumaCenter;
+    bool is1Steepest = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+
+    float stepLength = isHorizontal ? texelSize.y : texelSize.x;
+    float lumaLocalAverage;
+    if (is1Steepest) {
+        stepLength = -stepLength;
+        lumaLocalAverage = 0.5 * (luma1 + lumaCenter);
+    } else {
+        lumaLocalAverage = 0.5 * (luma2 + lumaCenter);
+    }
+
+    // on the edge, half a pixel towards it
+    vec2 edgeUv = uv;
+    if (isHorizontal)
+        edgeUv.y += stepLength * 0.5;
+    else
+        edgeUv.x += stepLength * 0.5;
+
+    // search both ways along the edge until the luma differs from the local average by the gradient
+    vec2 offset = isHorizontal ? vec2(texelSize.x, 0.0) : vec2(0.0, texelSize.y);
+    vec2 uv1 = edgeUv - offset * StepSizes[0];
+    vec2 uv2 = edgeUv + offset * StepSizes[0];
+    float lumaEnd1 = luma(uv1) - lumaLocalAverage;
+    float lumaEnd2 = luma(uv2) - lumaLocalAverage;
+    bool reached1 = abs(lumaEnd1) >= gradientScaled;
+    bool reached2 = abs(lumaEnd2) >= gradientScaled;
+    for (int i = 1; i < SearchSteps && !(reached1 && reached2); i++) {
+        if (!reached1) {
+            uv1 -= offset * StepSizes[i];
+            lumaEnd1 = luma(uv1) - lumaLocalAverage;
+            reached1 = abs(lumaEnd1) >= gradientScaled;
+        }
+        if (!reached2) {
+            uv2 += offset * StepSizes[i];
+            lumaEnd2 = luma(uv2) - lumaLocalAverage;
+            reached2 = abs(lumaEnd2) >= gradientScaled;
+        }
+    }
+
+    float distance1 = isHorizontal ? uv.x - uv1.x : uv.y - uv1.y;
+    float distance2 = isHorizontal ? uv2.x - uv.x : uv2.y - uv.y;
+    bool isDirection1 = distance1 < distance2;
+    float distanceFinal = min(distance1, distance2);
+    float edgeLength = distance1 + distance2;
+    float pixelOffset = -distanceFinal / edgeLength + 0.5;
+
+    // only move towards the edge if the end found is on the same side of the average as the centre
+    bool isLumaCenterSmaller = lumaCenter < lumaLocalAverage;
+    bool correctVariation = ((isDirection1 ? lumaEnd1 : lumaEnd2) < 0.0) != isLumaCenterSmaller;
+    float finalOffset = correctVariation ? pixelOffset : 0.0;
+
+    float lumaAverage = (1.0 / 12.0) * (2.0 * (lumaDownUp + lumaLeftRight) + lumaLeftCorners + lumaRightCorners);
+    float subPixelOffset1 = clamp(abs(lumaAverage - lumaCenter) / lumaRange, 0.0, 1.0);
+    float subPixelOffset2 = (-2.0 * subPixelOffset1 + 3.0) * subPixelOffset1 * subPixelOffset1;
+    finalOffset = max(finalOffset, subPixelOffset2 * subPixelOffset2 * SubpixelQuality);
+
+    vec2 finalUv = uv;
+    if (isHorizontal)
+        finalUv.y += finalOffset * stepLength;
+    else
+        finalUv.x += finalOffset * stepLength;
+    FragColor = vec4(texture(source, clamp(finalUv, minUv, maxUv)).rgb, 1.0);
+}
@@ -0,0 +1,29 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalShininess;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+
+    float shininess;
+};
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+
+uniform Material material;
+
+// octahedral mapping of a unit vector onto [0, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+void main()
+{
+    gAlbedoSpec = vec4(texture(material.texture_diffuse1, TexCoords).rgb, texture(material.texture_specular1, TexCoords).r);
+    gNormalShininess = vec4(encodeNormal(normalize(Normal)), min(material.shininess, 1023.0) / 1023.0, 0.0);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormalShininess;
+
+// x = diffuse layer, y = specular layer (-1 if the material has none), z = shininess
+layout (std140) uniform Materials {
+    vec4 materials[256];
+};
+uniform sampler2DArray materialTextures;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+flat in int MaterialIndex;
+
+// octahedral mapping of a unit vector onto [0, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec4 material = materials[MaterialIndex];
+    vec3 albedo = material.x >= 0.0 ? texture(materialTextures, vec3(TexCoords, material.x)).rgb : vec3(1.0);
+    float specularMask = material.y >= 0.0 ? texture(materialTextures, vec3(TexCoords, material.y)).r : 0.0;
+    gAlbedoSpec = vec4(albedo, specularMask);
+    gNormalShininess = vec4(encodeNormal(normalize(Normal)), min(material.z, 1023.0) / 1023.0, 0.0);
+}
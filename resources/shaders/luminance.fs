@@ -0,0 +1,21 @@
+#version 330 core
+out float LogLuminance;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform vec2 uvScale; // part of the scene texture that was rendered to
+
+// log luminance of a 64x64 grid over the scene, four bilinear taps per cell. The mip chain averages it,
+// so the last level is the log of the geometric mean.
+void main()
+{
+    vec2 cell = uvScale / 64.0;
+    vec2 uv = TexCoords * uvScale;
+    vec3 color = texture(scene, uv + cell * vec2(-0.25, -0.25)).rgb
+               + texture(scene, uv + cell * vec2( 0.25, -0.25)).rgb
+               + texture(scene, uv + cell * vec2(-0.25,  0.25)).rgb
+               + texture(scene, uv + cell * vec2( 0.25,  0.25)).rgb;
+    float luminance = dot(color * 0.25, vec3(0.2126, 0.7152, 0.0722));
+    LogLuminance = log(max(luminance, 1e-4));
+}
@@ -0,0 +1,11 @@
+#version 330 core
+out vec2 Velocity;
+
+in vec4 CurrentPosition;
+in vec4 PreviousPosition;
+
+// same units as camera_motion.fs, fractions of the frame
+void main()
+{
+    Velocity = (CurrentPosition.xy / CurrentPosition.w - PreviousPosition.xy / PreviousPosition.w) * 0.5;
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// drawn with GL_LEQUAL over the scene depth, so it has to compute gl_Position like the shading pass
+invariant gl_Position;
+
+out vec4 CurrentPosition;
+out vec4 PreviousPosition;
+
+uniform mat4 model;
+uniform mat4 previousModel;
+uniform mat4 view;
+uniform mat4 projection;             // with the jitter
+uniform mat4 viewProjection;         // without
+uniform mat4 previousViewProjection; // last frame's, without
+
+void main()
+{
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    CurrentPosition = viewProjection * vec4(FragPos, 1.0);
+    PreviousPosition = previousViewProjection * previousModel * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+// both targets are blended with (ONE, ONE) for rgb and (ZERO, ONE_MINUS_SRC_ALPHA) for alpha:
+// target 0 collects the weighted premultiplied colour in rgb and the revealage (product of 1 - alpha) in a,
+// target 1 (single channel) collects the weighted alpha
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out vec4 weightedAlpha;
+
+in vec2 TexCoords;
+in float ViewDepth;
+
+uniform sampler2D texture1;
+
+void main()
+{
+    vec4 texColor = texture(texture1, TexCoords);
+    if (texColor.a < 0.01)
+        discard;
+    // McGuire & Bavoil, weight function (9): closer fragments count more
+    float weight = texColor.a * clamp(10.0 / (1e-5 + pow(ViewDepth / 5.0, 2.0) + pow(ViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+    accumulation = vec4(texColor.rgb * texColor.a * weight, texColor.a);
+    weightedAlpha = vec4(texColor.a * weight);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+layout (location = 3) in vec3 aOffset; // per instance
+
+out vec2 TexCoords;
+out float ViewDepth;
+
+// orientation and size shared by all instances, the instance offset moves them into place
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    vec4 viewPos = view * vec4(vec3(model * vec4(aPos, 1.0)) + aOffset, 1.0);
+    ViewDepth = -viewPos.z;
+    gl_Position = projection * viewPos;
+}
@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D accumulation;
+uniform sampler2D weightedAlpha;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumulation, pixel, 0);
+    float revealage = accum.a;
+    // nothing translucent covers this pixel
+    if (revealage >= 1.0)
+        discard;
+    vec3 average = accum.rgb / max(texelFetch(weightedAlpha, pixel, 0).r, 1e-5);
+    // blended with (SRC_ALPHA, ONE_MINUS_SRC_ALPHA) over the opaque scene
+    FragColor = vec4(average, 1.0 - revealage);
+}
@@ -0,0 +1,32 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D source;  // tone mapped
+uniform sampler2D weights; // smaa_weights.fs
+uniform vec2 renderSize;
+
+// every pixel takes its neighbours by the weights of the four edges around it: its own for the edges
+// below and to the left, the weights of the pixel above and to the right for theirs
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 maxPixel = ivec2(renderSize) - 1;
+    vec4 own = texelFetch(weights, pixel, 0);
+    float fromUp = pixel.y < maxPixel.y ? texelFetch(weights, pixel + ivec2(0, 1), 0).y : 0.0;
+    float fromRight = pixel.x < maxPixel.x ? texelFetch(weights, pixel + ivec2(1, 0), 0).w : 0.0;
+    vec4 w = vec4(own.x, fromUp, own.z, fromRight); // down, up, left, right
+
+    vec3 center = texelFetch(source, pixel, 0).rgb;
+    float total = w.x + w.y + w.z + w.w;
+    if (total < 1e-4) {
+        FragColor = vec4(center, 1.0);
+        return;
+    }
+    // clamped like every fetch in smaa_edges.fs, outside the texture the value is undefined and a zero
+    // weight times NaN is still NaN
+    vec3 neighbours = w.x * texelFetch(source, clamp(pixel + ivec2(0, -1), ivec2(0), maxPixel), 0).rgb
+                    + w.y * texelFetch(source, clamp(pixel + ivec2(0, 1), ivec2(0), maxPixel), 0).rgb
+                    + w.z * texelFetch(source, clamp(pixel + ivec2(-1, 0), ivec2(0), maxPixel), 0).rgb
+                    + w.w * texelFetch(source, clamp(pixel + ivec2(1, 0), ivec2(0), maxPixel), 0).rgb;
+    FragColor = vec4(mix(center, neighbours / total, min(total, 1.0)), 1.0);
+}
@@ -0,0 +1,37 @@
+#version 330 core
+out vec2 Edges;
+
+uniform sampler2D source; // tone mapped, luma in alpha
+uniform vec2 renderSize;
+
+const float Threshold = 0.1;
+const float LocalContrastFactor = 2.0;
+
+ivec2 maxPixel;
+
+float luma(ivec2 pixel)
+{
+    return texelFetch(source, clamp(pixel, ivec2(0), maxPixel), 0).a;
+}
+
+// r: edge with the pixel to the left, g: edge with the pixel below. An edge is a luma step over the
+// threshold that isn't much weaker than the strongest step next to it (local contrast adaptation), so
+// the weaker one of two parallel edges doesn't get blended too.
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    maxPixel = ivec2(renderSize) - 1;
+
+    float lumaCenter = luma(pixel);
+    vec2 lumaNear = vec2(luma(pixel + ivec2(-1, 0)), luma(pixel + ivec2(0, -1)));
+    vec2 delta = abs(lumaCenter - lumaNear);
+    vec2 edges = step(Threshold, delta);
+    if (edges.x + edges.y == 0.0)
+        discard;
+
+    vec2 lumaFar = vec2(luma(pixel + ivec2(-2, 0)), luma(pixel + ivec2(0, -2)));
+    vec2 lumaOpposite = vec2(luma(pixel + ivec2(1, 0)), luma(pixel + ivec2(0, 1)));
+    vec2 maxDelta = max(max(delta, abs(lumaNear - lumaFar)), abs(lumaCenter - lumaOpposite));
+    edges *= step(max(maxDelta.x, maxDelta.y), LocalContrastFactor * delta);
+    Edges = edges;
+}
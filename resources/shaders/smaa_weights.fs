@@ -0,0 +1,81 @@
+#version 330 core
+out vec4 Weights;
+
+uniform sampler2D edges; // r: edge on the left, g: edge below (smaa_edges.fs)
+uniform vec2 renderSize;
+
+const int MaxSearchSteps = 16;
+
+ivec2 maxPixel;
+
+vec2 edgesAt(ivec2 pixel)
+{
+    if (any(lessThan(pixel, ivec2(0))) || any(greaterThan(pixel, maxPixel)))
+        return vec2(0.0);
+    return texelFetch(edges, pixel, 0).rg;
+}
+
+// height of the reconstructed line at an end of an edge, from the crossing edges there: half a pixel
+// into this pixel's side, into the neighbour's side, or on the boundary for none or both
+float endHeight(float crossingOwnSide, float crossingNeighbourSide)
+{
+    return 0.5 * (crossingOwnSide - crossingNeighbourSide);
+}
+
+// area between the boundary and a line that starts at height h at an end and meets the boundary in the
+// middle of the edge (halfLength from the end), over [a, b] measured from that end
+float endArea(float h, float halfLength, float a, float b)
+{
+    float u = clamp(a, 0.0, halfLength), v = clamp(b, 0.0, halfLength);
+    return h * ((v - u) - (v * v - u * u) / (2.0 * halfLength));
+}
+
+// signed area of the pixel cut off by the edge pattern, for a pixel with before pixels of the edge on one
+// side and after on the other. Takes the place of SMAA's precomputed area texture: each end shapes the
+// line up to the middle of the edge, so L, Z and U patterns all come out of the two end heights.
+float patternArea(int before, int after, float h1, float h2)
+{
+    float halfLength = 0.5 * float(before + after + 1);
+    return endArea(h1, halfLength, float(before), float(before + 1))
+         + endArea(h2, halfLength, float(after), float(after + 1));
+}
+
+// x: how much of the pixel below to blend into this one, y: how much of this one into the pixel below,
+// z and w the same with the pixel to the left
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    maxPixel = ivec2(renderSize) - 1;
+    vec2 e = edgesAt(pixel);
+    if (e.r + e.g == 0.0)
+        discard;
+
+    vec4 weights = vec4(0.0);
+    if (e.g > 0.0) {
+        int left = 0, right = 0;
+        while (left < MaxSearchSteps && edgesAt(pixel + ivec2(-left - 1, 0)).g > 0.0)
+            left++;
+        while (right < MaxSearchSteps && edgesAt(pixel + ivec2(right + 1, 0)).g > 0.0)
+            right++;
+        // crossing edges are the left edges of the first pixel and the one after the last, in this row and below
+        ivec2 start = pixel + ivec2(-left, 0), end = pixel + ivec2(right + 1, 0);
+        float h1 = endHeight(edgesAt(start).r, edgesAt(start + ivec2(0, -1)).r);
+        float h2 = endHeight(edgesAt(end).r, edgesAt(end + ivec2(0, -1)).r);
+        float area = patternArea(left, right, h1, h2);
+        weights.xy = vec2(max(area, 0.0), max(-area, 0.0));
+    }
+    if (e.r > 0.0) {
+        int down = 0, up = 0;
+        while (down < MaxSearchSteps && edgesAt(pixel + ivec2(0, -down - 1)).r > 0.0)
+            down++;
+        while (up < MaxSearchSteps && edgesAt(pixel + ivec2(0, up + 1)).r > 0.0)
+            up++;
+        // crossing edges are the bottom edges of the first pixel and the one after the last, in this column and left
+        ivec2 start = pixel + ivec2(0, -down), end = pixel + ivec2(0, up + 1);
+        float h1 = endHeight(edgesAt(start).g, edgesAt(start + ivec2(-1, 0)).g);
+        float h2 = endHeight(edgesAt(end).g, edgesAt(end + ivec2(-1, 0)).g);
+        float area = patternArea(down, up, h1, h2);
+        weights.zw = vec2(max(area, 0.0), max(-area, 0.0));
+    }
+    Weights = weights;
+}
@@ -0,0 +1,68 @@
+#version 330 core
+out vec2 Result;
+
+uniform sampler2D depth;
+uniform mat4 projection;        // the one the depth was drawn with
+uniform mat4 inverseProjection;
+uniform vec2 renderSize;        // full resolution area of the depth
+uniform int divisor;            // this pass runs at 1 / divisor of it
+uniform int sampleCount;
+uniform vec3 samples[32];       // hemisphere kernel around +z, see Ssao::uploadKernel
+uniform float radius;
+uniform float bias;
+uniform float power;
+
+vec3 viewPosition(ivec2 pixel)
+{
+    pixel = clamp(pixel, ivec2(0), ivec2(renderSize) - 1);
+    float d = texelFetch(depth, pixel, 0).r;
+    vec4 ndc = vec4((vec2(pixel) + 0.5) / renderSize * 2.0 - 1.0, d * 2.0 - 1.0, 1.0);
+    vec4 view = inverseProjection * ndc;
+    return view.xyz / view.w;
+}
+
+float viewDepth(ivec2 pixel)
+{
+    float d = texelFetch(depth, clamp(pixel, ivec2(0), ivec2(renderSize) - 1), 0).r;
+    return -projection[3][2] / (d * 2.0 - 1.0 + projection[2][2]);
+}
+
+// outputs the occlusion (1 = open) and the linear depth of the pixel for the blur and the upsample
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy) * divisor;
+    if (texelFetch(depth, pixel, 0).r == 1.0)
+    {
+        // nothing was drawn here
+        Result = vec2(1.0, 1.0e4);
+        return;
+    }
+    vec3 position = viewPosition(pixel);
+
+    // normal from the neighbours, each axis from the side closer in depth so silhouettes stay sharp
+    vec3 left = viewPosition(pixel - ivec2(1, 0)), right = viewPosition(pixel + ivec2(1, 0));
+    vec3 down = viewPosition(pixel - ivec2(0, 1)), up = viewPosition(pixel + ivec2(0, 1));
+    vec3 dx = abs(right.z - position.z) < abs(position.z - left.z) ? right - position : position - left;
+    vec3 dy = abs(up.z - position.z) < abs(position.z - down.z) ? up - position : position - down;
+    vec3 normal = normalize(cross(dx, dy));
+
+    // kernel rotated around the normal by interleaved gradient noise
+    float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    vec3 randomVector = vec3(cos(angle), sin(angle), 0.0);
+    vec3 tangent = normalize(randomVector - normal * dot(randomVector, normal));
+    vec3 bitangent = cross(normal, tangent);
+    mat3 tbn = mat3(tangent, bitangent, normal);
+
+    float occlusion = 0.0;
+    for (int i = 0; i < sampleCount; i++)
+    {
+        vec3 samplePosition = position + tbn * samples[i] * radius;
+        vec4 clip = projection * vec4(samplePosition, 1.0);
+        vec2 screen = (clip.xy / clip.w * 0.5 + 0.5) * renderSize;
+        float sceneDepth = viewDepth(ivec2(screen));
+        // occluders much closer to the camera than the radius don't darken this pixel
+        float range = smoothstep(0.0, 1.0, radius / abs(position.z - sceneDepth));
+        occlusion += (sceneDepth >= samplePosition.z + bias ? 1.0 : 0.0) * range;
+    }
+    Result = vec2(pow(1.0 - occlusion / float(sampleCount), power), -position.z);
+}
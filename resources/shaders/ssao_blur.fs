@@ -0,0 +1,30 @@
+#version 330 core
+out vec2 Result;
+
+uniform sampler2D ao;         // occlusion, linear depth
+uniform vec2 size;            // area drawn to
+uniform vec2 direction;       // (1, 0) or (0, 1)
+uniform float depthSharpness;
+
+// one direction of a separable gaussian, taps that lie at a different depth than the centre count less
+void main()
+{
+    const float weights[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 maxPixel = ivec2(size) - 1;
+    vec2 centre = texelFetch(ao, pixel, 0).rg;
+
+    float sum = centre.r * weights[0];
+    float weightSum = weights[0];
+    for (int i = 1; i < 5; i++)
+    {
+        for (int side = -1; side <= 1; side += 2)
+        {
+            vec2 tap = texelFetch(ao, clamp(pixel + ivec2(direction * float(i * side)), ivec2(0), maxPixel), 0).rg;
+            float w = weights[i] * exp(-depthSharpness * abs(tap.g - centre.g) / centre.g);
+            sum += tap.r * w;
+            weightSum += w;
+        }
+    }
+    Result = vec2(sum / weightSum, centre.g);
+}
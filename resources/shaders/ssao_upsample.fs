@@ -0,0 +1,36 @@
+#version 330 core
+out float Occlusion;
+
+uniform sampler2D ao;         // blurred occlusion, linear depth at low resolution
+uniform sampler2D depth;      // full resolution scene depth
+uniform mat4 projection;
+uniform vec2 lowSize;         // area of ao drawn to
+uniform int divisor;
+uniform float depthSharpness;
+
+// joint bilateral upsample: the bilinear weights of the four nearest low resolution pixels, each scaled
+// down by how much its depth differs from this pixel's
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float d = texelFetch(depth, pixel, 0).r;
+    float z = projection[3][2] / (d * 2.0 - 1.0 + projection[2][2]); // linear, positive like in ao
+
+    // a low resolution pixel samples the first full resolution pixel of its block, see ssao.fs
+    vec2 position = (vec2(pixel) + 0.5) / float(divisor) - 0.5 / float(divisor);
+    vec2 base = floor(position);
+    vec2 f = position - base;
+    ivec2 maxPixel = ivec2(lowSize) - 1;
+
+    float sum = 0.0, weightSum = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        vec2 tap = texelFetch(ao, clamp(ivec2(base) + offset, ivec2(0), maxPixel), 0).rg;
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float w = bilinear.x * bilinear.y * exp(-depthSharpness * abs(tap.g - z) / z) + 1.0e-4;
+        sum += tap.r * w;
+        weightSum += w;
+    }
+    Occlusion = sum / weightSum;
+}
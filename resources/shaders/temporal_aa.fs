@@ -0,0 +1,61 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D current;  // this frame, HDR
+uniform sampler2D history;
+uniform sampler2D velocity;
+uniform vec2 renderSize;
+uniform vec2 historyUvScale;
+uniform bool historyValid;
+uniform float feedback; // share of the history in the result
+
+vec3 toYCoCg(vec3 c)
+{
+    return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 fromYCoCg(vec3 c)
+{
+    return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// temporal anti-aliasing resolve: the history is reprojected by the motion of the pixel and clamped to the
+// colour range of the current 3x3 neighbourhood (in YCoCg, where the box fits the colours tighter), so
+// disoccluded or changed surfaces don't ghost. Both are weighted by their inverse luma before blending so
+// a few very bright samples don't flicker.
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 maxPixel = ivec2(renderSize) - 1;
+    vec3 color = texelFetch(current, pixel, 0).rgb;
+    if (!historyValid) {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    vec2 previousUv = gl_FragCoord.xy / renderSize - texelFetch(velocity, pixel, 0).rg;
+    if (any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0)))) {
+        FragColor = vec4(color, 1.0);
+        return;
+    }
+
+    vec3 lo = vec3(1e9), hi = vec3(-1e9);
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 c = toYCoCg(texelFetch(current, clamp(pixel + ivec2(x, y), ivec2(0), maxPixel), 0).rgb);
+            lo = min(lo, c);
+            hi = max(hi, c);
+        }
+    }
+    vec3 previous = texture(history, previousUv * historyUvScale).rgb;
+    previous = fromYCoCg(clamp(toYCoCg(previous), lo, hi));
+
+    float currentWeight = (1.0 - feedback) / (1.0 + luma(color));
+    float historyWeight = feedback / (1.0 + luma(previous));
+    FragColor = vec4((color * currentWeight + previous * historyWeight) / (currentWeight + historyWeight), 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform vec2 uvScale;      // part of the scene texture that was rendered to
+uniform vec2 bloomUvScale; // and of the first bloom level
+uniform float exposure;
+uniform float bloomStrength;
+
+// ACES filmic curve, Narkowicz' fit
+vec3 aces(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+// the scene shaders write display values without gamma, so the result isn't gamma encoded either.
+// The luma goes to alpha for the anti-aliasing passes
+void main()
+{
+    vec3 hdr = texture(scene, TexCoords * uvScale).rgb;
+    hdr += texture(bloom, TexCoords * bloomUvScale).rgb * bloomStrength;
+    vec3 color = aces(hdr * exposure);
+    FragColor = vec4(color, dot(color, vec3(0.299, 0.587, 0.114)));
+}
@@ -2,6 +2,8 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
+invariant gl_Position; // matches depth_prepass.vs for the GL_EQUAL pass
+
 out vec2 TexCoords;
 
 uniform mat4 model;
@@ -11,5 +13,6 @@ uniform mat4 projection;
 void main()
 {
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
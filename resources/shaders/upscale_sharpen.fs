@@ -0,0 +1,32 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform vec2 uvScale;   // part of the texture that was rendered to
+uniform float sharpness;
+
+// bilinear upscale followed by a contrast adaptive sharpen: the centre is pushed away from the average of
+// its cross neighbours, and the result is clamped to their range so edges don't ring
+void main()
+{
+    vec2 texelSize = 1.0 / vec2(textureSize(scene, 0));
+    vec2 uv = TexCoords * uvScale;
+    vec2 halfTexel = 0.5 * texelSize;
+    vec2 minUv = halfTexel, maxUv = uvScale - halfTexel;
+    vec2 offset = texelSize; // one source texel
+
+    vec3 c = texture(scene, clamp(uv, minUv, maxUv)).rgb;
+    vec3 n = texture(scene, clamp(uv + vec2(0.0, offset.y), minUv, maxUv)).rgb;
+    vec3 s = texture(scene, clamp(uv - vec2(0.0, offset.y), minUv, maxUv)).rgb;
+    vec3 e = texture(scene, clamp(uv + vec2(offset.x, 0.0), minUv, maxUv)).rgb;
+    vec3 w = texture(scene, clamp(uv - vec2(offset.x, 0.0), minUv, maxUv)).rgb;
+
+    vec3 lo = min(c, min(min(n, s), min(e, w)));
+    vec3 hi = max(c, max(max(n, s), max(e, w)));
+    // less sharpening where the neighbourhood already has a lot of contrast
+    vec3 amount = sharpness * (1.0 - (hi - lo));
+    vec3 sharpened = c + amount * (4.0 * c - (n + s + e + w)) * 0.25;
+    FragColor = vec4(clamp(sharpened, lo, hi), 1.0);
+}
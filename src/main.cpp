@@ -8,8 +8,30 @@
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/anti_aliasing.h>
+#include <learnopengl/debug_draw.h>
+#include <learnopengl/deferred_renderer.h>
+#include <learnopengl/depth_prepass.h>
+#include <learnopengl/dynamic_resolution.h>
+#include <learnopengl/gpu_timer.h>
 #include <learnopengl/model.h>
-
+#include <learnopengl/weighted_oit.h>
+#include <learnopengl/indirect_batch.h>
+#include <learnopengl/lod_selector.h>
+#include <learnopengl/occlusion_queries.h>
+#include <learnopengl/post_process.h>
+#include <learnopengl/ssao.h>
+#include <learnopengl/stream_buffer.h>
+#include <learnopengl/temporal.h>
+#include <rg/Bvh.h>
+#include <rg/GLExtensions.h>
+#include <rg/ImageDecode.h>
+#include <rg/OcclusionCuller.h>
+#include <rg/Parallel.h>
+#include <rg/TextureCache.h>
+
+#include <chrono>
+#include <fstream>
 #include <iostream>
 
 
@@ -35,6 +57,40 @@ const unsigned int SCR_HEIGHT = 600;
 bool blinn = false;
 bool blinnKeyPressed = false;
 
+// occlusion culling with GPU queries instead of the software depth buffer, toggled with O
+bool gpuOcclusion = false;
+
+// object classes of the depth pre-pass, toggled with keys 1-4, Z reports the shading saved
+enum PrepassObjectClass { PrepassStatic, PrepassModels, PrepassTowel, PrepassFloor, PrepassClassCount };
+const char *prepassClassNames[] = { "static batch", "models", "towel", "floor" };
+DepthPrepass depthPrepass(PrepassClassCount);
+
+// the models are lit by a deferred pass over a G-buffer instead of in their own shaders, toggled with G
+bool deferredShading = false;
+
+// the scene is rendered at a scale that keeps the GPU frame time near the target and upscaled, toggled with R
+DynamicResolution dynamicResolution;
+
+// anti-aliasing mode, cycled with X; N benchmarks all of them at a fixed resolution
+AntiAliasingMode antiAliasingMode = AntiAliasingFxaa;
+AntiAliasingBenchmark aaBenchmark;
+bool dynamicResolutionBeforeBenchmark = true;
+bool deferredShadingBeforeBenchmark = false;
+
+// screen space ambient occlusion at 1 / ssaoDivisor of the render resolution (0 = off), C cycles off, full,
+// half and quarter resolution, V the sample count
+int ssaoDivisor = 2;
+int ssaoSamples = 16;
+const char *ssaoResolutionName(int divisor) { return divisor == 1 ? "full" : (divisor == 2 ? "half" : "quarter"); }
+
+// instancing stress test: I cycles through 0, 1000, 4000 and 16000 coconuts drawn with Model::DrawInstanced,
+// U draws them one Model::Draw at a time instead to compare
+unsigned int instanceStressCount = 0;
+bool instanceStressLoop = false;
+
+// the scene objects' boxes, green when drawn and red when culled, toggled with K
+bool debugBounds = false;
+
 // camera
 
 float lastX = SCR_WIDTH / 2.0f;
@@ -89,23 +145,85 @@ void ProgramState::SaveToFile(std::string filename) {
 }
 
 void ProgramState::LoadFromFile(std::string filename) {
-    std::ifstream in(filename);
-    if (in) {
-        in >> clearColor.r
-           >> clearColor.g
-           >> clearColor.b
-           >> camera.Position.x
-           >> camera.Position.y
-           >> camera.Position.z
-           >> camera.Front.x
-           >> camera.Front.y
-           >> camera.Front.z;
+    rg::FileData file;
+    if (rg::readFile(filename, file)) {
+        float *values[] = {
+                &clearColor.r, &clearColor.g, &clearColor.b,
+                &camera.Position.x, &camera.Position.y, &camera.Position.z,
+                &camera.Front.x, &camera.Front.y, &camera.Front.z
+        };
+        size_t pos = 0;
+        for (float *value : values) {
+            if (!rg::parseFloat(file.view(), pos, *value))
+                break;
+        }
     }
 }
 
 ProgramState *programState;
 MovingObject movingObject;
 
+// world boxes of the models in the scene, for culling and picking
+enum SceneObject { SceneSuncobran, SceneKokos, SceneLopta, SceneObjectCount };
+const char *sceneObjectNames[] = { "suncobran", "kokos", "lopta" };
+rg::Bvh sceneBvh;
+
+glm::mat4 loptaTransform(float time) {
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(8.0f, -15.0f, 35.0f) + (float)movingObject.lopta * glm::vec3(0.0f, sin(time * 4) * 4, 2.0f));
+    model = glm::rotate(model,glm::radians(30.0f),glm::vec3(0.0,1.0,0.0));
+    model = glm::scale(model, glm::vec3(0.2f));
+    return model;
+}
+
+// where writeLightingBlock puts pointLight and pointLight1
+const glm::vec3 shadingLightPositions[] = { glm::vec3(-2.32f, 0.54f, 6.8f), glm::vec3(-1.0f, 3.0f, 4.0f) };
+
+// std140 layout of the Lighting uniform block of 2.model_lighting.fs, 2.model_lighting_array.fs and
+// deferred_light.fs: a vec3 takes 16 bytes unless a float follows it, structs are padded to 16 bytes
+struct PointLightStd140 {
+    glm::vec4 position;
+    glm::vec4 specular;
+    glm::vec4 diffuse;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding[2];
+};
+
+struct SpotLightStd140 {
+    glm::vec4 position;
+    glm::vec3 direction;
+    float cutOff;
+    float outerCutOff;
+    float padding0[3];
+    glm::vec4 specular;
+    glm::vec4 diffuse;
+    glm::vec3 ambient;
+    float constant;
+    float linear;
+    float quadratic;
+    float padding1[2];
+};
+
+struct LightingBlock {
+    PointLightStd140 pointLight;
+    PointLightStd140 pointLight1;
+    SpotLightStd140 spotLight;
+    glm::vec3 viewPosition;
+    float padding;
+};
+static_assert(sizeof(PointLightStd140) == 80 && sizeof(SpotLightStd140) == 112 && sizeof(LightingBlock) == 288,
+              "LightingBlock has to match the std140 layout of the Lighting block");
+
+// MaterialLibrary::UniformBinding is 0
+const unsigned int LightingUniformBinding = 1;
+
+void bindLightingBlock(Shader &shader);
+void writeLightingBlock(StreamBuffer &stream, PointLight &pointLight);
+void setLightingUniforms(Shader &ourShader, const glm::mat4 &projection, const glm::mat4 &view);
+
 
 int main() {
     // glfw: initialize and configure
@@ -138,6 +256,10 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    rg::loadGLExtensions((GLADloadproc) glfwGetProcAddress);
+
+    // packed resources (built by the pack_resources target), loose files are used for anything not in it
+    rg::vfs.mount(FileSystem::getPath("resources.pak"));
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -148,19 +270,88 @@ int main() {
 
     // build and compile shaders
     Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+    Shader indirectShader("resources/shaders/2.model_lighting_indirect.vs", "resources/shaders/2.model_lighting_array.fs");
+    Shader depthShader("resources/shaders/depth_prepass.vs", "resources/shaders/depth_prepass.fs");
+    Shader depthIndirectShader("resources/shaders/depth_prepass_indirect.vs", "resources/shaders/depth_prepass.fs");
+    Shader gbufferShader("resources/shaders/2.model_lighting.vs", "resources/shaders/gbuffer.fs");
+    Shader gbufferIndirectShader("resources/shaders/2.model_lighting_indirect.vs", "resources/shaders/gbuffer_array.fs");
+    Shader deferredLightShader("resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs");
+    Shader oitShader("resources/shaders/oit_billboard.vs", "resources/shaders/oit_accumulate.fs");
+    Shader oitCompositeShader("resources/shaders/fullscreen.vs", "resources/shaders/oit_composite.fs");
+    Shader upscaleShader("resources/shaders/fullscreen.vs", "resources/shaders/upscale_sharpen.fs");
+    Shader bloomDownsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloom_downsample.fs");
+    Shader bloomUpsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/bloom_upsample.fs");
+    Shader luminanceShader("resources/shaders/fullscreen.vs", "resources/shaders/luminance.fs");
+    Shader tonemapShader("resources/shaders/fullscreen.vs", "resources/shaders/tonemap.fs");
+    Shader fxaaShader("resources/shaders/fullscreen.vs", "resources/shaders/fxaa.fs");
+    Shader smaaEdgesShader("resources/shaders/fullscreen.vs", "resources/shaders/smaa_edges.fs");
+    Shader smaaWeightsShader("resources/shaders/fullscreen.vs", "resources/shaders/smaa_weights.fs");
+    Shader smaaBlendShader("resources/shaders/fullscreen.vs", "resources/shaders/smaa_blend.fs");
+    Shader cameraMotionShader("resources/shaders/fullscreen.vs", "resources/shaders/camera_motion.fs");
+    Shader objectMotionShader("resources/shaders/motion_vectors.vs", "resources/shaders/motion_vectors.fs");
+    Shader temporalAaShader("resources/shaders/fullscreen.vs", "resources/shaders/temporal_aa.fs");
+    Shader instancedShader("resources/shaders/2.model_lighting_instanced.vs", "resources/shaders/2.model_lighting.fs");
+    Shader ssaoShader("resources/shaders/fullscreen.vs", "resources/shaders/ssao.fs");
+    Shader ssaoBlurShader("resources/shaders/fullscreen.vs", "resources/shaders/ssao_blur.fs");
+    Shader ssaoUpsampleShader("resources/shaders/fullscreen.vs", "resources/shaders/ssao_upsample.fs");
     Shader skyboxShader("resources/shaders/6.1.skybox.vs", "resources/shaders/6.1.skybox.fs");
     Shader transpShader("resources/shaders/transparentobj.vs", "resources/shaders/transparentobj.fs");
 
     //lightcube
     Shader lightCubeShader("resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs");
+    Shader debugDrawShader("resources/shaders/debug_draw.vs", "resources/shaders/debug_draw.fs");
+    for (Shader *shader : { &ourShader, &indirectShader, &deferredLightShader, &instancedShader })
+        bindLightingBlock(*shader);
     glEnable(GL_DEPTH_TEST);
     // TODO adv
     Shader advShader("resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs");
 
-    // load models
-    Model ourModelSuncobran("resources/objects/suncobran/13518_Beach_Umbrella_v1_L3.obj");
-    Model ourModelLopta("resources/objects/lopta/13517_Beach_Ball_v2_L3.obj");
-    Model ourModelKokos("resources/objects/kokos2/10175_CoconutHalf_L3.obj");
+    // load models, all static geometry shares one vertex/index buffer pair.
+    // every mesh gets 3 simplified LODs (1/2, 1/4, 1/8 of the triangles), picked per frame by lodSelector
+    GeometryArena staticGeometry(sizeof(Vertex), setupVertexAttributes);
+    MeshLodSettings lodSettings;
+    // the umbrella and the coconut are drawn by staticBatch, which reads their textures from staticMaterials
+    Model ourModelSuncobran("resources/objects/suncobran/13518_Beach_Umbrella_v1_L3.obj", false, MeshResidency::GpuWithCollision, &staticGeometry, &lodSettings, false);
+    Model ourModelLopta("resources/objects/lopta/13517_Beach_Ball_v2_L3.obj", false, MeshResidency::GpuWithCollision, &staticGeometry, &lodSettings);
+    Model ourModelKokos("resources/objects/kokos2/10175_CoconutHalf_L3.obj", false, MeshResidency::GpuOnly, &staticGeometry, &lodSettings, false);
+    LodSelector lodSelector;
+    staticGeometry.PrintStats("static");
+
+    // the umbrella and the coconut never move, so their draws are recorded once into an indirect batch
+    IndirectBatch staticBatch(staticGeometry);
+    vector<rg::Aabb> sceneBounds(SceneObjectCount);
+    glm::mat4 suncobranModel;
+    {
+        //SUNCOBRAN
+        glm::mat4 model = glm::mat4(1.0f);
+        //glm::vec3(-2.75f, -0.30f, 3.5f)
+        model = glm::translate(model,glm::vec3(-2.5f,-1.2f,10.5f));
+        model = glm::rotate(model,glm::radians(80.0f),glm::vec3(0.85,0,1.0));
+        model = glm::rotate(model,glm::radians(150.0f),glm::vec3(0,1.0,0));
+        model = glm::scale(model, glm::vec3(0.017f,0.017f,0.017f));    // it's a bit too big for our scene, so scale it down
+        staticBatch.Add(ourModelSuncobran, model);
+        suncobranModel = model;
+        sceneBounds[SceneSuncobran] = rg::Aabb::transformed(ourModelSuncobran.GetBounds(), model);
+
+        //KOKOS
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(-13.0f,-8.0f,3.5f));
+        model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(1.0,0,0.0));
+        model = glm::scale(model, glm::vec3(0.008f,0.008f,0.008f));
+        staticBatch.Add(ourModelKokos, model);
+        sceneBounds[SceneKokos] = rg::Aabb::transformed(ourModelKokos.GetBounds(), model);
+    }
+    sceneBounds[SceneLopta] = rg::Aabb::transformed(ourModelLopta.GetBounds(), loptaTransform(0.0f));
+    sceneBvh.build(sceneBounds);
+    // their textures go into one texture array, so the batch needs a single draw call
+    MaterialLibrary staticMaterials;
+    staticMaterials.AddModel(ourModelSuncobran);
+    staticMaterials.AddModel(ourModelKokos);
+    staticMaterials.Build();
+    staticBatch.Build(&staticMaterials);
+    ourModelSuncobran.PrintMemoryReport("suncobran");
+    ourModelLopta.PrintMemoryReport("lopta");
+    ourModelKokos.PrintMemoryReport("kokos");
 
     glEnable(GL_DEPTH_TEST);
 
@@ -238,52 +429,6 @@ int main() {
             1,2,3
     };
 
-    float CubeVertices[] = {
-            // positions          // normals           // texture coords
-            -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-            0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  0.0f,
-            0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-            0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  1.0f,  1.0f,
-            -0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,  0.0f,  0.0f,
-
-            -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-            0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,
-            -0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,
-
-            -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-            -0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-            -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            -0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-            -0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-            0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-            0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,
-            0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  1.0f,
-            0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.0f,  0.0f,
-            0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  0.0f,
-
-            -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-            0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  1.0f,
-            0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-            0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  1.0f,  0.0f,
-            -0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  0.0f,
-            -0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,  0.0f,  1.0f,
-
-            -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f,
-            0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  0.0f,
-            -0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  0.0f,
-            -0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,  0.0f,  1.0f
-    };
-
-
         // TODO adv
     float planeVertices[] = {
 
@@ -308,27 +453,6 @@ int main() {
     };
 
 
-    unsigned int lightCubeVAO, lightCubeVBO;
-    glGenVertexArrays(1, &lightCubeVAO);
-    glBindVertexArray(lightCubeVAO);
-
-    glGenBuffers(1, &lightCubeVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, lightCubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(CubeVertices), CubeVertices, GL_STATIC_DRAW);
-
-    glBindVertexArray(lightCubeVAO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-//    glBindBuffer(GL_ARRAY_BUFFER, lightCubeVBO);
-    // note that we update the lamp's position attribute's stride to reflect the updated buffer data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
     // TODO plane VAO adv
     unsigned int planeVAO, planeVBO;
     glGenVertexArrays(1, &planeVAO);
@@ -390,8 +514,68 @@ int main() {
     glEnableVertexAttribArray(2);
 
 
+    // the umbrella (its collision proxy) and the towel hide the smaller props, they are rasterized into
+    // a small CPU depth buffer every frame and the coconut and the ball are tested against it
+    rg::OccluderMesh suncobranOccluder;
+    for (const Mesh& mesh : ourModelSuncobran.meshes) {
+        unsigned int base = suncobranOccluder.positions.size();
+        suncobranOccluder.positions.insert(suncobranOccluder.positions.end(), mesh.collision.positions.begin(), mesh.collision.positions.end());
+        for (unsigned int i = 0; i < mesh.collision.triangleCount() * 3; i++)
+            suncobranOccluder.indices.push_back(base + mesh.collision.index(i));
+    }
+    rg::OccluderMesh peskirOccluder;
+    for (int i = 0; i < 4; i++)
+        peskirOccluder.positions.push_back(glm::vec3(peskirVertices[i * 8], peskirVertices[i * 8 + 1], peskirVertices[i * 8 + 2]));
+    peskirOccluder.indices.assign(indices, indices + 6);
+    glm::mat4 peskirModel = glm::mat4(1.0f);
+    peskirModel = glm::translate(peskirModel, glm::vec3(-3.5f, -7.6f, 25.0f));
+    peskirModel = glm::rotate(peskirModel,glm::radians(90.0f),glm::vec3(0.4,0.0,0.0));
+    peskirModel = glm::scale(peskirModel,glm::vec3(3.0f));
+    rg::OcclusionCuller occlusionCuller(256, 192);
+    // query keys: the scene objects first, then the draws of the static batch
+    OcclusionQueries occlusionQueries;
+    occlusionQueries.Init();
+    double lastOcclusionReport = 0.0;
+    double lastPrepassReport = 0.0;
+
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    DeferredRenderer deferredRenderer;
+    deferredRenderer.Init(framebufferWidth, framebufferHeight);
+    WeightedOit weightedOit;
+    weightedOit.Init(framebufferWidth, framebufferHeight);
+    dynamicResolution.Init(framebufferWidth, framebufferHeight);
+    double lastResolutionReport = 0.0;
+    PostProcess postProcess(bloomDownsampleShader, bloomUpsampleShader, luminanceShader, tonemapShader);
+    postProcess.Init(framebufferWidth, framebufferHeight);
+    double lastPostReport = 0.0;
+    AntiAliasing antiAliasing(fxaaShader, smaaEdgesShader, smaaWeightsShader, smaaBlendShader);
+    antiAliasing.Init(framebufferWidth, framebufferHeight);
+    Temporal temporal(cameraMotionShader, objectMotionShader);
+    temporal.Init(framebufferWidth, framebufferHeight);
+    TemporalAccumulator temporalAaHistory;
+    temporalAaHistory.Init(framebufferWidth, framebufferHeight, GL_RGBA16F, GL_RGBA);
+    Ssao ssao(ssaoShader, ssaoBlurShader, ssaoUpsampleShader);
+    ssao.Init(framebufferWidth, framebufferHeight);
+    double lastSsaoReport = 0.0;
+    // per-frame uniform blocks and debug primitives
+    StreamBuffer streamBuffer;
+    streamBuffer.Init(64 * 1024);
+    double lastStreamReport = 0.0;
+    DebugDraw debugDraw;
+    debugDraw.Init(streamBuffer);
+    vector<glm::mat4> stressTransforms;
+    GpuTimer stressTimer;
+    double lastStressReport = 0.0;
+    // GPU time of the lit models (pre-pass, models and in deferred mode the lighting), to compare the paths
+    GpuTimer litTimer;
+    double lastRendererReport = 0.0;
+    // the lighting shader of the models is the expensive one, the pre-pass starts out enabled for them
+    depthPrepass.SetEnabled(PrepassStatic, true);
+    depthPrepass.SetEnabled(PrepassModels, true);
+
     // texture loading
-    stbi_set_flip_vertically_on_load(true);
+    rg::setFlipVerticallyOnLoad(true);
 
     unsigned int floorTexture = loadTexture(FileSystem::getPath("resources/textures/pexels-sharon-mccutcheon-3711238.jpg").c_str());
     unsigned int transparentTravaTexture = loadTexture(FileSystem::getPath("resources/textures/grass.png").c_str());
@@ -415,8 +599,19 @@ int main() {
                     glm::vec3(10.0f,-7.0f,6.5f),
                     glm::vec3(10.0f,-5.5f,6.5f),
             };
+    // one instance per grass quad, all of them are drawn with a single call
+    unsigned int vegetationInstanceVBO;
+    glGenBuffers(1, &vegetationInstanceVBO);
+    glBindVertexArray(transparentTravaVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, vegetationInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, vegetation.size() * sizeof(glm::vec3), vegetation.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glVertexAttribDivisor(3, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    stbi_set_flip_vertically_on_load(false);
+    rg::setFlipVerticallyOnLoad(false);
 
 
     vector<std::string> faces
@@ -430,6 +625,7 @@ int main() {
             };
 
     unsigned int cubemapTexture = loadCubemap(faces);
+    rg::vfs.printStats();
 
     transpShader.use();
     transpShader.setInt("texture1", 0);
@@ -450,9 +646,25 @@ int main() {
 
         // input
         processInput(window);
+        streamBuffer.BeginFrame();
 
 
         // render
+        // into the scene framebuffer at the scaled resolution, upscaled to the window at the end of the frame
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (aaBenchmark.Running()) {
+            antiAliasingMode = aaBenchmark.Update(dynamicResolution.FrameSamples(), dynamicResolution.FrameMilliseconds(),
+                                                  framebufferWidth, framebufferHeight);
+            if (!aaBenchmark.Running()) {
+                dynamicResolution.enabled = dynamicResolutionBeforeBenchmark;
+                deferredShading = deferredShadingBeforeBenchmark;
+            }
+        }
+        antiAliasing.mode = antiAliasingMode;
+        // the G-buffer's depth can't be copied into a multisampled framebuffer, deferred shading draws without MSAA
+        dynamicResolution.SetSamples(deferredShading ? 1 : AntiAliasing::Samples(antiAliasingMode));
+        dynamicResolution.BeginFrame(framebufferWidth, framebufferHeight);
+        int renderWidth = dynamicResolution.RenderWidth(), renderHeight = dynamicResolution.RenderHeight();
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -467,170 +679,298 @@ int main() {
         pointLight.constant = 0.1f;
         pointLight.linear = 0.03f;
         pointLight.quadratic = 0.032f;
-
-        ourShader.use();
-
-        // pointLight1
-
-//        camera(glm::vec3(-2.32,0.54,5.87)
-        pointLight.position = glm::vec3(-2.32,0.54,6.8);
-
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-
-        // pointLight2
-        //glm::vec3(-2.5f,-1.2f,10.5f)
-        //pointLight.position = glm::vec3(8.0f, -5.0f, 30.0f);
-        //svetlo
-        pointLight.position = glm::vec3(-1.0f, 3.0f, 4.0f);
-
-
-        ourShader.setVec3("pointLight1.position", pointLight.position);
-        ourShader.setVec3("pointLight1.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight1.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight1.specular", pointLight.specular);
-        ourShader.setFloat("pointLight1.constant", pointLight.constant);
-        ourShader.setFloat("pointLight1.linear", pointLight.linear);
-        ourShader.setFloat("pointLight1.quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-
-
-        //spotlight:
-        ourShader.setVec3("spotLight.position", programState->camera.Position);
-        ourShader.setVec3("spotLight.direction", programState->camera.Front);
-        ourShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        ourShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-        ourShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-        ourShader.setFloat("spotLight.constant", 0.5f);
-        ourShader.setFloat("spotLight.linear", 0.03);
-        ourShader.setFloat("spotLight.quadratic", 0.032);
-        ourShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        ourShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
+        // the lights are the same for every lit shader of the frame, they go into one uniform block
+        writeLightingBlock(streamBuffer, pointLight);
 
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom), (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-
-
+        // TAA draws with a sub-pixel jitter, the motion vectors use the matrices without it
+        bool temporalAa = antiAliasingMode == AntiAliasingTemporal;
+        temporal.jitter = temporalAa;
+        temporal.Resize(renderWidth, renderHeight);
+        temporal.BeginFrame(projection, view);
+        projection = temporal.Projection();
+
+        // the indirect batch shades with the same lights, only the model matrix comes from the draw id
+        lodSelector.SetView(programState->camera.Position, programState->camera.Zoom, (float)renderHeight);
+
+        // the ball is the only model that moves, its box is refit before asking what is in view
+        glm::mat4 loptaModel = loptaTransform(glfwGetTime());
+        glm::mat4 previousLoptaModel = temporal.PreviousModel(SceneLopta, loptaModel);
+        sceneBvh.update(SceneLopta, rg::Aabb::transformed(ourModelLopta.GetBounds(), loptaModel));
+        bool sceneVisible[SceneObjectCount] = {};
+        sceneBvh.queryFrustum(rg::Frustum::fromMatrix(projection * view), [&](unsigned int object) {
+            sceneVisible[object] = true;
+        });
+
+        // the GPU queries answer with last frame's depth buffer, the ball isn't skipped on the CPU but
+        // drawn under conditional render, so the newest query decides even before its result is read back
+        glm::vec3 cameraPosition = programState->camera.Position;
+        if (gpuOcclusion) {
+            occlusionQueries.BeginFrame();
+            if (sceneVisible[SceneLopta])
+                occlusionQueries.IsVisible(SceneLopta, sceneBvh.bounds(SceneLopta), cameraPosition);
+        } else {
+            occlusionCuller.beginFrame(projection * view);
+            if (sceneVisible[SceneSuncobran])
+                occlusionCuller.addOccluder(suncobranOccluder, suncobranModel);
+            occlusionCuller.addOccluder(peskirOccluder, peskirModel);
+            occlusionCuller.rasterize();
+            if (sceneVisible[SceneLopta])
+                sceneVisible[SceneLopta] = occlusionCuller.isVisible(sceneBvh.bounds(SceneLopta));
+        }
 
         // rendering loaded models
+        //SUNCOBRAN + KOKOS
+        staticBatch.SelectLods(lodSelector);
+        // frustum culling per meshlet only, the scene draws without GL_CULL_FACE (the umbrella's canopy
+        // is seen from both sides) so the normal cones would cull visible back faces
+        // multi draw indirect can't be drawn under conditional render per draw, the batch uses the read back results
+        staticBatch.CullClusters(projection * view, cameraPosition, false, [&](unsigned int draw, const rg::Aabb& box) {
+            if (gpuOcclusion)
+                return occlusionQueries.IsVisible(SceneObjectCount + draw, box, cameraPosition);
+            return occlusionCuller.isVisible(box);
+        });
+        if (currentFrame - lastOcclusionReport > 2.0) {
+            if (gpuOcclusion) {
+                const OcclusionQueries::Stats& stats = occlusionQueries.GetStats();
+                std::cout << "OCCLUSION:: " << stats.hidden << " objects hidden, " << stats.issued << " queries issued, "
+                          << stats.conditionalDraws << " conditional draws" << std::endl;
+            } else {
+                const rg::OcclusionStats& stats = occlusionCuller.stats();
+                std::cout << "OCCLUSION:: " << stats.rejected << "/" << stats.tested << " draws rejected, "
+                          << stats.occluderTriangles << " occluder triangles in " << stats.rasterMilliseconds << " ms" << std::endl;
+            }
+            lastOcclusionReport = currentFrame;
+        }
+        if (sceneVisible[SceneLopta])
+            ourModelLopta.SelectLods(lodSelector, loptaModel);
+
+        // forward shades the models as they are drawn, deferred writes them to the G-buffer and lights it
+        // afterwards. The pre-pass goes into the G-buffer's depth too, which is then copied to the scene framebuffer.
+        litTimer.Begin();
+        Shader &batchShader = deferredShading ? gbufferIndirectShader : indirectShader;
+        Shader &modelShader = deferredShading ? gbufferShader : ourShader;
+        if (deferredShading) {
+            deferredRenderer.Resize(renderWidth, renderHeight);
+            deferredRenderer.BeginGeometryPass();
+        }
 
-        //SUNCOBRAN
-        glm::mat4 model = glm::mat4(1.0f);
+        // SSAO reads the depth before the lit objects are shaded, so everything it darkens goes into the
+        // pre-pass (the models are in the G-buffer anyway in deferred mode)
+        ssao.enabled = ssaoDivisor > 0;
+        ssao.divisor = ssaoDivisor;
+        ssao.sampleCount = ssaoSamples;
+        ssao.Resize(renderWidth, renderHeight);
+        depthPrepass.SetRequired(PrepassStatic, ssao.enabled && !deferredShading);
+        depthPrepass.SetRequired(PrepassModels, ssao.enabled && !deferredShading);
+        depthPrepass.SetRequired(PrepassFloor, ssao.enabled);
+
+        // depth pre-pass, positions only in the same order as the shading below, which then runs with GL_EQUAL
+        depthPrepass.BeginFrame();
+        depthPrepass.BeginDepthPass();
+        if (depthPrepass.BeginDepth(PrepassStatic)) {
+            depthIndirectShader.use();
+            depthIndirectShader.setMat4("projection", projection);
+            depthIndirectShader.setMat4("view", view);
+            staticBatch.DrawDepth(depthIndirectShader);
+            depthPrepass.EndDepth(PrepassStatic);
+        }
+        depthShader.use();
+        depthShader.setMat4("projection", projection);
+        depthShader.setMat4("view", view);
+        if (sceneVisible[SceneLopta] && depthPrepass.BeginDepth(PrepassModels)) {
+            depthShader.setMat4("model", loptaModel);
+            if (gpuOcclusion)
+                occlusionQueries.BeginConditional(SceneLopta);
+            ourModelLopta.DrawDepth();
+            occlusionQueries.EndConditional();
+            depthPrepass.EndDepth(PrepassModels);
+        }
+        if (depthPrepass.BeginDepth(PrepassTowel)) {
+            depthShader.setMat4("model", peskirModel);
+            glBindVertexArray(peskirVAO);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            depthPrepass.EndDepth(PrepassTowel);
+        }
+        if (depthPrepass.BeginDepth(PrepassFloor)) {
+            // the floor's vertices are already in world space
+            depthShader.setMat4("model", glm::mat4(1.0f));
+            glBindVertexArray(planeVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            depthPrepass.EndDepth(PrepassFloor);
+        }
+        depthPrepass.EndDepthPass();
+        if (ssao.enabled && !deferredShading) {
+            dynamicResolution.ResolveDepth();
+            ssao.Compute(dynamicResolution.DepthTexture(), projection);
+            glBindFramebuffer(GL_FRAMEBUFFER, dynamicResolution.Framebuffer());
+            glViewport(0, 0, renderWidth, renderHeight);
+        }
 
-        //glm::vec3(-2.75f, -0.30f, 3.5f)
-        model = glm::translate(model,glm::vec3(-2.5f,-1.2f,10.5f));
-        model = glm::rotate(model,glm::radians(80.0f),glm::vec3(0.85,0,1.0));
-        model = glm::rotate(model,glm::radians(150.0f),glm::vec3(0,1.0,0));
-        model = glm::scale(model, glm::vec3(0.017f,0.017f,0.017f));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model);
-        ourModelSuncobran.Draw(ourShader);
+        batchShader.use();
+        setLightingUniforms(batchShader, projection, view);
+        ssao.Bind(batchShader);
+        depthPrepass.BeginShading(PrepassStatic);
+        staticBatch.Draw(batchShader);
+        depthPrepass.EndShading(PrepassStatic);
+
+        modelShader.use();
+        setLightingUniforms(modelShader, projection, view);
+        ssao.Bind(modelShader);
 
         //LOPTA
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(8.0f, -15.0f, 35.0f) + (float)movingObject.lopta * glm::vec3(0.0f, sin(glfwGetTime() * 4) * 4, 2.0f));
-        model = glm::rotate(model,glm::radians(30.0f),glm::vec3(0.0,1.0,0.0));
-        model = glm::scale(model, glm::vec3(0.2f));
-        ourShader.setMat4("model", model);
-        ourModelLopta.Draw(ourShader);
+        glm::mat4 model = loptaModel;
+        if (sceneVisible[SceneLopta]) {
+            modelShader.setMat4("model", model);
+            if (gpuOcclusion)
+                occlusionQueries.BeginConditional(SceneLopta);
+            depthPrepass.BeginShading(PrepassModels);
+            ourModelLopta.Draw(modelShader);
+            depthPrepass.EndShading(PrepassModels);
+            occlusionQueries.EndConditional();
+        }
 
+        if (deferredShading) {
+            deferredRenderer.EndGeometryPass(dynamicResolution.Framebuffer());
+            if (ssao.enabled) {
+                ssao.Compute(dynamicResolution.DepthTexture(), projection);
+                glBindFramebuffer(GL_FRAMEBUFFER, dynamicResolution.Framebuffer());
+                glViewport(0, 0, renderWidth, renderHeight);
+            }
+            deferredLightShader.use();
+            setLightingUniforms(deferredLightShader, projection, view);
+            ssao.Bind(deferredLightShader);
+            deferredRenderer.BeginLighting(deferredLightShader, projection, view, programState->camera.Position);
+            // the spot light follows the camera and covers the screen, it goes first
+            deferredRenderer.DrawFullscreenLight(deferredLightShader, 2);
+            glm::vec3 brightest = pointLight.ambient + pointLight.diffuse + pointLight.specular;
+            float intensity = std::max(brightest.x, std::max(brightest.y, brightest.z));
+            for (int i = 0; i < 2; i++)
+                deferredRenderer.DrawPointLight(deferredLightShader, i, shadingLightPositions[i], intensity,
+                                                pointLight.constant, pointLight.linear, pointLight.quadratic);
+            deferredRenderer.EndLighting();
+        }
+        litTimer.End();
+
+        double litMilliseconds;
+        if (currentFrame - lastRendererReport > 2.0 && litTimer.Milliseconds(litMilliseconds)) {
+            std::cout << "RENDERER:: " << (deferredShading ? "deferred" : "forward") << ", lit models "
+                      << litMilliseconds << " ms on the GPU";
+            if (deferredShading)
+                std::cout << " (" << deferredRenderer.LightVolumeCount() << " light volumes, "
+                          << deferredRenderer.FullscreenLightCount() << " fullscreen lights)";
+            std::cout << std::endl;
+            lastRendererReport = currentFrame;
+        }
 
-        //KOKOS
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-13.0f,-8.0f,3.5f));
-        model = glm::rotate(model,glm::radians(-90.0f),glm::vec3(1.0,0,0.0));
-        model = glm::scale(model, glm::vec3(0.008f,0.008f,0.008f));
-        ourShader.setMat4("model", model);
-        ourModelKokos.Draw(ourShader);
+        // forward shaded in both modes, after the deferred lighting
+        if (stressTransforms.size() != instanceStressCount) {
+            // a square grid next to the coconut, each copy turned a bit further
+            stressTransforms.clear();
+            unsigned int side = (unsigned int)std::ceil(std::sqrt((float)instanceStressCount));
+            for (unsigned int i = 0; i < instanceStressCount; i++) {
+                glm::mat4 stressModel = glm::mat4(1.0f);
+                stressModel = glm::translate(stressModel, glm::vec3(-13.0f - 1.0f * (i % side), -8.0f, 3.5f - 1.0f * (i / side)));
+                stressModel = glm::rotate(stressModel, glm::radians(137.5f * i), glm::vec3(0.0f, 1.0f, 0.0f));
+                stressModel = glm::rotate(stressModel, glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+                stressModel = glm::scale(stressModel, glm::vec3(0.008f));
+                stressTransforms.push_back(stressModel);
+            }
+        }
+        if (!stressTransforms.empty()) {
+            // the only place the coconut is drawn outside the batch
+            ourModelKokos.LoadTextures();
+            Shader &stressShader = instanceStressLoop ? ourShader : instancedShader;
+            auto submitStart = std::chrono::steady_clock::now();
+            stressTimer.Begin();
+            stressShader.use();
+            setLightingUniforms(stressShader, projection, view);
+            // the copies are in neither the depth pre-pass nor the G-buffer, so they can't use the occlusion
+            ssao.BindNone(stressShader);
+            if (instanceStressLoop) {
+                for (const glm::mat4 &stressModel : stressTransforms) {
+                    stressShader.setMat4("model", stressModel);
+                    ourModelKokos.Draw(stressShader);
+                }
+            } else {
+                ourModelKokos.DrawInstanced(stressShader, stressTransforms);
+            }
+            stressTimer.End();
+            double submitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
+            double stressMilliseconds;
+            if (currentFrame - lastStressReport > 2.0 && stressTimer.Milliseconds(stressMilliseconds)) {
+                unsigned int drawCalls = ourModelKokos.meshes.size() * (instanceStressLoop ? stressTransforms.size() : 1);
+                std::cout << "INSTANCING:: " << stressTransforms.size() << " coconuts "
+                          << (instanceStressLoop ? "one by one" : "instanced") << ", " << drawCalls << " draw calls, GPU "
+                          << stressMilliseconds << " ms, CPU submission " << submitMilliseconds << " ms" << std::endl;
+                lastStressReport = currentFrame;
+            }
+        }
 
         //peskir
         glBindTexture(GL_TEXTURE_2D, peskirTexture);
         transpShader.use();
-        projection = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        // with the jitter, like the depth pre-pass
+        projection = temporal.Projection();
         view = programState->camera.GetViewMatrix();
 
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-3.5f, -7.6f, 25.0f));
-        model = glm::rotate(model,glm::radians(90.0f),glm::vec3(0.4,0.0,0.0));
-        model = glm::scale(model,glm::vec3(3.0f));
+        model = peskirModel;
 
         transpShader.setMat4("model", model);
         transpShader.setMat4("projection", projection);
         transpShader.setMat4("view", view);
         glBindVertexArray(peskirVAO);
+        depthPrepass.BeginShading(PrepassTowel);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        depthPrepass.EndShading(PrepassTowel);
 
-        lightCubeShader.use();
-        lightCubeShader.setMat4("projection", projection);
-        lightCubeShader.setMat4("view", view);
-
-        // we now draw as many light bulbs as we have point lights.
-        glBindVertexArray(lightCubeVAO);
+        // a light bulb per point light, one draw per primitive type for all debug shapes
         for (unsigned int i = 0; i < 2; i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, pointLightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.2f)); // Make it a smaller cube
-            lightCubeShader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            debugDraw.Cube(pointLightPositions[i], 0.2f, glm::vec4(1.0f));
+        if (debugBounds) {
+            for (unsigned int object = 0; object < SceneObjectCount; object++)
+                debugDraw.Aabb(sceneBvh.bounds(object), sceneVisible[object] ? glm::vec4(0.0f, 1.0f, 0.0f, 1.0f)
+                                                                              : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
         }
+        debugDraw.Draw(debugDrawShader, projection, view);
 
         // TODO adv
         advShader.use();
-        glm::mat4 projectionAdv = glm::perspective(glm::radians(programState->camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projectionAdv = temporal.Projection();
         glm::mat4 viewAdv = programState->camera.GetViewMatrix();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-2.5f, -5.6f, 25.0f));
-        model = glm::rotate(model,glm::radians(90.0f),glm::vec3(0.4,0.0,0.0));
-        model = glm::scale(model,glm::vec3(3.0f));
-
-        transpShader.setMat4("model", model);
+        // the floor's vertices are already in world space, the same model as in the depth pre-pass
+        advShader.setMat4("model", glm::mat4(1.0f));
         advShader.setMat4("projection", projectionAdv);
         advShader.setMat4("view", viewAdv);
 
         advShader.setVec3("viewPos", programState->camera.Position);
         advShader.setVec3("lightPos", lightPos);
         advShader.setInt("blinn", blinn);
+        ssao.Bind(advShader);
 
         glBindVertexArray(planeVAO);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, floorTexture);
+        depthPrepass.BeginShading(PrepassFloor);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        //TRAVA
-
-            transpShader.use();
-            projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                          (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-
-            glBindVertexArray(transparentTravaVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, transparentTravaTexture);
-
-            for (unsigned int i = 0; i < vegetation.size(); i++)
-            {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, vegetation[i]);
-                model = glm::scale(model, glm::vec3(2.5f, 2.5f, 2.5f));
-                model = glm::rotate(model,glm::radians(90.0f),glm::vec3(0.0,1.0,0.0));
-                transpShader.setMat4("model", model);
-                transpShader.setMat4("projection", projection);
-                transpShader.setMat4("view", view);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+        depthPrepass.EndShading(PrepassFloor);
+
+        if (depthPrepass.measure && currentFrame - lastPrepassReport > 2.0) {
+            for (unsigned int c = 0; c < PrepassClassCount; c++) {
+                DepthPrepass::ClassStats stats;
+                if (!depthPrepass.Stats(c, stats))
+                    continue;
+                unsigned int saved = stats.depthSamples > stats.shadedSamples ? stats.depthSamples - stats.shadedSamples : 0;
+                std::cout << "DEPTH_PREPASS:: " << prepassClassNames[c] << ": " << stats.shadedSamples << " of "
+                          << stats.depthSamples << " samples shaded, " << saved << " saved" << std::endl;
             }
+            lastPrepassReport = currentFrame;
+        }
 
-
+        // boxes of this frame's queried objects against the opaque depth, before the grass blends over it
+        if (gpuOcclusion)
+            occlusionQueries.IssueQueries(lightCubeShader, projection, view);
 
         // drawing skybox as last
         glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
@@ -647,6 +987,87 @@ int main() {
         glBindVertexArray(0);
         glDepthFunc(GL_LESS); // set depth function back to default
 
+        //TRAVA
+        // translucent, so it goes after everything opaque including the sky. The quads are accumulated
+        // in any order and blended over the scene in one pass (weighted blended OIT), nothing is sorted
+        view = programState->camera.GetViewMatrix();
+        weightedOit.Resize(renderWidth, renderHeight);
+        weightedOit.Begin(dynamicResolution.Framebuffer());
+        oitShader.use();
+        model = glm::scale(glm::mat4(1.0f), glm::vec3(2.5f, 2.5f, 2.5f));
+        model = glm::rotate(model,glm::radians(90.0f),glm::vec3(0.0,1.0,0.0));
+        oitShader.setMat4("model", model);
+        oitShader.setMat4("projection", projection);
+        oitShader.setMat4("view", view);
+        glBindVertexArray(transparentTravaVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, transparentTravaTexture);
+        oitShader.setInt("texture1", 0);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, 6, vegetation.size());
+        glBindVertexArray(0);
+        weightedOit.End();
+        weightedOit.Composite(oitCompositeShader, dynamicResolution.Framebuffer());
+
+        // bloom, exposure and tone mapping of the HDR scene, anti-aliasing, then up to the window
+        dynamicResolution.Resolve();
+        unsigned int sceneColor = dynamicResolution.ColorTexture();
+        glm::vec2 sceneUvScale = dynamicResolution.UvScale();
+        if (temporalAa) {
+            // the ball is the only thing that moves on its own, everything else only moves with the camera
+            temporal.BeginMotionVectors(dynamicResolution.DepthTexture());
+            if (sceneVisible[SceneLopta]) {
+                temporal.SetObjectMotion(loptaModel, previousLoptaModel);
+                ourModelLopta.DrawDepth();
+            }
+            temporal.EndMotionVectors();
+            temporalAaShader.use();
+            temporalAaShader.setFloat("feedback", 0.9f);
+            temporalAaHistory.Resize(renderWidth, renderHeight);
+            temporalAaHistory.Accumulate(temporalAaShader, sceneColor, temporal);
+            sceneColor = temporalAaHistory.OutputTexture();
+            sceneUvScale = temporalAaHistory.UvScale();
+        } else {
+            temporalAaHistory.Reset();
+        }
+        postProcess.Resize(renderWidth, renderHeight);
+        postProcess.Apply(sceneColor, sceneUvScale, deltaTime);
+        antiAliasing.Resize(renderWidth, renderHeight);
+        antiAliasing.Apply(postProcess.OutputFramebuffer(), postProcess.OutputTexture(), postProcess.UvScale());
+        dynamicResolution.EndFrame();
+        dynamicResolution.Upscale(upscaleShader, antiAliasing.OutputFramebuffer(), antiAliasing.OutputTexture(), antiAliasing.OutputUvScale());
+        double postMilliseconds;
+        if (currentFrame - lastPostReport > 2.0 && postProcess.Milliseconds(postMilliseconds)) {
+            std::cout << "POST:: " << postMilliseconds << " ms of the " << postProcess.budgetMilliseconds
+                      << " ms budget, exposure " << postProcess.Exposure() << " (average luminance "
+                      << postProcess.AverageLuminance() << ")";
+            if (postMilliseconds > postProcess.budgetMilliseconds)
+                std::cout << " - over budget";
+            std::cout << std::endl;
+            lastPostReport = currentFrame;
+        }
+        if (ssao.enabled && currentFrame - lastSsaoReport > 2.0) {
+            std::cout << "SSAO:: " << ssaoResolutionName(ssao.divisor) << " resolution, " << ssao.sampleCount << " samples";
+            for (int divisor = 1; divisor <= 4; divisor *= 2) {
+                double ssaoMilliseconds;
+                if (ssao.Milliseconds(divisor, ssaoMilliseconds))
+                    std::cout << ", " << ssaoResolutionName(divisor) << " " << ssaoMilliseconds << " ms";
+            }
+            std::cout << std::endl;
+            lastSsaoReport = currentFrame;
+        }
+        if (currentFrame - lastResolutionReport > 2.0 && dynamicResolution.FrameMilliseconds() > 0.0) {
+            std::cout << "DYNAMIC_RESOLUTION:: scale " << dynamicResolution.Scale() << " (" << renderWidth << "x"
+                      << renderHeight << "), GPU frame " << dynamicResolution.FrameMilliseconds() << " ms, target "
+                      << dynamicResolution.targetMilliseconds << " ms" << std::endl;
+            lastResolutionReport = currentFrame;
+        }
+
+        streamBuffer.EndFrame();
+        if (currentFrame - lastStreamReport > 2.0) {
+            streamBuffer.PrintStats("frame");
+            lastStreamReport = currentFrame;
+        }
+
         std::cout << (blinn ? "Blinn-Phong" : "Phong") << std::endl;
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -666,12 +1087,82 @@ int main() {
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &peskirVBO);
     glDeleteBuffers(1, &peskirEBO);
+    staticBatch.deleteBuffers();
+    occlusionQueries.deleteBuffers();
+    depthPrepass.deleteBuffers();
+    deferredRenderer.deleteBuffers();
+    weightedOit.deleteBuffers();
+    dynamicResolution.deleteBuffers();
+    postProcess.deleteBuffers();
+    antiAliasing.deleteBuffers();
+    temporal.deleteBuffers();
+    temporalAaHistory.deleteBuffers();
+    ssao.deleteBuffers();
+    glDeleteBuffers(1, &vegetationInstanceVBO);
+    litTimer.deleteQueries();
+    stressTimer.deleteQueries();
+    debugDraw.deleteBuffers();
+    streamBuffer.deleteBuffers();
+    ourModelKokos.deleteInstanceBuffer();
+    staticMaterials.deleteBuffers();
+    staticGeometry.deleteBuffers();
 
 
     glfwTerminate();
     return 0;
 }
 
+// points the shader's Lighting block (if it has one) at the binding writeLightingBlock fills
+void bindLightingBlock(Shader &shader) {
+    unsigned int blockIndex = glGetUniformBlockIndex(shader.ID, "Lighting");
+    if (blockIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(shader.ID, blockIndex, LightingUniformBinding);
+}
+
+// the point lights and the camera spot light for this frame's lit shaders, written into the stream buffer
+// and bound to LightingUniformBinding
+void writeLightingBlock(StreamBuffer &stream, PointLight &pointLight) {
+    StreamBuffer::Allocation allocation = stream.AllocateUniform(sizeof(LightingBlock));
+    if (!allocation.data)
+        return;
+    LightingBlock &block = *(LightingBlock *)allocation.data;
+    PointLightStd140 *pointLights[] = { &block.pointLight, &block.pointLight1 };
+    for (int i = 0; i < 2; i++) {
+        pointLight.position = shadingLightPositions[i];
+        PointLightStd140 &light = *pointLights[i];
+        light.position = glm::vec4(pointLight.position, 0.0f);
+        light.specular = glm::vec4(pointLight.specular, 0.0f);
+        light.diffuse = glm::vec4(pointLight.diffuse, 0.0f);
+        light.ambient = pointLight.ambient;
+        light.constant = pointLight.constant;
+        light.linear = pointLight.linear;
+        light.quadratic = pointLight.quadratic;
+    }
+
+    SpotLightStd140 &spotLight = block.spotLight;
+    spotLight.position = glm::vec4(programState->camera.Position, 0.0f);
+    spotLight.direction = programState->camera.Front;
+    spotLight.cutOff = glm::cos(glm::radians(12.5f));
+    spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+    spotLight.specular = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    spotLight.diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    spotLight.ambient = glm::vec3(0.0f);
+    spotLight.constant = 0.5f;
+    spotLight.linear = 0.03f;
+    spotLight.quadratic = 0.032f;
+    block.viewPosition = programState->camera.Position;
+
+    stream.Commit(allocation);
+    glBindBufferRange(GL_UNIFORM_BUFFER, LightingUniformBinding, stream.Buffer(), allocation.offset, sizeof(LightingBlock));
+}
+
+// the camera matrices and the shininess used by 2.model_lighting.fs, the lights are in the Lighting block
+void setLightingUniforms(Shader &ourShader, const glm::mat4 &projection, const glm::mat4 &view) {
+    ourShader.setFloat("material.shininess", 32.0f);
+    ourShader.setMat4("projection", projection);
+    ourShader.setMat4("view", view);
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
@@ -747,37 +1238,208 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         programState->gameStart = true;
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
+    // prints the model in the middle of the screen
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        float distance = 0.0f;
+        unsigned int object = sceneBvh.raycast(programState->camera.Position, programState->camera.Front, 100.0f, distance);
+        if (object != rg::Bvh::InvalidObject)
+            std::cout << "SCENE:: looking at " << sceneObjectNames[object] << " (" << distance << " units away)" << std::endl;
+        else
+            std::cout << "SCENE:: looking at nothing" << std::endl;
+    }
+    if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + PrepassClassCount && action == GLFW_PRESS) {
+        unsigned int objectClass = key - GLFW_KEY_1;
+        depthPrepass.Toggle(objectClass);
+        std::cout << "DEPTH_PREPASS:: " << prepassClassNames[objectClass] << " "
+                  << (depthPrepass.IsEnabled(objectClass) ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS) {
+        depthPrepass.measure = !depthPrepass.measure;
+        std::cout << "DEPTH_PREPASS:: measurement " << (depthPrepass.measure ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_G && action == GLFW_PRESS && !aaBenchmark.Running()) {
+        deferredShading = !deferredShading;
+        std::cout << "RENDERER:: " << (deferredShading ? "deferred" : "forward") << " shading" << std::endl;
+    }
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        dynamicResolution.enabled = !dynamicResolution.enabled;
+        std::cout << "DYNAMIC_RESOLUTION:: " << (dynamicResolution.enabled ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_X && action == GLFW_PRESS && !aaBenchmark.Running()) {
+        antiAliasingMode = (AntiAliasingMode)((antiAliasingMode + 1) % AntiAliasingModeCount);
+        std::cout << "ANTI_ALIASING:: " << AntiAliasing::Name(antiAliasingMode);
+        if (deferredShading && AntiAliasing::Samples(antiAliasingMode) > 1)
+            std::cout << " (not with deferred shading, drawn without)";
+        std::cout << std::endl;
+    }
+    if (key == GLFW_KEY_N && action == GLFW_PRESS && !aaBenchmark.Running()) {
+        // at a fixed resolution, so the modes are compared on the same pixels, and forward shaded, since
+        // deferred shading would draw the MSAA modes single sampled
+        dynamicResolutionBeforeBenchmark = dynamicResolution.enabled;
+        dynamicResolution.enabled = false;
+        deferredShadingBeforeBenchmark = deferredShading;
+        deferredShading = false;
+        if (deferredShadingBeforeBenchmark)
+            std::cout << "AA_BENCHMARK:: forward shading until it is done" << std::endl;
+        aaBenchmark.Start(antiAliasingMode);
+    }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        ssaoDivisor = ssaoDivisor == 0 ? 1 : (ssaoDivisor == 4 ? 0 : ssaoDivisor * 2);
+        if (ssaoDivisor == 0)
+            std::cout << "SSAO:: off" << std::endl;
+        else
+            std::cout << "SSAO:: " << ssaoResolutionName(ssaoDivisor) << " resolution" << std::endl;
+    }
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        ssaoSamples = ssaoSamples >= Ssao::MaxSamples ? 8 : ssaoSamples * 2;
+        std::cout << "SSAO:: " << ssaoSamples << " samples" << std::endl;
+    }
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        instanceStressCount = instanceStressCount == 0 ? 1000 : (instanceStressCount >= 16000 ? 0 : instanceStressCount * 4);
+        std::cout << "INSTANCING:: " << instanceStressCount << " coconuts" << std::endl;
+    }
+    if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+        instanceStressLoop = !instanceStressLoop;
+        std::cout << "INSTANCING:: " << (instanceStressLoop ? "one draw per coconut" : "instanced") << std::endl;
+    }
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+        debugBounds = !debugBounds;
+        std::cout << "DEBUG_DRAW:: scene bounds " << (debugBounds ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+        gpuOcclusion = !gpuOcclusion;
+        std::cout << "OCCLUSION:: " << (gpuOcclusion ? "GPU queries" : "software depth buffer") << std::endl;
+    }
 
 
 }
 
 
+// the faces are decoded on worker threads, which also build their mip chains; only the upload runs
+// on the GL thread. With S3TC the faces come from the texture cache as BC1 with their mips (encoded on
+// the first run), otherwise they are uploaded as RGB8. All faces have to be square and of the same size.
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    struct CubemapFace {
+        int width = 0;
+        int height = 0;
+        vector<vector<unsigned char>> levels; // RGBA, level 0 first, without S3TC
+        rg::CompressedImage compressed;       // with S3TC
+    };
+    vector<CubemapFace> decoded(faces.size());
+    bool compressed = rg::glExt.textureCompressionS3TC;
 
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
+    auto decodeStart = std::chrono::steady_clock::now();
+    rg::parallelFor(faces.size(), [&](unsigned int i) {
+        CubemapFace& face = decoded[i];
+        if (compressed)
+        {
+            if (rg::loadCompressedImage(faces[i], rg::TextureUsage::Color, face.compressed))
+            {
+                face.width = face.compressed.levels[0].width;
+                face.height = face.compressed.levels[0].height;
+            }
+            return;
+        }
+        rg::ImageInfo info;
+        face.levels.emplace_back();
+        if (!rg::decodeImage(faces[i], 4, face.levels[0], info))
+        {
+            face.levels.clear();
+            return;
+        }
+        face.width = info.width;
+        face.height = info.height;
+
+        int width = face.width, height = face.height;
+        while (width > 1 || height > 1)
+        {
+            face.levels.emplace_back();
+            rg::downsampleRGBA(face.levels[face.levels.size() - 2].data(), width, height, face.levels.back());
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+    });
+    auto decodeEnd = std::chrono::steady_clock::now();
+
+    int size = 0;
+    for (const CubemapFace& face : decoded)
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
+        if (face.width > 0)
         {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+            size = face.width;
+            break;
         }
-        else
+    }
+    bool valid = !decoded.empty();
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        if (decoded[i].width == 0)
         {
             std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            valid = false;
+        }
+        else if (decoded[i].width != size || decoded[i].height != size)
+        {
+            std::cout << "Cubemap face " << faces[i] << " is " << decoded[i].width << "x" << decoded[i].height
+                      << ", expected " << size << "x" << size << std::endl;
+            valid = false;
+        }
+        else if (compressed && decoded[i].compressed.format != decoded[0].compressed.format)
+        {
+            std::cout << "Cubemap face " << faces[i] << " has an alpha channel, the other faces don't" << std::endl;
+            valid = false;
+        }
+    }
+    if (!valid)
+        return 0;
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    GLsizei levels = compressed ? decoded[0].compressed.levels.size() : decoded[0].levels.size();
+    GLenum internalFormat = compressed ? rg::glInternalFormat(decoded[0].compressed.format) : GL_RGB8;
+    if (rg::glExt.textureStorage)
+        rg::glExt.TexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internalFormat, size, size);
+    for (unsigned int i = 0; i < decoded.size(); i++)
+    {
+        GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+        for (GLsizei level = 0; level < levels; level++)
+        {
+            GLsizei levelSize = std::max(1, size >> level);
+            if (compressed)
+            {
+                const vector<unsigned char> &blocks = decoded[i].compressed.levels[level].data;
+                if (rg::glExt.textureStorage)
+                    glCompressedTexSubImage2D(target, level, 0, 0, levelSize, levelSize, internalFormat, blocks.size(), blocks.data());
+                else
+                    glCompressedTexImage2D(target, level, internalFormat, levelSize, levelSize, 0, blocks.size(), blocks.data());
+                continue;
+            }
+            const unsigned char *data = decoded[i].levels[level].data();
+            if (rg::glExt.textureStorage)
+                glTexSubImage2D(target, level, 0, 0, levelSize, levelSize, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            else
+                glTexImage2D(target, level, GL_RGB8, levelSize, levelSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
         }
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    // the driver may copy the data asynchronously, wait for it so the upload time is not hidden
+    glFinish();
+    auto uploadEnd = std::chrono::steady_clock::now();
+
+    std::cout << "CUBEMAP:: " << faces.size() << " faces " << size << "x" << size << ", " << levels << " levels, "
+              << (compressed ? (decoded[0].compressed.format == rg::BlockFormat::BC1 ? "BC1" : "BC3") : "RGB8") << ", decode "
+              << std::chrono::duration<double, std::milli>(decodeEnd - decodeStart).count() << " ms, upload "
+              << std::chrono::duration<double, std::milli>(uploadEnd - decodeEnd).count() << " ms"
+              << (rg::glExt.textureStorage ? " (immutable storage)" : "") << std::endl;
 
     return textureID;
 }
@@ -785,36 +1447,36 @@ unsigned int loadCubemap(vector<std::string> faces)
 
 unsigned int loadTexture(char const * path)
 {
+    rg::CompressedTexture compressed = rg::loadCompressedTexture(path);
+    if (compressed.id)
+    {
+        bool alpha = compressed.format == rg::BlockFormat::BC3;
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, alpha ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return compressed.id;
+    }
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
+    // decoded straight into a pixel unpack buffer
+    rg::ImageInfo info;
+    if (rg::uploadImageFile(GL_TEXTURE_2D, path, info))
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
+        GLenum format = rg::imageFormat(info.components);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else
     {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
 
     return textureID;
@@ -0,0 +1,156 @@
+//
+// Microbenchmark for rg::Bvh (include/rg/Bvh.h) against brute force loops over the same boxes.
+//
+//   bvh_benchmark [object count ...]      (default 10000 100000 1000000)
+//
+// Objects are random boxes at a constant density, so the number of hits per query stays about the
+// same for every count. Every query result is checked against the brute force answer.
+//
+
+#include <rg/Bvh.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool run(unsigned int count) {
+    std::mt19937 random(count);
+    float worldSize = std::cbrt((float)count) * 4.0f;
+    std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+    std::uniform_real_distribution<float> size(0.2f, 1.5f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<rg::Aabb> boxes(count);
+    for (rg::Aabb& box : boxes) {
+        glm::vec3 center(position(random), position(random), position(random));
+        glm::vec3 half(size(random), size(random), size(random));
+        box = rg::Aabb(center - half, center + half);
+    }
+
+    rg::Bvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(boxes);
+    double buildTime = millisecondsSince(start);
+
+    // frustum queries from random points looking at random targets
+    const int views = 64;
+    std::vector<rg::Frustum> frustums;
+    for (int i = 0; i < views; ++i) {
+        glm::vec3 eye(position(random), position(random), position(random));
+        glm::vec3 target(position(random), position(random), position(random));
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, worldSize * 0.25f);
+        frustums.push_back(rg::Frustum::fromMatrix(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f))));
+    }
+    size_t bvhVisible = 0, bruteVisible = 0;
+    start = std::chrono::steady_clock::now();
+    for (const rg::Frustum& frustum : frustums) {
+        bvh.queryFrustum(frustum, [&](unsigned int) { bvhVisible++; });
+    }
+    double frustumTime = millisecondsSince(start) / views;
+    start = std::chrono::steady_clock::now();
+    for (const rg::Frustum& frustum : frustums) {
+        for (const rg::Aabb& box : boxes) {
+            bruteVisible += frustum.test(box) != rg::FrustumTest::Outside;
+        }
+    }
+    double frustumBrute = millisecondsSince(start) / views;
+
+    // rays and nearest queries; brute force only runs over a subset since it is O(n) per query
+    const int queries = 10000;
+    const int checked = 200;
+    std::vector<glm::vec3> origins(queries), directions(queries);
+    for (int i = 0; i < queries; ++i) {
+        origins[i] = glm::vec3(position(random), position(random), position(random));
+        directions[i] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(1e-4f));
+    }
+    std::vector<unsigned int> rayHits(queries), nearestHits(queries);
+    std::vector<float> rayDistances(queries), nearestDistances(queries);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) {
+        rayHits[i] = bvh.raycast(origins[i], directions[i], worldSize, rayDistances[i]);
+    }
+    double rayTime = millisecondsSince(start) * 1000.0 / queries;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i) {
+        nearestHits[i] = bvh.nearest(origins[i], nearestDistances[i]);
+    }
+    double nearestTime = millisecondsSince(start) * 1000.0 / queries;
+
+    int mismatches = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < checked; ++i) {
+        glm::vec3 inverse = glm::vec3(1.0f) / directions[i];
+        float bestRay = worldSize, bestNearest = 3.0e38f;
+        bool rayHit = false;
+        for (const rg::Aabb& box : boxes) {
+            float entry = rg::detail::rayBoxEntry(box, origins[i], inverse, bestRay);
+            if (entry >= 0.0f && (!rayHit || entry < bestRay)) {
+                bestRay = entry;
+                rayHit = true;
+            }
+            bestNearest = std::min(bestNearest, rg::detail::pointBoxDistance2(box, origins[i]));
+        }
+        if (rayHit != (rayHits[i] != rg::Bvh::InvalidObject) || (rayHit && std::fabs(bestRay - rayDistances[i]) > 1e-3f)) {
+            mismatches++;
+        }
+        if (std::fabs(std::sqrt(bestNearest) - nearestDistances[i]) > 1e-3f) {
+            mismatches++;
+        }
+    }
+    double bruteQueryTime = millisecondsSince(start) * 1000.0 / checked;
+
+    // move a tenth of the objects a little and refit
+    unsigned int moved = std::max(count / 10, 1u);
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < moved; ++i) {
+        unsigned int object = random() % count;
+        glm::vec3 offset(unit(random) * 0.5f, unit(random) * 0.5f, unit(random) * 0.5f);
+        rg::Aabb box = bvh.bounds(object);
+        boxes[object] = rg::Aabb(box.min + offset, box.max + offset);
+        bvh.update(object, boxes[object]);
+    }
+    double updateTime = millisecondsSince(start) * 1000.0 / moved;
+    size_t refitVisible = 0, refitBrute = 0;
+    for (const rg::Frustum& frustum : frustums) {
+        bvh.queryFrustum(frustum, [&](unsigned int) { refitVisible++; });
+        for (const rg::Aabb& box : boxes) {
+            refitBrute += frustum.test(box) != rg::FrustumTest::Outside;
+        }
+    }
+
+    bool ok = bvhVisible == bruteVisible && refitVisible == refitBrute && mismatches == 0;
+    std::cout << std::fixed << std::setprecision(3)
+              << "BVH_BENCHMARK:: " << count << " objects, " << bvh.nodeCount() << " nodes, build " << buildTime << " ms\n"
+              << "  frustum: " << frustumTime << " ms/query (brute force " << frustumBrute << " ms), "
+              << bvhVisible / views << " objects visible\n"
+              << "  ray: " << rayTime << " us, nearest: " << nearestTime << " us (brute force both " << bruteQueryTime << " us)\n"
+              << "  refit: " << updateTime << " us/object for " << moved << " moved objects\n"
+              << "  " << (ok ? "results match brute force" : "MISMATCH with brute force") << std::endl;
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    std::vector<unsigned int> counts;
+    for (int i = 1; i < argc; ++i) {
+        counts.push_back((unsigned int)std::strtoul(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts = { 10000, 100000, 1000000 };
+    }
+    bool ok = true;
+    for (unsigned int count : counts) {
+        ok = run(count) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+//
+// Packs the resources/ tree into the archive read by rg/VirtualFileSystem.h.
+//
+//   pack_assets <project root> <output archive> [--no-compress]
+//
+// Entry names are paths relative to the project root (resources/shaders/...), which is what the
+// loaders ask for. resources/cache (textures generated at runtime) and program_state.txt (written
+// on exit) are skipped.
+//
+
+#include <rg/Archive.h>
+
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& data) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    data.resize((size_t)in.tellg());
+    in.seekg(0);
+    return (bool)in.read((char*)data.data(), data.size());
+}
+
+static bool collect(const std::string& root, const std::string& relative, std::vector<rg::archive::Source>& files) {
+    DIR* dir = opendir((root + "/" + relative).c_str());
+    if (!dir) {
+        std::cout << "PACK_ASSETS:: cannot open " << root << "/" << relative << std::endl;
+        return false;
+    }
+    bool ok = true;
+    while (dirent* item = readdir(dir)) {
+        if (std::strcmp(item->d_name, ".") == 0 || std::strcmp(item->d_name, "..") == 0) {
+            continue;
+        }
+        std::string name = relative + "/" + item->d_name;
+        if (name == "resources/cache" || name == "resources/program_state.txt") {
+            continue;
+        }
+        struct stat info;
+        if (stat((root + "/" + name).c_str(), &info) != 0) {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode)) {
+            ok = collect(root, name, files) && ok;
+        } else if (S_ISREG(info.st_mode)) {
+            rg::archive::Source source;
+            source.name = name;
+            if (!readFile(root + "/" + name, source.data)) {
+                std::cout << "PACK_ASSETS:: cannot read " << name << std::endl;
+                ok = false;
+                continue;
+            }
+            files.push_back(std::move(source));
+        }
+    }
+    closedir(dir);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cout << "usage: " << argv[0] << " <project root> <output archive> [--no-compress]" << std::endl;
+        return 1;
+    }
+    std::string root = argv[1];
+    std::string output = argv[2];
+    bool compress = !(argc > 3 && std::strcmp(argv[3], "--no-compress") == 0);
+
+    std::vector<rg::archive::Source> files;
+    if (!collect(root, "resources", files)) {
+        return 1;
+    }
+
+    rg::archive::WriteStats stats;
+    if (!rg::Archive::write(output, files, compress, stats)) {
+        std::cout << "PACK_ASSETS:: could not write " << output << std::endl;
+        return 1;
+    }
+    std::cout << "PACK_ASSETS:: " << files.size() << " files, " << stats.originalBytes / 1024 << " KiB -> "
+              << stats.storedBytes / 1024 << " KiB stored (" << stats.compressedEntries << " LZ4 entries) in "
+              << output << std::endl;
+    return 0;
+}